@@ -0,0 +1,120 @@
+/*
+ * qfc-bench.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *
+ * Measures the throughput of the SKAT p-value (qfc) on several threads, to
+ * show the effect of making qfc reentrant.  With --lock, every call is made
+ * under a single global mutex, as SKATUtils did before qfc was reentrant.
+ *
+ * Usage: qfc-bench [n_threads] [calls per thread] [n eigenvalues] [--lock]
+ */
+
+#include "biobin/tests/detail/qfc.h"
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace {
+
+boost::mutex qfc_lock;
+
+/*
+ * Calls qfc n_calls times on n_eval eigenvalues, like those of a SKAT
+ * kernel, with the Q statistic varying from call to call.  The sum of the
+ * p-values is kept so that the calls can't be optimized away.
+ */
+void run(unsigned int seed, unsigned int n_calls, int n_eval, bool use_lock,
+		double& sum_out){
+	std::vector<double> lambda(n_eval);
+	std::vector<double> nct(n_eval, 0);
+	std::vector<int> df(n_eval, 1);
+	std::vector<double> trace(7, 0);
+
+	double total = 0;
+	for(int i=0; i<n_eval; i++){
+		lambda[i] = 1.0 / (i + 1);
+		total += lambda[i];
+	}
+
+	double sum = 0;
+	for(unsigned int k=0; k<n_calls; k++){
+		// Q ranges over the bulk and the upper tail of the distribution
+		double Q = total * (0.5 + 4.0 * ((seed + 7919 * k) % 1000) / 1000.0);
+		double sigma = 0;
+		double acc = 1e-6;
+		int lim = 10000;
+		int ifault = 0;
+		double pval = 0;
+
+		if(use_lock){
+			boost::unique_lock<boost::mutex> l(qfc_lock);
+			qfc(&lambda[0], &nct[0], &df[0], &n_eval, &sigma, &Q, &lim, &acc,
+					&trace[0], &ifault, &pval);
+		} else {
+			qfc(&lambda[0], &nct[0], &df[0], &n_eval, &sigma, &Q, &lim, &acc,
+					&trace[0], &ifault, &pval);
+		}
+		sum += pval;
+	}
+	sum_out = sum;
+}
+
+}
+
+int main(int argc, char** argv){
+	unsigned int n_threads = 1;
+	unsigned int n_calls = 2000;
+	int n_eval = 50;
+	bool use_lock = false;
+
+	std::vector<char*> pos_args;
+	for(int i=1; i<argc; i++){
+		if(strcmp(argv[i], "--lock") == 0){
+			use_lock = true;
+		} else {
+			pos_args.push_back(argv[i]);
+		}
+	}
+	if(pos_args.size() > 0){
+		n_threads = std::max(1, atoi(pos_args[0]));
+	}
+	if(pos_args.size() > 1){
+		n_calls = std::max(1, atoi(pos_args[1]));
+	}
+	if(pos_args.size() > 2){
+		n_eval = std::max(1, atoi(pos_args[2]));
+	}
+
+	std::vector<double> sums(n_threads, 0);
+	boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+	boost::thread_group tg;
+	for(unsigned int i=1; i<n_threads; i++){
+		tg.create_thread(boost::bind(&run, i, n_calls, n_eval, use_lock,
+				boost::ref(sums[i])));
+	}
+	run(0, n_calls, n_eval, use_lock, sums[0]);
+	tg.join_all();
+
+	double secs = (boost::posix_time::microsec_clock::universal_time() - start)
+			.total_microseconds() / 1e6;
+	double sum = 0;
+	for(unsigned int i=0; i<n_threads; i++){
+		sum += sums[i];
+	}
+
+	std::cout << "threads=" << n_threads << " calls=" << n_threads * n_calls
+			<< " eigenvalues=" << n_eval << (use_lock ? " lock" : " nolock")
+			<< " seconds=" << secs << " calls/s=" << n_threads * n_calls / secs
+			<< " (checksum " << sum << ")" << std::endl;
+	return 0;
+}
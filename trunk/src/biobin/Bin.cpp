@@ -13,7 +13,6 @@
 #include "binmanager.h"
 
 using std::stringstream;
-using std::set;
 using std::list;
 using BioBin::Utility::Phenotype;
 
@@ -21,19 +20,22 @@ namespace BioBin{
 
 Bin::Bin(const PopulationManager& pop_mgr, Knowledge::Group* grp, const Utility::Phenotype& pheno) :
 		_is_group(true), _is_intergenic(false), _cached_case(false), _cached_control(false),
-		_chrom(-1), _name(grp->getName()), _pop_mgr(pop_mgr), _pheno(pheno) {
+		_chrom(-1), _name(grp->getName()), _loci(0), _var_begin(0), _var_end(0),
+		_pop_mgr(pop_mgr), _pheno(pheno) {
 	_member.group = grp;
 }
 
 Bin::Bin(const PopulationManager& pop_mgr, Knowledge::Region* reg, const Utility::Phenotype& pheno) :
 		_is_group(false), _is_intergenic(false), _cached_case(false), _cached_control(false),
-		_chrom(reg->getChrom()), _name(reg->getName()), _pop_mgr(pop_mgr), _pheno(pheno){
+		_chrom(reg->getChrom()), _name(reg->getName()), _loci(0), _var_begin(0), _var_end(0),
+		_pop_mgr(pop_mgr), _pheno(pheno){
 	_member.region = reg;
 }
 
 Bin::Bin(const PopulationManager& pop_mgr, short chrom, int bin, const Utility::Phenotype& pheno) :
 		_is_group(false), _is_intergenic(true),	_cached_case(false), _cached_control(false),
-		_chrom(chrom), _pop_mgr(pop_mgr), _pheno(pheno) {
+		_chrom(chrom), _loci(0), _var_begin(0), _var_end(0),
+		_pop_mgr(pop_mgr), _pheno(pheno) {
 	stringstream ss;
 	ss << "chr" << Knowledge::Locus::getChromStr(chrom) << ":"
 			<< bin*BinManager::IntergenicBinStep << "K-"
@@ -46,7 +48,14 @@ Bin::Bin(const PopulationManager& pop_mgr, short chrom, int bin, const Utility::
 Bin::Bin(const Bin& other) : _member(other._member),
 		_is_group(other._is_group), _is_intergenic(other._is_intergenic),
 		_cached_case(false), _cached_control(false), _chrom(other._chrom), _name(other._name),
-		_extra_data(other._extra_data), _pop_mgr(other._pop_mgr), _pheno(other._pheno) {}
+		_extra_data(other._extra_data), _loci(0), _var_begin(0), _var_end(0),
+		_pop_mgr(other._pop_mgr), _pheno(other._pheno) {}
+
+Bin::Bin(const Bin& other, const Utility::Phenotype& pheno) : _member(other._member),
+		_is_group(other._is_group), _is_intergenic(other._is_intergenic),
+		_cached_case(false), _cached_control(false), _chrom(other._chrom), _name(other._name),
+		_extra_data(other._extra_data), _loci(0), _var_begin(0), _var_end(0),
+		_pop_mgr(other._pop_mgr), _pheno(pheno) {}
 
 bool Bin::operator<(const Bin& other) const{
 	bool ret_val = false;
@@ -84,13 +93,20 @@ bool Bin::operator<(const Bin& other) const{
 	return ret_val;
 }
 
+void Bin::setVariants(Knowledge::Locus* const* loci, const unsigned int* begin, const unsigned int* end){
+	_loci = loci;
+	_var_begin = begin;
+	_var_end = end;
+	_cached_case = false;
+	_cached_control = false;
+}
+
 unsigned int Bin::getCaseSize() const {
 	if (!_cached_case) {
-		set<Knowledge::Locus*>::const_iterator itr = _variants.begin();
+		const_locus_iterator itr = variantBegin();
 		int case_t = 0;
-		while (itr != _variants.end()) {
-			case_t += _pop_mgr.genotypeContribution(**itr,
-					&(_pheno.getStatus().second));
+		while (itr != variantEnd()) {
+			case_t += _pop_mgr.genotypeContribution(**itr, _pheno, true);
 			++itr;
 		}
 		_size_case_cache = case_t;
@@ -101,11 +117,10 @@ unsigned int Bin::getCaseSize() const {
 
 unsigned int Bin::getControlSize() const {
 	if (!_cached_control) {
-		set<Knowledge::Locus*>::const_iterator itr = _variants.begin();
+		const_locus_iterator itr = variantBegin();
 		int control_t = 0;
-		while (itr != _variants.end()) {
-			control_t += _pop_mgr.genotypeContribution(**itr,
-					&(_pheno.getStatus().first));
+		while (itr != variantEnd()) {
+			control_t += _pop_mgr.genotypeContribution(**itr, _pheno, false);
 			++itr;
 		}
 		_size_control_cache = control_t;
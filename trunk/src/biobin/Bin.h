@@ -8,9 +8,11 @@
 #ifndef BIOBIN_BIN_H
 #define BIOBIN_BIN_H
 
-#include <set>
 #include <list>
 #include <string>
+#include <vector>
+
+#include <boost/iterator/permutation_iterator.hpp>
 
 #include "knowledge/Group.h"
 #include "knowledge/Region.h"
@@ -25,8 +27,7 @@ class Bin{
 
 public:
 	//! Typedef to hide implementation details of the Locus containment
-	typedef std::set<Knowledge::Locus*>::const_iterator const_locus_iterator;
-	typedef std::set<Knowledge::Locus*>::iterator locus_iterator;
+	typedef boost::permutation_iterator<Knowledge::Locus* const*, const unsigned int*> const_locus_iterator;
 
 	/*!
 	 * \brief Construct a bin representing a Group (or Pathway)
@@ -70,6 +71,16 @@ public:
 	 */
 	explicit Bin(const Bin& other);
 
+	/*!
+	 * \brief Construct a copy of a given bin for another phenotype.
+	 * As above, this DOES NOT COPY THE VARIANTS.  This is intended for use
+	 * when the same bins are used for more than one phenotype.
+	 *
+	 * \param other The other bin to base this on.
+	 * \param pheno The phenotype of the new bin
+	 */
+	Bin(const Bin& other, const Utility::Phenotype& pheno);
+
 	/*!
 	 * \brief Return the size of the bin.
 	 *
@@ -96,7 +107,7 @@ public:
 	 *
 	 * \return The number of variants (Loci) that the bin contains
 	 */
-	unsigned int getVariantSize() const {return _variants.size();}
+	unsigned int getVariantSize() const {return _var_end - _var_begin;}
 	/*!
 	 * \brief Return a unique ID (for type) of the bin.
 	 *
@@ -115,8 +126,6 @@ public:
 	bool isIntergenic() const {return _is_intergenic;}
 	short getChrom() const {return _chrom;}
 
-	void addLocus(Knowledge::Locus* to_ins) {_cached_case = false; _cached_control = false; _variants.insert(to_ins);}
-
 	/**
 	 * Strict ordering is given by Groups, then Regions, then Intergenic, which
 	 * are then sorted (by ID, chrom/position, chrom/position)
@@ -126,19 +135,9 @@ public:
 	 */
 	bool operator<(const Bin& other) const;
 
-	const_locus_iterator variantBegin() const {return _variants.begin();}
-	const_locus_iterator variantEnd() const {return _variants.end();}
-	locus_iterator variantBegin() { return _variants.begin();}
-	locus_iterator variantEnd() {return _variants.end();}
-
-	/*!
-	 * \brief removes a Locus* from the bin.
-	 * This function exactly mirrors the erase functionality of the STL set,
-	 * which means that the itr will be non-functional after the erase.
-	 *
-	 * \param itr The iterator pointing to the element to erase
-	 */
-	locus_iterator erase(locus_iterator itr) {_cached_case = false; _cached_control = false; _variants.erase(itr++); return itr; }
+	//! The variants of the bin, in order of position
+	const_locus_iterator variantBegin() const {return const_locus_iterator(_loci, _var_begin);}
+	const_locus_iterator variantEnd() const {return const_locus_iterator(_loci, _var_end);}
 
 	/*!
 	 * \brief Adds extraconversion data to the bin.
@@ -150,9 +149,23 @@ public:
 
 
 private:
+	// The BinManager decides the variants of the bin
+	friend class BinManager;
+
 	// No assignment, please!
 	Bin& operator=(const Bin& other);
 
+	/*!
+	 * \brief Sets the variants of the bin.
+	 * The variants are given as a range of indexes into an array of loci, both
+	 * of which belong to the caller and must outlive the bin.
+	 *
+	 * \param loci The array of loci, sorted by position
+	 * \param begin The first index of the bin's loci, in increasing order
+	 * \param end One past the last index of the bin's loci
+	 */
+	void setVariants(Knowledge::Locus* const* loci, const unsigned int* begin, const unsigned int* end);
+
 	union{
 		Knowledge::Group* group;
 		Knowledge::Region* region;
@@ -172,7 +185,10 @@ private:
 	std::string _name;
 	std::vector<std::string> _extra_data;
 
-	std::set<Knowledge::Locus*> _variants;
+	// The variants are [_var_begin, _var_end), as indexes into _loci
+	Knowledge::Locus* const* _loci;
+	const unsigned int* _var_begin;
+	const unsigned int* _var_end;
 
 	const PopulationManager& _pop_mgr;
 
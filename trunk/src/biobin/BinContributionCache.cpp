@@ -0,0 +1,127 @@
+/*
+ * BinContributionCache.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "BinContributionCache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "Bin.h"
+#include "PopulationManager.h"
+
+using std::vector;
+using std::pair;
+
+namespace BioBin{
+
+void BinContributionCache::init(){
+	_n_samples = _pop_mgr.getNumSamples();
+	_row.assign(_n_samples, 0);
+	_in_row.assign(_n_samples, false);
+}
+
+void BinContributionCache::addBin(const Bin& bin){
+	_bin_row[&bin] = _row_start.size();
+	_row_start.push_back(_samples.size());
+
+	// Accumulate in the same order as getTotalIndivContrib, so the sums are
+	// exactly the same
+	Bin::const_locus_iterator l_itr = bin.variantBegin();
+	for( ; l_itr != bin.variantEnd(); ++l_itr){
+		_carriers.clear();
+		_pop_mgr.getCarriers(**l_itr, _carriers);
+		if(_carriers.empty()){
+			continue;
+		}
+
+		float wt = _pop_mgr.getLocusWeight(**l_itr, _pheno, bin.getRegion());
+		vector<pair<unsigned int, unsigned char> >::const_iterator c_itr = _carriers.begin();
+		for( ; c_itr != _carriers.end(); ++c_itr){
+			unsigned int pos = (*c_itr).first;
+			if(!_in_row[pos]){
+				_in_row[pos] = true;
+				_row_samples.push_back(pos);
+			}
+			_row[pos] += (*c_itr).second * wt;
+		}
+	}
+
+	std::sort(_row_samples.begin(), _row_samples.end());
+	vector<unsigned int>::const_iterator s_itr = _row_samples.begin();
+	for( ; s_itr != _row_samples.end(); ++s_itr){
+		_samples.push_back(*s_itr);
+		_contribs.push_back(_row[*s_itr]);
+		_row[*s_itr] = 0;
+		_in_row[*s_itr] = false;
+	}
+	_row_samples.clear();
+}
+
+void BinContributionCache::finish(){
+	_row_start.push_back(_samples.size());
+
+	// release the working space
+	vector<float>().swap(_row);
+	vector<bool>().swap(_in_row);
+	vector<unsigned int>().swap(_row_samples);
+	vector<pair<unsigned int, unsigned char> >().swap(_carriers);
+}
+
+float BinContributionCache::getContrib(const Bin& bin, unsigned int pos) const{
+	boost::unordered_map<const Bin*, unsigned int>::const_iterator r_itr = _bin_row.find(&bin);
+	if(r_itr == _bin_row.end()){
+		return _pop_mgr.getTotalIndivContrib(bin, pos, _pheno);
+	}
+
+	vector<unsigned int>::const_iterator begin = _samples.begin() + _row_start[(*r_itr).second];
+	vector<unsigned int>::const_iterator end = _samples.begin() + _row_start[(*r_itr).second + 1];
+	vector<unsigned int>::const_iterator itr = std::lower_bound(begin, end, pos);
+	if(itr != end && *itr == pos){
+		return _contribs[itr - _samples.begin()];
+	}
+	return 0;
+}
+
+void BinContributionCache::getContribs(const Bin& bin, vector<float>& contrib_out) const{
+	boost::unordered_map<const Bin*, unsigned int>::const_iterator r_itr = _bin_row.find(&bin);
+	if(r_itr == _bin_row.end()){
+		contrib_out.resize(_n_samples);
+		for(unsigned int i=0; i<_n_samples; i++){
+			contrib_out[i] = _pop_mgr.getTotalIndivContrib(bin, i, _pheno);
+		}
+		return;
+	}
+
+	contrib_out.assign(_n_samples, 0);
+	for(unsigned int i=_row_start[(*r_itr).second]; i<_row_start[(*r_itr).second + 1]; i++){
+		contrib_out[_samples[i]] = _contribs[i];
+	}
+}
+
+void BinContributionCache::getNonzeroContribs(const Bin& bin, vector<unsigned int>& samples_out,
+		vector<float>& contrib_out) const{
+	samples_out.clear();
+	contrib_out.clear();
+
+	boost::unordered_map<const Bin*, unsigned int>::const_iterator r_itr = _bin_row.find(&bin);
+	if(r_itr == _bin_row.end()){
+		for(unsigned int i=0; i<_n_samples; i++){
+			float c = _pop_mgr.getTotalIndivContrib(bin, i, _pheno);
+			if(c != 0){
+				samples_out.push_back(i);
+				contrib_out.push_back(c);
+			}
+		}
+		return;
+	}
+
+	samples_out.assign(_samples.begin() + _row_start[(*r_itr).second],
+			_samples.begin() + _row_start[(*r_itr).second + 1]);
+	contrib_out.assign(_contribs.begin() + _row_start[(*r_itr).second],
+			_contribs.begin() + _row_start[(*r_itr).second + 1]);
+}
+
+}
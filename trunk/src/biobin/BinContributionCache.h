@@ -0,0 +1,106 @@
+/*
+ * BinContributionCache.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_BINCONTRIBUTIONCACHE_H
+#define BIOBIN_BINCONTRIBUTIONCACHE_H
+
+#include <vector>
+#include <utility>
+
+#include <boost/unordered_map.hpp>
+
+#include "util/Phenotype.h"
+
+namespace BioBin{
+
+class Bin;
+class PopulationManager;
+
+/*!
+ * \brief The weighted contribution of every sample to every bin of a
+ * BinManager, for a single phenotype.
+ *
+ * The contributions are computed once, walking only the carriers of each
+ * locus, and are then shared by all of the tests and the bin reports.  They
+ * are identical to those given by PopulationManager::getTotalIndivContrib.
+ *
+ * Since most samples carry none of the (rare) variants in a bin, each bin
+ * is stored as a sorted list of the samples with a non-zero contribution,
+ * and all bins are packed into a single array (compressed sparse rows).
+ */
+class BinContributionCache{
+public:
+	/*!
+	 * \brief Computes the contributions to every bin in the given container
+	 * of Bin pointers (usually a BinManager).
+	 */
+	template <class Bin_ptr_cont>
+	BinContributionCache(const PopulationManager& pop_mgr, const Bin_ptr_cont& bins,
+			const Utility::Phenotype& pheno);
+
+	/*!
+	 * \brief Returns the contribution of the sample at the given position
+	 * (as in PopulationManager::getIndivGeno) to the bin.
+	 */
+	float getContrib(const Bin& bin, unsigned int pos) const;
+
+	/*!
+	 * \brief Fills contrib_out with the contribution of every sample to the
+	 * bin, indexed by sample position.
+	 */
+	void getContribs(const Bin& bin, std::vector<float>& contrib_out) const;
+
+	/*!
+	 * \brief Fills samples_out with the positions of the samples that carry
+	 * a variant in the bin, in order, and contrib_out with their
+	 * contributions; every other sample contributes 0.
+	 */
+	void getNonzeroContribs(const Bin& bin, std::vector<unsigned int>& samples_out,
+			std::vector<float>& contrib_out) const;
+
+private:
+	// No copying or assignment!
+	BinContributionCache(const BinContributionCache&);
+	BinContributionCache& operator=(const BinContributionCache&);
+
+	void init();
+	void addBin(const Bin& bin);
+	void finish();
+
+	const PopulationManager& _pop_mgr;
+	const Utility::Phenotype& _pheno;
+	unsigned int _n_samples;
+
+	// row of each bin
+	boost::unordered_map<const Bin*, unsigned int> _bin_row;
+
+	// the entries of row i are in [_row_start[i], _row_start[i+1])
+	std::vector<unsigned int> _row_start;
+	std::vector<unsigned int> _samples;
+	std::vector<float> _contribs;
+
+	// Working space used while adding bins
+	std::vector<float> _row;
+	std::vector<bool> _in_row;
+	std::vector<unsigned int> _row_samples;
+	std::vector<std::pair<unsigned int, unsigned char> > _carriers;
+};
+
+template <class Bin_ptr_cont>
+BinContributionCache::BinContributionCache(const PopulationManager& pop_mgr,
+		const Bin_ptr_cont& bins, const Utility::Phenotype& pheno) :
+		_pop_mgr(pop_mgr), _pheno(pheno), _n_samples(0) {
+	init();
+	typename Bin_ptr_cont::const_iterator b_itr = bins.begin();
+	for( ; b_itr != bins.end(); ++b_itr){
+		addBin(**b_itr);
+	}
+	finish();
+}
+
+}
+
+#endif /* BIOBIN_BINCONTRIBUTIONCACHE_H */
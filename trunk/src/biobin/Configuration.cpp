@@ -165,7 +165,13 @@ void Configuration::initGeneric(){
 				"The location of the database")
 		("vcf-file,V",value<string>(&Main::c_vcf_file), "The file containing VCF information")
 		("threads,t", value<unsigned int>(&BinApplication::n_threads)->default_value(1),
-				"Number of threads to use when PheWAS binning")
+				"Number of threads to use when reading the VCF, PheWAS binning and running the tests")
+		("vcf-use-index", value<Bool>()->default_value(false),
+				"Use the tabix or CSI index of a bgzipped VCF to read only loci in the requested regions")
+		("genotype-cache", value<string>(&PopulationManager::c_genotype_cache),
+				"Binary file to cache the loci and genotypes read from the VCF.  Created on the first run and reused by later runs with the same VCF and settings")
+		("knowledge-cache", value<string>(&BinApplication::c_knowledge_cache),
+				"Binary file to cache the regions, groups and roles read from the database.  Created on the first run and reused by later runs with the same database and settings")
 		("add-group", value<vector<string> >()->composing(),
 				"A list of filenames containing a group collection definition")
 		("genomic-build,G",value<string>(&Main::c_genome_build),
@@ -292,6 +298,8 @@ void Configuration::parseOptions(const po::variables_map& vm){
 	PopulationManager::c_drop_missing_pheno_samples = vm["drop-missing-phenotype-samples"].as<Bool>();
 	PopulationManager::c_force_all_control = vm["force-all-control"].as<Bool>();
 	PopulationManager::c_set_star_referent = vm["set-star-referent"].as<Bool>();
+	PopulationManager::c_n_threads = BinApplication::n_threads;
+	PopulationManager::c_use_vcf_index = vm["vcf-use-index"].as<Bool>();
 	Test::SKATUtils::skat_raw_pvalues = vm["skat-raw-pvalues"].as<Bool>();
 
 	if(vm.count("add-groups")){
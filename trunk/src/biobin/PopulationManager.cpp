@@ -9,6 +9,7 @@
 
 #include "binapplication.h"
 #include "binmanager.h"
+#include "BinContributionCache.h"
 
 #include "tests/Test.h"
 #include "main.h"
@@ -17,9 +18,13 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/program_options.hpp>
+#include <boost/bind.hpp>
+#include <boost/functional/hash.hpp>
 #include <math.h>
+#include <sys/stat.h>
 
 #include <iostream>
+#include <sstream>
 #include <limits>
 
 using std::fill;
@@ -70,33 +75,82 @@ std::string PopulationManager::c_exclude_samples = "";
 bool PopulationManager::c_drop_missing_pheno_samples = false;
 bool PopulationManager::c_force_all_control = false;
 bool PopulationManager::c_set_star_referent = true;
+unsigned int PopulationManager::c_n_threads = 0;
+bool PopulationManager::c_use_vcf_index = false;
+std::string PopulationManager::c_genotype_cache = "";
 
 PopulationManager::PopulationManager(const string& vcf_fn) :
-		_vcf_fn(vcf_fn), _use_custom_weight(false), _info(0){
+		_vcf_fn(vcf_fn), _use_custom_weight(false), _info(0), _use_load_bounds(false){
+}
+
+void PopulationManager::getIndexIntervals(const string& seq_name,
+		vector<std::pair<unsigned int, unsigned int> >& intervals_out) const{
+
+	intervals_out.clear();
+	Knowledge::RegionCollection::bound_map::const_iterator b_itr =
+			_load_bounds.find(Locus::getChrom(seq_name));
+	if(b_itr == _load_bounds.end()){
+		return;
+	}
+
+	// Convert to 0-based, half open intervals, merging any overlaps
+	vector<std::pair<unsigned int, unsigned int> > bounds((*b_itr).second);
+	std::sort(bounds.begin(), bounds.end());
+	vector<std::pair<unsigned int, unsigned int> >::const_iterator itr = bounds.begin();
+	for( ; itr != bounds.end(); ++itr){
+		unsigned int beg = (*itr).first - 1;
+		unsigned int end = (*itr).second;
+		if(!intervals_out.empty() && beg <= intervals_out.back().second){
+			intervals_out.back().second = std::max(intervals_out.back().second, end);
+		} else {
+			intervals_out.push_back(std::make_pair(beg, end));
+		}
+	}
 }
 
 unsigned int PopulationManager::genotypeContribution(const Locus& loc, const dynamic_bitset<>* nonmiss) const{
-	unordered_map<const Locus*, bitset_pair>::const_iterator itr = _genotypes.find(&loc);
+	unsigned int ord = loc.getOrdinal();
+	if(ord >= _genotypes.size()){
+		return 0;
+	}
 
-	if(itr != _genotypes.end()){
-		return getTotalContrib((*itr).second, nonmiss);
-	} else {
+	vector<word_type> mask;
+	unsigned int n_mask = 0;
+	if(nonmiss){
+		n_mask = _genotypes.getWords(*nonmiss, mask);
+	}
+
+	unsigned int n_nonmiss, n_first, n_second;
+	_genotypes.count(ord, nonmiss ? &mask[0] : 0, n_mask, n_nonmiss, n_first, n_second);
+	return getTotalContrib(n_first, n_second);
+}
+
+unsigned int PopulationManager::genotypeContribution(const Locus& loc, const Phenotype& pheno, bool cases) const{
+	unsigned int ord = loc.getOrdinal();
+	if(ord >= _genotypes.size()){
 		return 0;
 	}
+
+	const LocusSummary& summ = _locus_summary[pheno.getIndex()];
+	return getTotalContrib(summ.n_first[cases][ord], summ.n_second[cases][ord]);
 }
 
 float PopulationManager::getAvgGenotype(const Locus& loc, const dynamic_bitset<>* nonmiss_status) const{
-	unordered_map<const Locus*, bitset_pair>::const_iterator itr = _genotypes.find(&loc);
+	unsigned int ord = loc.getOrdinal();
 	unsigned int n_vars = 0;
 	float nonmiss = 1;
 
-	if(itr != _genotypes.end()){
-		n_vars =  getTotalContrib((*itr).second, nonmiss_status);
+	if(ord < _genotypes.size()){
+		vector<word_type> mask;
+		unsigned int n_mask = 0;
 		if(nonmiss_status){
-			nonmiss = (*nonmiss_status & (~((*itr).second.first & (*itr).second.second))).count();
-		} else {
-			nonmiss = (~((*itr).second.first & (*itr).second.second)).count();
+			n_mask = _genotypes.getWords(*nonmiss_status, mask);
 		}
+
+		unsigned int n_nonmiss, n_first, n_second;
+		_genotypes.count(ord, nonmiss_status ? &mask[0] : 0, n_mask, n_nonmiss, n_first, n_second);
+		n_vars = getTotalContrib(n_first, n_second);
+		nonmiss = n_nonmiss;
 	}
 
 	// will return 0 for a missing locus
@@ -104,15 +158,14 @@ float PopulationManager::getAvgGenotype(const Locus& loc, const dynamic_bitset<>
 }
 
 unsigned short PopulationManager::getIndivGeno(const Locus& loc, int pos) const{
-	unordered_map<const Knowledge::Locus*, bitset_pair>::const_iterator it = _genotypes.find(&loc);
-	if(it == _genotypes.end()){
+	unsigned int ord = loc.getOrdinal();
+	if(ord >= _genotypes.size()){
 		return missing_geno;
 	}
 
-	unsigned short n_var = 2*(*it).second.first[pos] + (*it).second.second[pos];
+	unsigned short n_var = _genotypes.get(ord, pos);
 
-	if(n_var == 3){
-		// if we're here, then we had both bits set to 1, which means missing
+	if(n_var == Utility::GenotypeStore::MISSING){
 		n_var = missing_geno;
 	}else if(c_model == DOMINANT){
 		n_var = n_var > 0;
@@ -124,17 +177,44 @@ unsigned short PopulationManager::getIndivGeno(const Locus& loc, int pos) const{
 
 }
 
-bool PopulationManager::isRare(const Locus& locus, const bitset_pair& status, float lower, float upper) const{
+void PopulationManager::getCarriers(const Locus& loc, vector<std::pair<unsigned int, unsigned char> >& carriers_out) const{
+	unsigned int ord = loc.getOrdinal();
+	if(ord >= _genotypes.size()){
+		return;
+	}
+
+	unsigned int start = carriers_out.size();
+	_genotypes.getCarriers(ord, carriers_out);
+
+	if(c_model == DOMINANT){
+		for(unsigned int i=start; i<carriers_out.size(); i++){
+			carriers_out[i].second = 1;
+		}
+	} else if(c_model == RECESSIVE){
+		// only the homozygous samples contribute
+		vector<std::pair<unsigned int, unsigned char> >::iterator out_itr = carriers_out.begin() + start;
+		for(unsigned int i=start; i<carriers_out.size(); i++){
+			if(carriers_out[i].second == Utility::GenotypeStore::HOM){
+				*out_itr = std::make_pair(carriers_out[i].first, 1);
+				++out_itr;
+			}
+		}
+		carriers_out.erase(out_itr, carriers_out.end());
+	}
+}
+
+bool PopulationManager::isRare(const Locus& locus, const Phenotype& pheno, float lower, float upper) const{
 	bool rare = false;
 	float currmaf;
 
-	unordered_map<const Locus*, bitset_pair>::const_iterator g_itr = _genotypes.find(&locus);
-	if(g_itr != _genotypes.end()){
-		currmaf = getMAF((*g_itr).second, & status.first);
+	unsigned int ord = locus.getOrdinal();
+	if(ord < _genotypes.size()){
+		const LocusSummary& summ = _locus_summary[pheno.getIndex()];
+		currmaf = summ.maf[0][ord];
 		rare = currmaf <= upper && currmaf >= lower;
 
 		if(!rare && RareCaseControl){
-			currmaf = getMAF((*g_itr).second, & status.second);
+			currmaf = summ.maf[1][ord];
 			rare = currmaf <= upper && currmaf >= lower;
 		}
 	}
@@ -145,14 +225,11 @@ bool PopulationManager::isRare(const Locus& locus, const bitset_pair& status, fl
 /**
  * Returns false in case locus has no non-major allele overlapping with a non-missing phenotype
  */
-bool PopulationManager::isPresent(const Locus& locus, const bitset_pair& status) const{
-	unordered_map<const Locus*, bitset_pair>::const_iterator g_itr = _genotypes.find(&locus);
-	if (g_itr != _genotypes.end()) {
-		boost::dynamic_bitset<> nonmissing = ~((*g_itr).second.first & (*g_itr).second.second);
-		if (&status != 0) {
-			nonmissing &= (status.first | status.second);
-			return (nonmissing.count() > 0);
-		}
+bool PopulationManager::isPresent(const Locus& locus, const Phenotype& pheno) const{
+	unsigned int ord = locus.getOrdinal();
+	if (ord < _genotypes.size()) {
+		const LocusSummary& summ = _locus_summary[pheno.getIndex()];
+		return summ.n_nonmiss[0][ord] + summ.n_nonmiss[1][ord] > 0;
 	}
 	return false;
 }
@@ -259,6 +336,469 @@ unsigned int PopulationManager::readVCFHeader(std::istream& v){
 	return lineno;
 }
 
+PopulationManager::VCFParseState::VCFParseState(unsigned int n) :
+		n_fields(n), geno_sep('/'), alt_geno_sep('|'), log(&std::cerr) {
+	fields.reserve(n_fields);
+	calls.reserve(n_fields);
+	alleles.reserve(4);
+	call_count.reserve(4);
+}
+
+void PopulationManager::UnliftedLog::write(const Locus& loc){
+	if(!_out.is_open()){
+		_out.open(_fn.c_str());
+		std::cerr << "WARNING: Some variants not lifted!  See "
+				  << _fn << " for details." << std::endl;
+
+		_out << "Chrom" << _sep << "Pos" << _sep << "ID" << std::endl;
+	}
+	loc.print(_out, _sep);
+	_out << std::endl;
+
+	if(_cache){
+		_cache->writeUnlifted(loc.getChrom(), loc.getPos(), loc.getID());
+	}
+}
+
+boost::uint64_t PopulationManager::getCacheKey(const string& build, int chain_count) const{
+	// Anything that changes which loci are loaded or how their genotypes are
+	// encoded must go into the key
+	std::size_t key = 0;
+	boost::hash_combine(key, _vcf_fn);
+	struct stat vcf_stat;
+	if(stat(_vcf_fn.c_str(), &vcf_stat) == 0){
+		boost::hash_combine(key, vcf_stat.st_size);
+		boost::hash_combine(key, vcf_stat.st_mtime);
+	}
+	boost::hash_combine(key, build);
+	boost::hash_combine(key, chain_count);
+	boost::hash_combine(key, c_keep_monomorphic);
+	boost::hash_combine(key, c_set_star_referent);
+	// hasContrib drops loci that do not contribute under the disease model
+	boost::hash_combine(key, static_cast<int>(c_model));
+	boost::hash_combine(key, _sample_names);
+	for(unsigned int i=0; i<_include_samples.size(); i++){
+		boost::hash_combine(key, static_cast<bool>(_include_samples[i]));
+	}
+
+	boost::hash_combine(key, _use_load_bounds);
+	Knowledge::RegionCollection::bound_map::const_iterator b_itr = _load_bounds.begin();
+	for( ; b_itr != _load_bounds.end(); ++b_itr){
+		boost::hash_combine(key, (*b_itr).first);
+		boost::hash_combine(key, (*b_itr).second);
+	}
+
+	return key;
+}
+
+bool PopulationManager::parseVCFRecord(const char* line_begin, const char* line_end,
+		unsigned int lineno, VCFParseState& state) const{
+
+	if(line_end - line_begin <= 2 || *line_begin == '#'){
+		return false;
+	}
+
+	// In this case, we're looking at a marker
+	Utility::VCFRecord& fields = state.fields;
+	if(fields.tokenize(line_begin, line_end) != state.n_fields){
+		(*state.log) << "ERROR: Mismatched number of fields on line "
+				<< lineno << std::endl;
+		(*state.log) << "Expected # of fields: " << state.n_fields << std::endl;
+		(*state.log) << "Seen # of fields: " << fields.size() << std::endl;
+		(*state.log) << "Line size: " << (line_end - line_begin) << std::endl;
+		(*state.log) << "Last field: " << fields[fields.size() - 1] << std::endl;
+		if(fields.size() > 1){
+			(*state.log) << "2nd to Last field: " << fields[fields.size() - 2] << std::endl;
+		}
+		// throw exception here
+		throw std::runtime_error("Mismatched number of fields in VCF file");
+	}
+
+	// check for marker-level inclusion
+	return Utility::VCFRecord::equals(fields[6], ".") ||
+			Utility::VCFRecord::equals(fields[6], "PASS");
+}
+
+Locus* PopulationManager::createVCFLocus(const VCFParseState& state,
+		const Knowledge::Liftover::Converter& conv, int chain_count, Locus*& unlifted_out) const{
+
+	const Utility::VCFRecord& fields = state.fields;
+
+	// construct a locus object and lift over, if necessary
+	Locus* loc = new Locus(string(fields[0].begin(), fields[0].end()),
+			lexical_cast<unsigned int>(fields[1]),
+			string(fields[2].begin(), fields[2].end()),
+			string(fields[3].begin(), fields[3].end()));
+
+	unlifted_out = 0;
+	if(chain_count > 0){
+		Locus* new_loc = conv.convertLocus(*loc);
+		// make sure to drop loci that lift to unknown chromosomes, too!
+		if (! new_loc || new_loc->getChrom() == Locus::UNKNOWN_CHROM){
+			delete new_loc;
+			unlifted_out = loc;
+			loc = 0;
+		}else{
+			delete loc;
+			loc = new_loc;
+		}
+	}
+
+	return loc;
+}
+
+bool PopulationManager::parseVCFGenotypes(VCFParseState& state, unsigned int lineno,
+		bitset_pair& geno_out) const{
+
+	typedef Utility::VCFRecord::string_view string_view;
+
+	const Utility::VCFRecord& fields = state.fields;
+
+	// get a list of all the alleles, in the correct order
+	state.alleles.clear();
+	state.alleles.push_back(fields[3]);
+	const char* pos = fields[4].begin();
+	do{
+		state.alleles.push_back(Utility::VCFRecord::nextToken(pos, fields[4].end(), ','));
+	} while(pos != fields[4].end());
+
+	// initialize the call count so I can easily determine the major allele
+	std::vector<unsigned int>& call_count = state.call_count;
+	call_count.clear();
+	call_count.resize(state.alleles.size(), 0);
+
+	// parse the format string
+	unsigned int gt_idx = static_cast<unsigned int>(-1);
+	unsigned int ft_idx = static_cast<unsigned int>(-1);
+	pos = fields[8].begin();
+	for(unsigned int i=0; pos != fields[8].end(); i++){
+		string_view fmt = Utility::VCFRecord::nextToken(pos, fields[8].end(), ':');
+		if(gt_idx == static_cast<unsigned int>(-1) && Utility::VCFRecord::equals(fmt, "GT")){
+			gt_idx = i;
+		} else if(ft_idx == static_cast<unsigned int>(-1) && Utility::VCFRecord::equals(fmt, "FT")){
+			ft_idx = i;
+		}
+	}
+
+	if(gt_idx == static_cast<unsigned int>(-1)){
+		(*state.log) << "ERROR: No 'GT' format on line " << lineno <<
+				", cannot continue." << std::endl;
+		throw std::runtime_error("No GT given in format string");
+	}
+
+	const std::pair<unsigned short, unsigned short> missing_call(missing_geno, missing_geno);
+	std::vector<std::pair<unsigned short, unsigned short> >& calls = state.calls;
+	calls.clear();
+	for (unsigned int i=0; i<fields.size() - 9; i++){
+		if (!_include_samples[i]) {
+			continue;
+		}
+
+		const string_view& samp = fields[i+9];
+		if(Utility::VCFRecord::equals(samp, ".")){
+			calls.push_back(missing_call);
+			continue;
+		}
+
+		// Trailing fields may be dropped from a sample, so a missing FT is
+		// treated as "." and a missing GT as a missing call
+		if(ft_idx != static_cast<unsigned int>(-1)){
+			string_view ft = Utility::VCFRecord::getToken(samp.begin(), samp.end(), ':', ft_idx);
+			if(!ft.empty() && !Utility::VCFRecord::equals(ft, "PASS") &&
+					!Utility::VCFRecord::equals(ft, ".")){
+				calls.push_back(missing_call);
+				continue;
+			}
+		}
+
+		string_view gt = Utility::VCFRecord::getToken(samp.begin(), samp.end(), ':', gt_idx);
+		const char* sep_pos = static_cast<const char*>(memchr(gt.begin(), state.geno_sep, gt.size()));
+		if(!sep_pos){
+			// we should be here very rarely!  If we're here,
+			// we'll assume that the "primary" separator of
+			// genotypes is in fact the "alternate", so swap them!
+			sep_pos = static_cast<const char*>(memchr(gt.begin(), state.alt_geno_sep, gt.size()));
+			std::swap(state.geno_sep, state.alt_geno_sep);
+		}
+
+		string_view c1(gt.begin(), sep_pos ? sep_pos : gt.end());
+		string_view c2(sep_pos ? sep_pos + 1 : gt.end(), gt.end());
+
+		if(!sep_pos || memchr(c2.begin(), *sep_pos, c2.size())){
+			if(!gt.empty() && !Utility::VCFRecord::equals(gt, ".")){
+				(*state.log) << "WARNING: Non-diploid genotype '" << gt << "' found on line " <<
+					lineno << ", setting to missing" << std::endl;
+			}
+			calls.push_back(missing_call);
+		} else if(c1.empty() || c2.empty() || *c1.begin() == '.' || *c2.begin() == '.'){
+			calls.push_back(missing_call);
+		} else {
+			unsigned short g1 = fast_atoi(c1);
+			unsigned short g2 = fast_atoi(c2);
+			if(g1 >= state.alleles.size() || g2 >= state.alleles.size()){
+				(*state.log) << "WARNING: Genotype '" << gt << "' references an unknown allele on line " <<
+					lineno << ", setting to missing" << std::endl;
+				calls.push_back(missing_call);
+				continue;
+			}
+			bool star1 = Utility::VCFRecord::equals(state.alleles[g1], "*");
+			bool star2 = Utility::VCFRecord::equals(state.alleles[g2], "*");
+			if (c_set_star_referent) {
+				g1 = star1 ? 0 : g1;
+				g2 = star2 ? 0 : g2;
+			} else if(star1 || star2) {
+				calls.push_back(missing_call);
+				continue;
+			}
+			calls.push_back(std::make_pair(g1, g2));
+			++call_count[g1];
+			++call_count[g2];
+		}
+	} // end iterating over genotypes
+
+	// OK, now we'll find the major allele
+	unsigned short curr_max = 0;
+	unsigned int max_count = call_count[0];
+	for(unsigned short i=1; i<call_count.size(); i++){
+		if(call_count[i] > max_count){
+			curr_max = i;
+			max_count = call_count[i];
+		}
+	}
+
+	// let's make sure that this isn't monoporphic
+	std::sort(call_count.begin(), call_count.end());
+	if(!c_keep_monomorphic && (call_count.size() < 2 || call_count[call_count.size() - 2] == 0)){
+		return false;
+	}
+
+	geno_out.first.clear();
+	geno_out.first.resize(calls.size());
+	geno_out.second.clear();
+	geno_out.second.resize(calls.size());
+
+	for(unsigned int i=0; i<calls.size(); i++){
+		const std::pair<unsigned short, unsigned short>& curr_call = calls[i];
+
+		if(curr_call.first == missing_geno || curr_call.second == missing_geno){
+			geno_out.first.set(i);
+			geno_out.second.set(i);
+		} else if (curr_call.first != curr_max && curr_call.second != curr_max){
+			geno_out.first.set(i);
+		} else if (curr_call.first != curr_max || curr_call.second != curr_max) {
+			geno_out.second.set(i);
+		}
+	}
+
+	// again, make sure it isn't monomorphic with regards to the
+	// disease encoding
+	return c_keep_monomorphic || hasContrib(geno_out);
+}
+
+PopulationManager::VCFPipeline::VCFPipeline(const PopulationManager& pop_mgr,
+		const char* data_begin, const char* data_end, std::istream* data_stream,
+		unsigned int lineno, const Knowledge::Liftover::Converter& conv,
+		int chain_count, unsigned int n_threads) :
+		_pop_mgr(pop_mgr), _conv(conv), _chain_count(chain_count),
+		_data_pos(data_begin), _data_end(data_end), _data_stream(data_stream),
+		_lineno(lineno), _curr(0), _max_batches(2*n_threads + 2), _eof(false),
+		_stop(false) {
+
+	for(unsigned int i=0; i<n_threads; i++){
+		_workers.create_thread(boost::bind(&VCFPipeline::work, this));
+	}
+}
+
+PopulationManager::VCFPipeline::~VCFPipeline(){
+	{
+		boost::unique_lock<boost::mutex> l(_lock);
+		_stop = true;
+	}
+	_space_cond.notify_all();
+	_workers.join_all();
+
+	// Anything left here was never committed (i.e. we're unwinding an error)
+	if(_curr){
+		_batches.push_front(_curr);
+	}
+	for(std::deque<VCFBatch*>::iterator itr = _batches.begin(); itr != _batches.end(); ++itr){
+		for(vector<VCFResult>::iterator r_itr = (*itr)->results.begin(); r_itr != (*itr)->results.end(); ++r_itr){
+			delete (*r_itr).locus;
+		}
+		delete *itr;
+	}
+	for(vector<VCFBatch*>::iterator itr = _free.begin(); itr != _free.end(); ++itr){
+		delete *itr;
+	}
+}
+
+PopulationManager::VCFBatch* PopulationManager::VCFPipeline::next(){
+	boost::unique_lock<boost::mutex> l(_lock);
+	if(_curr){
+		recycle(_curr);
+		_curr = 0;
+	}
+
+	while(!(_batches.empty() ? _eof : _batches.front()->done)){
+		_ready_cond.wait(l);
+	}
+
+	if(_batches.empty()){
+		return 0;
+	}
+
+	_curr = _batches.front();
+	_batches.pop_front();
+	_space_cond.notify_one();
+
+	std::cerr << _curr->log;
+	if(!_curr->error.empty()){
+		throw std::runtime_error(_curr->error);
+	}
+	return _curr;
+}
+
+void PopulationManager::VCFPipeline::recycle(VCFBatch* batch){
+	batch->results.clear();
+	batch->lines.clear();
+	batch->text.clear();
+	batch->log.clear();
+	batch->error.clear();
+	batch->done = false;
+	_free.push_back(batch);
+}
+
+bool PopulationManager::VCFPipeline::readBatch(VCFBatch& batch){
+	// Batches are cut at either a number of lines or a number of bytes,
+	// whichever comes first, so that wide (many sample) files still get
+	// split into reasonably sized pieces of work
+	static const unsigned int MAX_LINES = 4096;
+	static const std::size_t MAX_BYTES = 4 << 20;
+
+	batch.first_line = _lineno + 1;
+	std::size_t n_bytes = 0;
+
+	if(_data_stream){
+		vector<std::pair<std::size_t, std::size_t> > offsets;
+		string curr_line;
+		while(_data_stream->good() && batch.lines.size() + offsets.size() < MAX_LINES && n_bytes < MAX_BYTES){
+			getline(*_data_stream, curr_line);
+			++_lineno;
+			offsets.push_back(std::make_pair(batch.text.size(), batch.text.size() + curr_line.size()));
+			batch.text.insert(batch.text.end(), curr_line.begin(), curr_line.end());
+			n_bytes += curr_line.size();
+		}
+		// The text may have moved while growing, so only now make pointers
+		const char* base = batch.text.empty() ? 0 : &batch.text[0];
+		for(unsigned int i=0; i<offsets.size(); i++){
+			batch.lines.push_back(std::make_pair(base + offsets[i].first, base + offsets[i].second));
+		}
+		return _data_stream->good();
+	}
+
+	while(_data_pos < _data_end && batch.lines.size() < MAX_LINES && n_bytes < MAX_BYTES){
+		const char* line_end = static_cast<const char*>(
+				memchr(_data_pos, '\n', _data_end - _data_pos));
+		if(!line_end){
+			line_end = _data_end;
+		}
+		++_lineno;
+		batch.lines.push_back(std::make_pair(_data_pos, line_end));
+		n_bytes += line_end - _data_pos;
+		_data_pos = line_end + 1;
+	}
+	return _data_pos < _data_end;
+}
+
+void PopulationManager::VCFPipeline::parseBatch(VCFBatch& batch, VCFParseState& state){
+	// Hold on to any messages until the batch is committed, so they come out
+	// in file order
+	std::ostringstream batch_log;
+	state.log = &batch_log;
+	try{
+		for(unsigned int i=0; i<batch.lines.size(); i++){
+			unsigned int lineno = batch.first_line + i;
+			if(!_pop_mgr.parseVCFRecord(batch.lines[i].first, batch.lines[i].second, lineno, state)){
+				continue;
+			}
+
+			Locus* unlifted_loc = 0;
+			Locus* loc = _pop_mgr.createVCFLocus(state, _conv, _chain_count, unlifted_loc);
+			if(unlifted_loc){
+				batch.results.push_back(VCFResult());
+				batch.results.back().locus = unlifted_loc;
+				batch.results.back().unlifted = true;
+			}
+
+			if(loc){
+				batch.results.push_back(VCFResult());
+				if(_pop_mgr.parseVCFGenotypes(state, lineno, batch.results.back().genotypes)){
+					batch.results.back().locus = loc;
+				} else {
+					batch.results.pop_back();
+					delete loc;
+				}
+			}
+		}
+	} catch(const std::exception& e){
+		batch.error = e.what();
+	}
+	batch.log = batch_log.str();
+	state.log = &std::cerr;
+}
+
+void PopulationManager::VCFPipeline::work(){
+	VCFParseState state(9 + _pop_mgr._positions.size());
+
+	while(true){
+		VCFBatch* batch = 0;
+		{
+			// Only one thread reads at a time, and batches are queued while
+			// still holding the read lock, so the queue is in file order
+			boost::unique_lock<boost::mutex> rl(_read_lock);
+			{
+				boost::unique_lock<boost::mutex> l(_lock);
+				while(!_stop && !_eof && _batches.size() >= _max_batches){
+					_space_cond.wait(l);
+				}
+				if(_stop || _eof){
+					break;
+				}
+				if(_free.empty()){
+					batch = new VCFBatch();
+				} else {
+					batch = _free.back();
+					_free.pop_back();
+				}
+			}
+
+			bool more = readBatch(*batch);
+
+			boost::unique_lock<boost::mutex> l(_lock);
+			_eof = _eof || !more;
+			if(batch->lines.empty()){
+				_free.push_back(batch);
+				_ready_cond.notify_all();
+				continue;
+			}
+			_batches.push_back(batch);
+		}
+
+		parseBatch(*batch, state);
+
+		boost::unique_lock<boost::mutex> l(_lock);
+		batch->done = true;
+		if(!batch->error.empty()){
+			// No sense in parsing any more of the file
+			_eof = true;
+		}
+		_ready_cond.notify_all();
+	}
+
+	_space_cond.notify_all();
+	_ready_cond.notify_all();
+}
+
 void PopulationManager::loadIndividuals(){
 
 	if(c_covariate_file != ""){
@@ -506,8 +1046,6 @@ void PopulationManager::parseTraitFile(const string& filename,
 
 float PopulationManager::getIndivContrib(const Locus& loc, int pos, const Utility::Phenotype& pheno, bool useWeights, const Region* const reg) const{
 
-	unordered_map<const Knowledge::Locus*, bitset_pair>::const_iterator it = _genotypes.find(&loc);
-
 	unsigned short n_var = getIndivGeno(loc, pos);
 
 	float wt = 1;
@@ -524,34 +1062,71 @@ float PopulationManager::getIndivContrib(const Locus& loc, int pos, const Utilit
 	return n_var * wt;
 }
 
-unsigned int PopulationManager::getTotalContrib(const bitset_pair& geno, const boost::dynamic_bitset<>* nonmiss)  const{
-
-	boost::dynamic_bitset<> nonmissing = ~(geno.first & geno.second);
-	if(nonmiss != 0){
-		nonmissing &= *nonmiss;
+bool PopulationManager::hasContrib(const bitset_pair& geno) const{
+	// A non-missing sample contributes with geno.first & ~geno.second
+	// (homozygous) or geno.second & ~geno.first (heterozygous) set, so these
+	// can be answered without building any temporary bitsets
+	switch (c_model) {
+	case ADDITIVE:
+	case DOMINANT:
+		return geno.first != geno.second;
+	case RECESSIVE:
+		return !geno.first.is_subset_of(geno.second);
+	default:
+		return false;
 	}
+}
 
+unsigned int PopulationManager::getTotalContrib(unsigned int n_first, unsigned int n_second) const{
 	switch (c_model) {
 	case ADDITIVE:
-		return 2 * (nonmissing & geno.first).count() + (nonmissing
-				& geno.second).count();
+		return 2 * n_first + n_second;
 	case DOMINANT:
-		return (nonmissing & geno.first).count() + (nonmissing
-				& geno.second).count();
+		return n_first + n_second;
 	case RECESSIVE:
-		return (nonmissing & geno.first).count();
+		return n_first;
 	default:
 		return 0;
 	}
 }
 
-float PopulationManager::getMAF(const bitset_pair& geno, const boost::dynamic_bitset<>* nonmiss) const{
-	boost::dynamic_bitset<> nonmissing = ~(geno.first & geno.second);
-	if(nonmiss != 0){
-		nonmissing &= *nonmiss;
+void PopulationManager::summarizeLoci(){
+	_locus_summary.clear();
+	_locus_summary.resize(_pheno_status.size());
+
+	unsigned int n_loci = _genotypes.size();
+	vector<word_type> mask[2];
+	unsigned int n_mask[2];
+	for(unsigned int p=0; p<_pheno_status.size(); p++){
+		LocusSummary& summ = _locus_summary[p];
+		n_mask[0] = _genotypes.getWords(_pheno_status[p].first, mask[0]);
+		n_mask[1] = _genotypes.getWords(_pheno_status[p].second, mask[1]);
+
+		for(int i=0; i<2; i++){
+			summ.n_nonmiss[i].resize(n_loci);
+			summ.n_first[i].resize(n_loci);
+			summ.n_second[i].resize(n_loci);
+			summ.maf[i].resize(n_loci);
+		}
+		summ.weight.resize(n_loci);
+
+		for(unsigned int ord=0; ord<n_loci; ord++){
+			for(int i=0; i<2; i++){
+				_genotypes.count(ord, mask[i].empty() ? 0 : &mask[i][0], n_mask[i],
+						summ.n_nonmiss[i][ord], summ.n_first[i][ord], summ.n_second[i][ord]);
+				summ.maf[i][ord] = getMAF(summ.n_nonmiss[i][ord], summ.n_first[i][ord], summ.n_second[i][ord]);
+			}
+
+			summ.weight[ord] = calcWeight(summ.n_nonmiss[0][ord],
+					2*summ.n_first[0][ord] + summ.n_second[0][ord],
+					summ.n_nonmiss[1][ord],
+					2*summ.n_first[1][ord] + summ.n_second[1][ord]);
+		}
 	}
+}
 
-	float maf = (2 * (nonmissing & geno.first).count() + (nonmissing & geno.second).count()) / static_cast<float>(2*nonmissing.count());
+float PopulationManager::getMAF(unsigned int n_nonmiss, unsigned int n_first, unsigned int n_second) const{
+	float maf = (2 * n_first + n_second) / static_cast<float>(2*n_nonmiss);
 
 	return std::min(maf, 1-maf);
 }
@@ -576,42 +1151,29 @@ float PopulationManager::getLocusWeight(const Locus& loc, const Phenotype& pheno
 	}
 
 	if(c_use_calc_weight){
-		wt *= calcWeight(loc, pheno.getStatus());
+		wt *= calcWeight(loc, pheno);
 	}
 
 	return wt;
 
 }
 
-float PopulationManager::calcWeight(const Locus& loc, const bitset_pair& status) const{
+float PopulationManager::calcWeight(const Locus& loc, const Phenotype& pheno) const{
+	unsigned int ord = loc.getOrdinal();
+	if(ord >= _genotypes.size()){
+		return 1;
+	}
+	return _locus_summary[pheno.getIndex()].weight[ord];
+}
+
+float PopulationManager::calcWeight(int N_u, int M_u, int N_a, int M_a) const{
 	// *_a = Affected (cases), *_u = Unaffected (controls)
 	// N_* = Number (population), F_* = Frequency
-	const boost::dynamic_bitset<>& control_bitset=status.first;
-	const boost::dynamic_bitset<>& case_bitset=status.second;
-
-	int N_a, N_u, N;
-	int M_a, M_u, M;
+	int N = N_u + N_a;
+	int M = M_u + M_a;
 	float w_a = std::numeric_limits<float>::quiet_NaN();
 	float w_u = 1;
 
-	unordered_map<const Knowledge::Locus*, bitset_pair >::const_iterator it = _genotypes.find(&loc);
-
-	if(it == _genotypes.end()){
-		return 1;
-	}
-
-	dynamic_bitset<> nonmissing = ~((*it).second.first & (*it).second.second);
-
-	N_u = (nonmissing & control_bitset).count() ;
-	N_a = (nonmissing & case_bitset).count();
-	N = N_u + N_a;
-
-	M_u = 2*((*it).second.first & control_bitset & nonmissing).count() +
-			((*it).second.second & control_bitset & nonmissing).count();
-	M_a = 2*((*it).second.first & case_bitset & nonmissing).count() +
-			((*it).second.second & case_bitset & nonmissing).count();
-	M = M_u + M_a;
-
 	float weight = 1;
 	if(c_weight_type != OVERALL){
 		if(N_u){
@@ -646,40 +1208,23 @@ float PopulationManager::calcWeight(const Locus& loc, const bitset_pair& status)
 }
 
 float PopulationManager::getCustomWeight(const Locus& loc, const Region* const reg) const{
-	static float weight_cache = 1;
-	static const Locus* loc_cache = 0;
-	static const Region* reg_cache = 0;
-
-
-	if(_info){
-		if(&loc != loc_cache || reg != reg_cache){
-			loc_cache = &loc;
-			reg_cache = reg;
-			weight_cache = _info->getSNPWeight(loc, reg);
-		}
-	}
-	return weight_cache;
+	return _info ? _info->getSNPWeight(loc, reg) : 1;
 }
 
-boost::array<unsigned int, 2> PopulationManager::getBinCapacity(Bin& bin, const bitset_pair& status) const {
+boost::array<unsigned int, 2> PopulationManager::getBinCapacity(Bin& bin, const Phenotype& pheno) const {
 
-	const boost::dynamic_bitset<>& control_bitset=status.first;
-	const boost::dynamic_bitset<>& case_bitset=status.second;
+	const LocusSummary& summ = _locus_summary[pheno.getIndex()];
 	Bin::const_locus_iterator b_itr = bin.variantBegin();
 	Bin::const_locus_iterator b_end = bin.variantEnd();
 	boost::array<unsigned int, 2> capacity;
 	capacity[0] = 0;
 	capacity[1] = 0;
 
-	unordered_map<const Locus*, bitset_pair>::const_iterator l_end = _genotypes.end();
-	unordered_map<const Locus*, bitset_pair>::const_iterator l_itr;
 	while (b_itr != b_end) {
-
-		l_itr = _genotypes.find(*b_itr);
-		if (l_itr != l_end) {
-			dynamic_bitset<> nonmiss = ~((*l_itr).second.first & (*l_itr).second.second);
-			capacity[0] += (nonmiss & control_bitset).count();
-			capacity[1] += (nonmiss & case_bitset).count();
+		unsigned int ord = (*b_itr)->getOrdinal();
+		if (ord < _genotypes.size()) {
+			capacity[0] += summ.n_nonmiss[0][ord];
+			capacity[1] += summ.n_nonmiss[1][ord];
 		}
 		++b_itr;
 	}
@@ -762,8 +1307,8 @@ void PopulationManager::printBinsTranspose(std::ostream& os, const BinManager& b
 	os << "\n";
 
 	BinManager::const_iterator b_itr = bins.begin();
-	Bin::const_locus_iterator l_itr;
-	boost::unordered_map<const Knowledge::Locus*, bitset_pair >::const_iterator loc_itr;
+	BinContributionCache contrib(*this, bins, pheno);
+	vector<float> bin_contrib;
 
 	vector<vector<double> > test_pvals(c_tests.size());
 	vector<vector<double> > test_accs(c_tests.size());
@@ -771,7 +1316,7 @@ void PopulationManager::printBinsTranspose(std::ostream& os, const BinManager& b
 		test_pvals[i].reserve(bins.size());
 		test_accs[i].reserve(bins.size());
 		Test::Test* t = c_tests[i]->clone();
-		t->runAllTests(*this, pheno, bins, test_pvals[i], test_accs[i]);
+		t->runAllTests(*this, pheno, bins, contrib, test_pvals[i], test_accs[i]);
 		delete t;
 	}
 
@@ -791,7 +1336,7 @@ void PopulationManager::printBinsTranspose(std::ostream& os, const BinManager& b
 			os << sep << (*b_itr)->getControlSize() << sep << (*b_itr)->getCaseSize();
 
 			// print case/control capacity
-			boost::array<unsigned int, 2> capacity = getBinCapacity(**b_itr, pheno.getStatus());
+			boost::array<unsigned int, 2> capacity = getBinCapacity(**b_itr, pheno);
 			os << sep << capacity[0] << sep << capacity[1];
 
 			// print pathway genes, if applicable
@@ -820,10 +1365,11 @@ void PopulationManager::printBinsTranspose(std::ostream& os, const BinManager& b
 
 
 		// print for each person
+		contrib.getContribs(**b_itr, bin_contrib);
 		m_itr = _positions_include_samples_with_covars.begin();
 		while (m_itr != _positions_include_samples_with_covars.end()) {
 			if (!isnan(getPhenotypeVal((*m_itr).first, pheno))) {
-				os << sep << std::setprecision(4) << getTotalIndivContrib(**b_itr, (*m_itr).second, pheno);
+				os << sep << std::setprecision(4) << bin_contrib[(*m_itr).second];
 			}
 			++m_itr;
 		}
@@ -851,12 +1397,7 @@ void PopulationManager::printBins(std::ostream& os, const BinManager& bins, cons
 	}
 	os << "\n";
 
-	Bin::const_locus_iterator l_itr;
-	Bin::const_locus_iterator l_end;
-
-	boost::unordered_map<const Knowledge::Locus*, bitset_pair >::const_iterator loc_itr;
-	boost::unordered_map<const Knowledge::Locus*, bitset_pair >::const_iterator loc_not_found =
-			_genotypes.end();
+	BinContributionCache contrib(*this, bins, pheno);
 
 	if(!NoSummary){
 
@@ -902,7 +1443,7 @@ void PopulationManager::printBins(std::ostream& os, const BinManager& bins, cons
 			b_itr = bins.begin();
 			b_end = bins.end();
 			while(b_itr != b_end){
-				os << sep << getBinCapacity(**b_itr, pheno.getStatus())[i];
+				os << sep << getBinCapacity(**b_itr, pheno)[i];
 				++b_itr;
 			}
 			os << "\n";
@@ -939,7 +1480,7 @@ void PopulationManager::printBins(std::ostream& os, const BinManager& bins, cons
 		test_pvals[i].reserve(bins.size());
 		test_accs[i].reserve(bins.size());
 		Test::Test* t = c_tests[i]->clone();
-		t->runAllTests(*this, pheno, bins, test_pvals[i], test_accs[i]);
+		t->runAllTests(*this, pheno, bins, contrib, test_pvals[i], test_accs[i]);
 		delete t;
 	}
 
@@ -976,7 +1517,7 @@ void PopulationManager::printBins(std::ostream& os, const BinManager& bins, cons
 			b_itr = bins.begin();
 			b_end = bins.end();
 			while(b_itr != b_end){
-				os << sep << std::setprecision(4) << getTotalIndivContrib(**b_itr, pos, pheno);
+				os << sep << std::setprecision(4) << contrib.getContrib(**b_itr, pos);
 				++b_itr;
 			}
 
@@ -11,10 +11,13 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <deque>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <stdexcept>
+#include <fstream>
+#include <cstring>
 
 #include <boost/unordered_map.hpp>
 #include <boost/array.hpp>
@@ -25,10 +28,21 @@
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/range/iterator_range_core.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/array.hpp>
 
 #include "Bin.h"
 
 #include "util/ICompressedFile.h"
+#include "util/MappedFile.h"
+#include "util/VCFRecord.h"
+#include "util/BGZFReader.h"
+#include "util/ParallelBGZFBuf.h"
+#include "util/TabixIndex.h"
+#include "util/GenotypeCache.h"
+#include "util/GenotypeStore.h"
 //#include "util/string_ref.hpp"
 #include "util/Phenotype.h"
 
@@ -36,6 +50,7 @@
 #include "knowledge/liftover/Converter.h"
 #include "knowledge/Information.h"
 #include "knowledge/Region.h"
+#include "knowledge/RegionCollection.h"
 
 namespace BioBin{
 
@@ -208,10 +223,17 @@ public:
 
 	// Usage functions
 	unsigned int genotypeContribution(const Knowledge::Locus& locus, const boost::dynamic_bitset<>* nonmiss=0) const;
+	//! The contribution of the cases (or controls) of the phenotype
+	unsigned int genotypeContribution(const Knowledge::Locus& locus, const Utility::Phenotype& pheno, bool cases) const;
 	unsigned short getIndivGeno(const Knowledge::Locus& loc, int position) const;
+	/*!
+	 * \brief Appends the position and genotype (according to the disease
+	 * model) of every sample with a non-zero genotype at the given locus.
+	 */
+	void getCarriers(const Knowledge::Locus& loc, std::vector<std::pair<unsigned int, unsigned char> >& carriers_out) const;
 	float getAvgGenotype(const Knowledge::Locus& locus, const boost::dynamic_bitset<>* nonmiss_status=0) const;
-	bool isRare(const Knowledge::Locus& locus, const bitset_pair& status, float lower, float upper) const;
-	bool isPresent(const Knowledge::Locus& locus, const bitset_pair& status) const;
+	bool isRare(const Knowledge::Locus& locus, const Utility::Phenotype& pheno, float lower, float upper) const;
+	bool isPresent(const Knowledge::Locus& locus, const Utility::Phenotype& pheno) const;
 	unsigned int getNumPhenotypes() const {return _pheno_names.size();}
 	unsigned int getNumCovars() const {return _covar_names.size();}
 	unsigned int getNumSamples() const {return _positions_include_samples.size();}
@@ -229,6 +251,15 @@ public:
 	}
 	const Knowledge::Information* getInfo() const { return _info;}
 
+	/*!
+	 * \brief Restricts loading to loci within the given bounds.
+	 * Only honored when c_use_vcf_index is set and the VCF has an index.
+	 */
+	void setLoadBounds(const Knowledge::RegionCollection::bound_map& bounds) {
+		_load_bounds = bounds;
+		_use_load_bounds = true;
+	}
+
 	// Printing functions
 	void printBins(std::ostream& os, const BinManager& bins, const Utility::Phenotype& pheno, const std::string& sep=",") const;
 	void printBinsTranspose(std::ostream& os, const BinManager& bins, const Utility::Phenotype& pheno, const std::string& sep=",") const;
@@ -265,6 +296,13 @@ public:
 	static bool c_force_all_control;
 	static bool c_set_star_referent;
 
+	//! Number of threads to use when reading the VCF (0 = no extra threads)
+	static unsigned int c_n_threads;
+	//! Use a tabix/CSI index to read only the loci in the regions of interest
+	static bool c_use_vcf_index;
+	//! Binary file used to cache the loaded loci and genotypes between runs
+	static std::string c_genotype_cache;
+
 private:
 
 	void printEscapedString(std::ostream& os, const std::string& toPrint, const std::string& toRepl, const std::string& replStr) const;
@@ -282,11 +320,162 @@ private:
 			boost::unordered_map<std::string, std::vector<float> >& vals_out,
 			const std::string& var_prefix="pheno");
 
+	/*!
+	 * \brief Scratch space reused while parsing the records of a VCF.
+	 * All of the vectors here are cleared, not freed, between records, so
+	 * once they have grown to the size of the widest record no further
+	 * allocation is needed to parse a line.
+	 */
+	struct VCFParseState{
+		explicit VCFParseState(unsigned int n_fields);
+
+		Utility::VCFRecord fields;
+		std::vector<Utility::VCFRecord::string_view> alleles;
+		std::vector<std::pair<unsigned short, unsigned short> > calls;
+		std::vector<unsigned int> call_count;
+		unsigned int n_fields;
+		char geno_sep;
+		char alt_geno_sep;
+		//! Where warnings and errors found while parsing are written
+		std::ostream* log;
+	};
+
+	/*!
+	 * \brief Writes loci that failed liftover; the file is only created when
+	 * the first unlifted locus is seen.
+	 */
+	class UnliftedLog{
+	public:
+		UnliftedLog(const std::string& fn, const std::string& sep) : _fn(fn), _sep(sep), _cache(0) {}
+		void write(const Knowledge::Locus& loc);
+		//! Also record unlifted loci in the given genotype cache
+		void setCache(Utility::GenotypeCache* cache) {_cache = cache;}
+	private:
+		std::string _fn;
+		std::string _sep;
+		std::ofstream _out;
+		Utility::GenotypeCache* _cache;
+	};
+
+	/*!
+	 * \brief A locus parsed by the VCF pipeline, waiting to be committed.
+	 * If unlifted is set, the locus is the original (unconverted) locus,
+	 * which only needs to be reported.
+	 */
+	struct VCFResult{
+		VCFResult() : locus(0), unlifted(false) {}
+		Knowledge::Locus* locus;
+		bool unlifted;
+		bitset_pair genotypes;
+	};
+
+	/*!
+	 * \brief A contiguous group of lines from the VCF file.
+	 * Lines read from a mapped file point into the mapping; otherwise, the
+	 * batch owns a copy of the text.
+	 */
+	struct VCFBatch{
+		VCFBatch() : first_line(0), done(false) {}
+		unsigned int first_line;
+		std::vector<char> text;
+		std::vector<std::pair<const char*, const char*> > lines;
+		std::vector<VCFResult> results;
+		std::string log;
+		std::string error;
+		bool done;
+	};
+
+	/*!
+	 * \brief Parses a VCF on a pool of worker threads.
+	 * Lines are cut into batches and parsed concurrently, but batches are
+	 * returned from next() in file order, so loci can be committed exactly
+	 * as they would be by a serial load.
+	 */
+	class VCFPipeline{
+	public:
+		VCFPipeline(const PopulationManager& pop_mgr, const char* data_begin,
+				const char* data_end, std::istream* data_stream, unsigned int lineno,
+				const Knowledge::Liftover::Converter& conv, int chain_count,
+				unsigned int n_threads);
+		~VCFPipeline();
+
+		/*!
+		 * \brief Returns the next parsed batch, in file order, or 0 at the
+		 * end of the file.  The batch is valid until the next call.
+		 */
+		VCFBatch* next();
+
+	private:
+		VCFPipeline(const VCFPipeline&);
+		VCFPipeline& operator=(const VCFPipeline&);
+
+		void work();
+		bool readBatch(VCFBatch& batch);
+		void parseBatch(VCFBatch& batch, VCFParseState& state);
+		void recycle(VCFBatch* batch);
+
+		const PopulationManager& _pop_mgr;
+		const Knowledge::Liftover::Converter& _conv;
+		int _chain_count;
+
+		// the input: either [_data_pos, _data_end) or _data_stream
+		const char* _data_pos;
+		const char* _data_end;
+		std::istream* _data_stream;
+		unsigned int _lineno;
+
+		boost::mutex _read_lock;
+		boost::mutex _lock;
+		boost::condition_variable _ready_cond;
+		boost::condition_variable _space_cond;
+
+		std::deque<VCFBatch*> _batches;
+		std::vector<VCFBatch*> _free;
+		VCFBatch* _curr;
+
+		unsigned int _max_batches;
+		bool _eof;
+		bool _stop;
+
+		boost::thread_group _workers;
+	};
+
+	template <class T_cont>
+	void loadVCFData(T_cont& loci_out, Utility::MappedFile& vcf_map, Utility::ICompressedFile& vcf_f,
+			std::size_t data_offset, unsigned int lineno, Knowledge::Liftover::Converter& conv,
+			int chain_count, UnliftedLog& unlifted);
+	template <class T_cont>
+	void loadGenotypeCache(T_cont& loci_out, Utility::GenotypeCache& cache, UnliftedLog& unlifted);
+	template <class T_cont>
+	void writeGenotypeCache(const T_cont& loci, Utility::GenotypeCache& cache) const;
+	boost::uint64_t getCacheKey(const std::string& build, int chain_count) const;
+	template <class T_cont>
+	void loadIndexedLoci(T_cont& loci_out, const Utility::TabixIndex& idx,
+			Knowledge::Liftover::Converter& conv, int chain_count, UnliftedLog& unlifted);
+	void getIndexIntervals(const std::string& seq_name,
+			std::vector<std::pair<unsigned int, unsigned int> >& intervals_out) const;
+	template <class T_cont>
+	void commitVCFLocus(T_cont& loci_out, Knowledge::Locus* loc, const bitset_pair& geno);
+	template <class T_cont>
+	void loadVCFRecord(T_cont& loci_out, const char* line_begin, const char* line_end,
+			unsigned int lineno, VCFParseState& state, Knowledge::Liftover::Converter& conv,
+			int chain_count, UnliftedLog& unlifted);
+	bool parseVCFRecord(const char* line_begin, const char* line_end, unsigned int lineno, VCFParseState& state) const;
+	Knowledge::Locus* createVCFLocus(const VCFParseState& state, const Knowledge::Liftover::Converter& conv,
+			int chain_count, Knowledge::Locus*& unlifted_out) const;
+	bool parseVCFGenotypes(VCFParseState& state, unsigned int lineno, bitset_pair& geno_out) const;
+
 	float getIndivContrib(const Knowledge::Locus& loc, int position, const Utility::Phenotype& pheno, bool useWeights = false, const Knowledge::Region* const reg = NULL) const;
-	unsigned int getTotalContrib(const bitset_pair& geno, const boost::dynamic_bitset<>* nonmiss=0) const;
-	float getMAF(const bitset_pair& geno, const boost::dynamic_bitset<>* nonmiss=0) const;
+	//! Whether any sample has a non-zero genotype under the disease model
+	bool hasContrib(const bitset_pair& geno) const;
+
+	// Functions on the stored genotypes; a mask of 0 means all samples
+	typedef Utility::GenotypeStore::word_type word_type;
+	unsigned int getTotalContrib(unsigned int n_first, unsigned int n_second) const;
+	float getMAF(unsigned int n_nonmiss, unsigned int n_first, unsigned int n_second) const;
 	float calcBrowningWeight(unsigned long N, unsigned long M) const;
-	float calcWeight(const Knowledge::Locus& loc, const bitset_pair& status) const;
+	float calcWeight(const Knowledge::Locus& loc, const Utility::Phenotype& pheno) const;
+	float calcWeight(int N_u, int M_u, int N_a, int M_a) const;
 	float getCustomWeight(const Knowledge::Locus& loc, const Knowledge::Region* const reg = NULL) const;
 	void setGenomeBuild(const std::string& build) const;
 	void readSamplesFromFile(boost::unordered_set<std::string>& sample_names, std::string file) const;
@@ -296,7 +485,7 @@ private:
 	 * Fast atoi that handles up to 5 digits (max unsigned short is ~65K)
 	 */
 	template <typename Str_Ref>
-	unsigned short fast_atoi(const Str_Ref& r){
+	static unsigned short fast_atoi(const Str_Ref& r){
 		unsigned short value_ = 0;
 		unsigned int len = r.size();
 		switch(len){
@@ -309,7 +498,25 @@ private:
 		return value_;
 	}
 
-	boost::array<unsigned int, 2> getBinCapacity(Bin& bin, const bitset_pair& status) const;
+	boost::array<unsigned int, 2> getBinCapacity(Bin& bin, const Utility::Phenotype& pheno) const;
+
+	/*
+	 * Per-locus statistics for a single phenotype, in columns indexed by the
+	 * ordinal of the locus.  Index 0 of each array is the controls, and
+	 * index 1 the cases.
+	 */
+	struct LocusSummary{
+		std::vector<unsigned int> n_nonmiss[2];
+		// homozygous and heterozygous samples (first and second bit-planes)
+		std::vector<unsigned int> n_first[2];
+		std::vector<unsigned int> n_second[2];
+		std::vector<float> maf[2];
+		// Madsen-Browning weight
+		std::vector<float> weight;
+	};
+
+	// Fills _locus_summary; called once all loci are loaded
+	void summarizeLoci();
 
 	// Note: thefollowing 2 variables are inverses of each other, so:
 	// i == _positions[_sample_names[i]]
@@ -340,10 +547,11 @@ private:
 	// covariates as read in the covariate file(s)
 	boost::unordered_map<std::string, std::vector<float> > _covars;
 
-	// the actual genotypes included in the VCF file
-	// NOTE: this should eventually be a class that caches its results to a
-	// temporary file for better use of memory!
-	boost::unordered_map<const Knowledge::Locus*, bitset_pair > _genotypes;
+	// the actual genotypes included in the VCF file, indexed by the ordinal
+	// of each Locus
+	Utility::GenotypeStore _genotypes;
+	// summary of the genotypes for each phenotype
+	std::vector<LocusSummary> _locus_summary;
 
 	std::string _vcf_fn;
 
@@ -355,6 +563,10 @@ private:
 
 	std::vector<bool> _include_samples;
 
+	// If set, only loci within _load_bounds are read (see setLoadBounds)
+	bool _use_load_bounds;
+	Knowledge::RegionCollection::bound_map _load_bounds;
+
 };
 
 template<class T_cont>
@@ -364,8 +576,21 @@ void PopulationManager::loadLoci(T_cont& loci_out, const std::string& prefix, co
 	//typedef boost::iterator_range<sc_iter> string_view;
 	std::string build = genome_build;
 
-	Utility::ICompressedFile vcf_f(_vcf_fn.c_str());
-	unsigned int lineno = readVCFHeader(vcf_f);
+	// Plain VCFs are memory-mapped and scanned in place; anything else
+	// (compressed, pipes, etc.) goes through the streaming reader
+	Utility::MappedFile vcf_map;
+	Utility::ICompressedFile vcf_f;
+	unsigned int lineno = 0;
+	std::size_t data_offset = 0;
+	if(vcf_map.open(_vcf_fn)){
+		boost::iostreams::stream<boost::iostreams::array_source> hdr_s(vcf_map.begin(), vcf_map.size());
+		lineno = readVCFHeader(hdr_s);
+		std::streampos hdr_end = hdr_s.tellg();
+		data_offset = (hdr_end == std::streampos(-1)) ? vcf_map.size() : static_cast<std::size_t>(hdr_end);
+	} else {
+		vcf_f.open(_vcf_fn.c_str(), std::ios_base::in, c_n_threads);
+		lineno = readVCFHeader(vcf_f);
+	}
 
 	_include_samples.resize(_sample_names.size(), true);
 	boost::unordered_set<std::string> include_sample_names, exclude_sample_names;
@@ -423,239 +648,231 @@ void PopulationManager::loadLoci(T_cont& loci_out, const std::string& prefix, co
 	int chainCount = conv.setBuild(build);
 	setGenomeBuild(build);
 
-	std::string geno_sep = "/";
-	std::string alt_geno_sep = "|";
+	UnliftedLog unlifted(prefix + "-unlifted.csv", sep);
+
+	unsigned int n_samples = std::count(_include_samples.begin(), _include_samples.end(), true);
+	_genotypes.reset(n_samples);
+
+	// If we've already loaded this VCF with the same settings, we can skip
+	// parsing it altogether
+	Utility::GenotypeCache cache;
+	bool write_cache = false;
+	if(!c_genotype_cache.empty()){
+		boost::uint64_t cache_key = getCacheKey(build, chainCount);
+		if(cache.open(c_genotype_cache, cache_key, n_samples)){
+			loadGenotypeCache(loci_out, cache, unlifted);
+			summarizeLoci();
+			return;
+		}
+
+		write_cache = cache.create(c_genotype_cache, cache_key, n_samples);
+		if(write_cache){
+			unlifted.setCache(&cache);
+		}
+	}
+
+	loadVCFData(loci_out, vcf_map, vcf_f, data_offset, lineno, conv, chainCount, unlifted);
+
+	if(write_cache){
+		writeGenotypeCache(loci_out, cache);
+	}
 
+	summarizeLoci();
+}
+
+template<class T_cont>
+void PopulationManager::loadVCFData(T_cont& loci_out, Utility::MappedFile& vcf_map,
+		Utility::ICompressedFile& vcf_f, std::size_t data_offset, unsigned int lineno,
+		Knowledge::Liftover::Converter& conv, int chainCount, UnliftedLog& unlifted){
+
+	if(_use_load_bounds){
+		Utility::TabixIndex vcf_idx;
+		if(chainCount > 0){
+			std::cerr << "WARNING: The VCF index cannot be used when converting "
+					<< "genomic builds, reading entire VCF" << std::endl;
+		} else if(vcf_map.is_open() || !Utility::ParallelBGZFBuf::isBGZF(_vcf_fn.c_str())
+				|| !vcf_idx.load(_vcf_fn)){
+			std::cerr << "WARNING: No tabix or CSI index found for " << _vcf_fn
+					<< ", reading entire VCF" << std::endl;
+		} else {
+			loadIndexedLoci(loci_out, vcf_idx, conv, chainCount, unlifted);
+			return;
+		}
+	}
+
+	const char* data_begin = vcf_map.is_open() ? vcf_map.begin() + data_offset : 0;
+	const char* data_end = vcf_map.is_open() ? vcf_map.end() : 0;
+
+	if(c_n_threads > 1){
+		// Parse batches of lines on worker threads, but commit the results
+		// here, in file order, so the output is the same as a serial load
+		VCFPipeline pipeline(*this, data_begin, data_end, vcf_map.is_open() ? 0 : &vcf_f,
+				lineno, conv, chainCount, c_n_threads);
+
+		VCFBatch* batch;
+		while((batch = pipeline.next()) != 0){
+			std::vector<VCFResult>::iterator r_itr = batch->results.begin();
+			std::vector<VCFResult>::iterator r_end = batch->results.end();
+			for( ; r_itr != r_end; ++r_itr){
+				if((*r_itr).unlifted){
+					unlifted.write(*(*r_itr).locus);
+					delete (*r_itr).locus;
+				} else {
+					commitVCFLocus(loci_out, (*r_itr).locus, (*r_itr).genotypes);
+				}
+				(*r_itr).locus = 0;
+			}
+		}
+		return;
+	}
+
+	VCFParseState state(9 + _positions.size());
+
+	if(vcf_map.is_open()){
+		// Scan the mapped file in place; no line is ever copied
+		const char* line_begin = data_begin;
+		while(line_begin < data_end){
+			const char* line_end = static_cast<const char*>(
+					memchr(line_begin, '\n', data_end - line_begin));
+			if(!line_end){
+				line_end = data_end;
+			}
+			++lineno;
+			loadVCFRecord(loci_out, line_begin, line_end, lineno, state, conv, chainCount, unlifted);
+			line_begin = line_end + 1;
+		}
+	} else {
+		std::string curr_line;
+		while(vcf_f.good()){
+			getline(vcf_f, curr_line);
+			++lineno;
+			const char* line_begin = curr_line.data();
+			loadVCFRecord(loci_out, line_begin, line_begin + curr_line.size(), lineno, state, conv, chainCount, unlifted);
+		}
+	}
+
+}
+
+template<class T_cont>
+void PopulationManager::loadGenotypeCache(T_cont& loci_out, Utility::GenotypeCache& cache,
+		UnliftedLog& unlifted){
+
+	Utility::GenotypeCache::Record rec;
+	for(unsigned int i=0; i<cache.getNumLoci(); i++){
+		const word_type* geno = cache.readLocus(rec);
+		Knowledge::Locus* loc = new Knowledge::Locus(rec.chrom, rec.pos, rec.id);
+		loc->setOrdinal(_genotypes.add(geno, geno + cache.getNumWords()));
+		loci_out.insert(loci_out.end(), loc);
+	}
+
+	for(unsigned int i=0; i<cache.getNumUnlifted(); i++){
+		cache.readUnlifted(rec);
+		Knowledge::Locus unlifted_loc(rec.chrom, rec.pos, rec.id);
+		unlifted.write(unlifted_loc);
+	}
+}
+
+template<class T_cont>
+void PopulationManager::writeGenotypeCache(const T_cont& loci, Utility::GenotypeCache& cache) const{
+	std::vector<word_type> words;
+	typename T_cont::const_iterator itr = loci.begin();
+	for( ; itr != loci.end(); ++itr){
+		unsigned int ord = (*itr)->getOrdinal();
+		if(ord < _genotypes.size()){
+			_genotypes.getWords(ord, words);
+			const word_type* first = words.empty() ? 0 : &words[0];
+			cache.writeLocus((*itr)->getChrom(), (*itr)->getPos(), (*itr)->getID(),
+					first, first + _genotypes.getNumWords());
+		}
+	}
+	cache.finish();
+}
+
+template<class T_cont>
+void PopulationManager::loadIndexedLoci(T_cont& loci_out, const Utility::TabixIndex& idx,
+		Knowledge::Liftover::Converter& conv, int chain_count, UnliftedLog& unlifted){
+
+	Utility::BGZFReader vcf_f(_vcf_fn);
+	VCFParseState state(9 + _positions.size());
+
+	// NOTE: line numbers are not known when seeking through the file, so
+	// any messages give the number of the record read instead
+	unsigned int n_records = 0;
 	std::string curr_line;
-	unsigned int n_fields = 9 + _positions.size();
-
-	std::string chr, id, ref, alt, filter, format;
-
-	unsigned int bploc = 0;
-	unsigned int gt_idx;
-	unsigned int ft_idx;
-	unsigned short curr_max;
-	unsigned int max_count;
-	bool lift_warn = false;
-	std::ofstream unlift_out;
-	std::vector<boost::iterator_range<std::string::iterator> > geno_list;
-	//std::vector<boost::string_ref> fields;
-	//std::vector<std::pair<string::iterator, string::iterator> > fields;
-	std::vector<boost::iterator_range<std::string::iterator> > fields;
-	std::vector<std::string> alleles;
-	std::vector<boost::iterator_range<std::string::iterator> > call_list;
-	std::vector<std::string> format_list;
-	std::vector<std::pair<unsigned short, unsigned short> > calls;
-	std::pair<unsigned short, unsigned short> curr_call;
-	std::vector<unsigned int> call_count;
-
-	static const std::string PASS_STR("PASS");
-	static const std::string DOT_STR(".");
-	static const std::string STAR_STR("*");
-
-	const unsigned short missing_geno = static_cast<unsigned short>(-1);
-	calls.reserve(_positions.size());
-	format_list.reserve(10);
-	call_list.reserve(2);
-
-	while(vcf_f.good()){
-		getline(vcf_f, curr_line);
-		++lineno;
-		fields.clear();
-		if(curr_line.size() > 2 && curr_line[0] != '#'){
-			// In this case, we're looking at a marker
-
-			boost::algorithm::iter_split(fields, curr_line, boost::first_finder("\t"));
-			if(fields.size() != n_fields){
-				std::cerr << "ERROR: Mismatched number of fields on line "
-						<< lineno << std::endl;
-				std::cerr << "Expected # of fields: "<<n_fields << std::endl;
-				std::cerr << "Seen # of fields: " << fields.size() << std::endl;
-				std::cerr << "Line size: " << curr_line.size() << std::endl;
-				std::cerr << "Last field: " << fields[fields.size() - 1] << std::endl;
-				std::cerr << "2nd to Last field: " << fields[fields.size() - 2] << std::endl;
-				// throw exception here
-				throw std::runtime_error("Mismatched number of fields in VCF file");
+	std::vector<std::pair<unsigned int, unsigned int> > intervals;
+	std::vector<Utility::TabixIndex::chunk> chunks;
+
+	const std::vector<std::string>& seq_names = idx.getNames();
+	for(unsigned int tid = 0; tid < seq_names.size(); tid++){
+		getIndexIntervals(seq_names[tid], intervals);
+		idx.getChunks(tid, intervals, chunks);
+
+		std::vector<Utility::TabixIndex::chunk>::const_iterator c_itr = chunks.begin();
+		for( ; c_itr != chunks.end(); ++c_itr){
+			if(!vcf_f.seek((*c_itr).first)){
+				std::cerr << "ERROR: Invalid offset in index of " << _vcf_fn << std::endl;
+				throw std::runtime_error("Invalid offset in VCF index");
 			}
 
-			chr = std::string(fields[0].begin(), fields[0].end());
-			bploc = boost::lexical_cast<unsigned int>(std::string(fields[1].begin(), fields[1].end()));
-			id = std::string(fields[2].begin(), fields[2].end());
-			ref = std::string(fields[3].begin(), fields[3].end());
-			alt = std::string(fields[4].begin(), fields[4].end());
-			filter = std::string(fields[6].begin(), fields[6].end());
-			format = std::string(fields[8].begin(), fields[8].end());
-
-			// check for marker-level inclusion
-			if(filter == "." || filter == "PASS"){
-
-				// construct a locus object and lift over, if necessary
-				Knowledge::Locus* loc = new Knowledge::Locus(chr,bploc,id,ref);
-				if(chainCount > 0){
-					Knowledge::Locus* new_loc = conv.convertLocus(*loc);
-					// make sure to drop loci that lift to unknown chromosomes, too!
-					if (! new_loc || new_loc->getChrom() == Knowledge::Locus::UNKNOWN_CHROM){
-						if(!lift_warn){
-							std::string fn(prefix + "-unlifted.csv");
-							unlift_out.open(fn.c_str());
-							std::cerr << "WARNING: Some variants not lifted!  See "
-									  << fn << " for details." << std::endl;
-
-							unlift_out << "Chrom" << sep << "Pos" << sep
-									   << "ID" << std::endl;
-							lift_warn = true;
-
-						}
-						loc->print(unlift_out, sep);
-						unlift_out << std::endl;
-						if(new_loc){
-							delete new_loc;
-							new_loc = 0;
-						}
-						delete loc;
-						loc = 0;
-					}else{
-						delete loc;
-						loc = new_loc;
-					}
+			while(vcf_f.tell() < (*c_itr).second && vcf_f.getline(curr_line)){
+				++n_records;
+				const char* line_begin = curr_line.data();
+				const char* line_end = line_begin + curr_line.size();
+
+				// Chunks may hold records on either side of the intervals
+				Utility::VCFRecord::string_view chrom =
+						Utility::VCFRecord::getToken(line_begin, line_end, '\t', 0);
+				Utility::VCFRecord::string_view pos_str =
+						Utility::VCFRecord::getToken(line_begin, line_end, '\t', 1);
+				unsigned int pos = 0;
+				for(const char* p = pos_str.begin(); p != pos_str.end(); ++p){
+					pos = pos * 10 + (*p - '0');
 				}
 
-
-				if(loc != 0){
-					// get a list of all the alleles, in the correct order
-					std::string allele_str = ref + "," + alt;
-					boost::algorithm::split(alleles, allele_str, boost::is_any_of(","));
-					// initialize the call count so I can easily determine the major allele
-					call_count.clear();
-					call_count.resize(alleles.size(), 0);
-
-					// parse the format string
-					format_list.clear();
-					boost::algorithm::split(format_list, format, boost::is_any_of(":"));
-					gt_idx = (find(format_list.begin(), format_list.end(), "GT") - format_list.begin());
-					ft_idx = (find(format_list.begin(), format_list.end(), "FT") - format_list.begin());
-					ft_idx = (ft_idx == format_list.size()) ? static_cast<unsigned int>(-1) : ft_idx;
-
-					if(gt_idx == format_list.size()){
-						std::cerr << "ERROR: No 'GT' format on line " << lineno <<
-								", cannot continue." << std::endl;
-						throw std::runtime_error("No GT given in format string");
-					}
-
-					calls.clear();
-					for (unsigned int i=0; i<fields.size() - 9; i++){
-						if (_include_samples[i]) {
-
-							// parse the individual call
-							geno_list.clear();
-							//std::string currstr(fields[i+9].begin(), fields[i+9].end());
-							boost::algorithm::iter_split(geno_list, fields[i+9], boost::first_finder(":"));
-
-							if(fields[i+9] != DOT_STR && (ft_idx == static_cast<unsigned int>(-1) || geno_list[ft_idx] == PASS_STR || geno_list[ft_idx] == DOT_STR)){
-								call_list.clear();
-								boost::algorithm::iter_split(call_list, geno_list[gt_idx], boost::first_finder(geno_sep));
-								if(call_list.size() == 1){
-									// we should be here very rarely!  If we're here,
-									// we'll assume that the "primary" separator of
-									// genotypes is in fact the "alternate", so swap them!
-									boost::algorithm::iter_split(call_list, geno_list[gt_idx], boost::first_finder(alt_geno_sep));
-									geno_sep.swap(alt_geno_sep);
-								}
-
-								if(call_list.size() != 2){
-									if(!(call_list.size() == 1 && call_list[0] == DOT_STR)){
-										std::cerr << "WARNING: Non-diploid genotype '" << geno_list[gt_idx] << "' found on line " <<
-											lineno << ", setting to missing" << std::endl;
-									}
-									calls.push_back(std::make_pair(missing_geno, missing_geno));
-								} else {
-									unsigned short g1, g2;
-									//boost::string_ref c1(&*call_list[0].begin(), call_list[0].size());
-									//boost::string_ref c2(&*call_list[1].begin(), call_list[1].size());
-									if(*call_list[0].begin() != '.' && *call_list[1].begin() != '.'){
-										g1 = fast_atoi(call_list[0]);
-										g2 = fast_atoi(call_list[1]);
-										if (c_set_star_referent) {
-											if (alleles[g1] == STAR_STR) {
-												g1 = 0;
-											}
-											if (alleles[g2] == STAR_STR) {
-												g2 = 0;
-											}
-											calls.push_back(std::make_pair(g1, g2));
-											++call_count[g1];
-											++call_count[g2];
-										} else {
-											if(alleles[g1] == STAR_STR || alleles[g2] == STAR_STR) {
-												calls.push_back(std::make_pair(missing_geno, missing_geno));
-											} else {
-												calls.push_back(std::make_pair(g1, g2));
-												++call_count[g1];
-												++call_count[g2];
-											}
-										}
-									} else{
-										calls.push_back(std::make_pair(missing_geno, missing_geno));
-									}
-								}
-							} else {
-								calls.push_back(std::make_pair(missing_geno, missing_geno));
-							}
-						}
-
-					} // end iterating over genotypes
-
-					// OK, now we'll find the major allele
-					curr_max = 0;
-					max_count = call_count[0];
-					for(unsigned short i=1; i<call_count.size(); i++){
-						if(call_count[i] > max_count){
-							curr_max = i;
-							max_count = call_count[i];
-						}
-					}
-
-					// let's make sure that this isn't monoporphic
-					std::sort(call_count.begin(), call_count.end());
-					if(!c_keep_monomorphic && (call_count.size() < 2 || call_count[call_count.size() - 2] == 0)){
-						delete loc;
-					} else {
-
-						bitset_pair curr_geno(std::make_pair(boost::dynamic_bitset<>(calls.size()), boost::dynamic_bitset<>(calls.size())));
-
-						for(unsigned int i=0; i<calls.size(); i++){
-							curr_call = calls[i];
-
-							if(curr_call.first == missing_geno || curr_call.second == missing_geno){
-								curr_geno.first.set(i);
-								curr_geno.second.set(i);
-							} else if (curr_call.first != curr_max && curr_call.second != curr_max){
-								curr_geno.first.set(i);
-							} else if (curr_call.first != curr_max || curr_call.second != curr_max) {
-								curr_geno.second.set(i);
-							}
-						}
-
-						// again, make sure it isn't monomorphic with regards to the
-						// disease encoding
-						if(!c_keep_monomorphic && getTotalContrib(curr_geno) == 0){
-							delete loc;
-						} else {
-							loci_out.insert(loci_out.end(), loc);
-
-							_genotypes.insert(std::make_pair(loc, curr_geno));
-						}
-					}
+				std::vector<std::pair<unsigned int, unsigned int> >::const_iterator i_itr =
+						std::upper_bound(intervals.begin(), intervals.end(),
+								std::make_pair(pos - 1, static_cast<unsigned int>(-1)));
+				if(pos == 0 || i_itr == intervals.begin() || (*(i_itr - 1)).second < pos
+						|| !Utility::VCFRecord::equals(chrom, seq_names[tid].c_str())){
+					continue;
 				}
 
-			} // end marker parsing
+				loadVCFRecord(loci_out, line_begin, line_end, n_records, state, conv, chain_count, unlifted);
+			}
 		}
-	} // end while(getline)
+	}
+}
+
+template<class T_cont>
+void PopulationManager::loadVCFRecord(T_cont& loci_out, const char* line_begin, const char* line_end,
+		unsigned int lineno, VCFParseState& state, Knowledge::Liftover::Converter& conv,
+		int chain_count, UnliftedLog& unlifted){
+
+	if(!parseVCFRecord(line_begin, line_end, lineno, state)){
+		return;
+	}
 
-	if(lift_warn){
-		unlift_out.close();
+	Knowledge::Locus* unlifted_loc = 0;
+	Knowledge::Locus* loc = createVCFLocus(state, conv, chain_count, unlifted_loc);
+	if(unlifted_loc != 0){
+		unlifted.write(*unlifted_loc);
+		delete unlifted_loc;
 	}
 
+	if(loc != 0){
+		bitset_pair curr_geno;
+		if(parseVCFGenotypes(state, lineno, curr_geno)){
+			commitVCFLocus(loci_out, loc, curr_geno);
+		} else {
+			delete loc;
+		}
+	}
+}
+
+template<class T_cont>
+void PopulationManager::commitVCFLocus(T_cont& loci_out, Knowledge::Locus* loc, const bitset_pair& geno){
+	loc->setOrdinal(_genotypes.add(geno.first, geno.second));
+	loci_out.insert(loci_out.end(), loc);
 }
 
 }
@@ -9,6 +9,7 @@
 
 #include "main.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <cstdio>
 
@@ -21,6 +22,8 @@
 
 #include "util/Phenotype.h"
 
+#include "tests/Test.h"
+
 using std::string;
 using std::vector;
 using std::map;
@@ -43,12 +46,13 @@ bool BinApplication::c_print_sources = false;
 bool BinApplication::c_print_populations = false;
 bool BinApplication::s_run_normal = true;
 unsigned int BinApplication::n_threads = 0;
+std::string BinApplication::c_knowledge_cache = "";
 
 new_handler BinApplication::currentHandler;
 
 BinApplication::BinApplication(const string& db_fn, const string& vcf_file) :
-	dbFilename(db_fn), _info(0), regions(0), groups(0), varVersion(0), geneExtensionLength(0),
-			_pop_mgr(vcf_file) {
+	dbFilename(db_fn), _info(0), regions(0), groups(0), _snapshot(0), varVersion(0),
+			geneExtensionLength(0), _pop_mgr(vcf_file) {
 
 	Init(db_fn, true);
 
@@ -83,6 +87,10 @@ BinApplication::~BinApplication(){
 		delete regions;
 	}
 
+	if(_snapshot){
+		delete _snapshot;
+	}
+
 	deque<Knowledge::Locus*>::iterator d_itr = dataset.begin();
 	while(d_itr != dataset.end()){
 		delete *d_itr;
@@ -106,7 +114,7 @@ void BinApplication::binPhenotypes(PopulationManager::const_pheno_iterator& ph_i
 			++ph_itr;
 			_pheno_mutex.unlock();
 
-			BinManager binData(_pop_mgr, *regions, dataset, *_info, ph);
+			BinManager binData(_pop_mgr, *regions, dataset, *_info, ph, &_bin_layouts);
 
 			_output_mutex.lock();
 			std::cout << "Phenotype: " << _pop_mgr.getPhenotypeName(ph.getIndex()) << std::endl;
@@ -170,22 +178,68 @@ void BinApplication::InitBins() {
 	if(Main::WriteLociData){
 		_locus_bins.resize(_pop_mgr.getNumPhenotypes(), 0);
 	}
+
+	// Phenotypes that would be binned exactly the same way (the same rare
+	// loci, each adding the same amount to the size of a bin) share their
+	// bins, so the bins are only built once
+	if(_pop_mgr.getNumPhenotypes() > 1){
+		PopulationManager::const_pheno_iterator k_itr = _pop_mgr.beginPheno();
+		for( ; k_itr != _pop_mgr.endPheno(); ++k_itr){
+			_bin_layouts.expect(BinManager::getLayoutKey(_pop_mgr, dataset, *k_itr, n_threads));
+		}
+	}
+
 	PopulationManager::const_pheno_iterator ph_itr = _pop_mgr.beginPheno();
 
-	//TODO: make this a threaded call
-	if(n_threads == 0){
+	// Run one phenotype per thread, and give any threads left over (i.e.
+	// when there are fewer phenotypes than threads) to building the bins and
+	// to the tests
+	unsigned int n_pheno_threads = std::min(n_threads, _pop_mgr.getNumPhenotypes());
+	Test::Test::c_n_threads = n_pheno_threads ? n_threads / n_pheno_threads : 0;
+	BinManager::c_n_threads = Test::Test::c_n_threads;
+
+	if(n_pheno_threads <= 1){
 		binPhenotypes(ph_itr);
 	} else {
 		boost::thread_group tg;
-		for (unsigned int i = 0; i < n_threads; i++) {
+		for (unsigned int i = 0; i < n_pheno_threads; i++) {
 			tg.create_thread(boost::bind(&BinApplication::binPhenotypes, this, boost::ref(ph_itr)));
 		}
 		tg.join_all();
 	}
 }
 
+void BinApplication::openKnowledgeSnapshot(){
+	// The key includes the genome build, which is only settled once the VCF
+	// has been read
+	if(_snapshot){
+		_snapshot->open(c_knowledge_cache, Knowledge::KnowledgeSnapshot::getKey(_db, dbFilename));
+	}
+}
+
+void BinApplication::writeKnowledgeSnapshot(){
+	if(_snapshot && _snapshot->isModified()){
+		_snapshot->write();
+	}
+}
+
 void BinApplication::InitVcfDataset(const std::string& genomicBuild) {
 	Knowledge::Liftover::ConverterSQLite cnv(genomicBuild, _db);
+
+	// Reading only part of the VCF is safe only if every locus outside the
+	// requested regions would be ignored anyway
+	if(PopulationManager::c_use_vcf_index){
+		Knowledge::RegionCollection::bound_map bounds;
+		if(BinManager::IncludeIntergenic){
+			std::cerr << "WARNING: --vcf-use-index requires --bin-interregion N, reading entire VCF" << std::endl;
+		} else if(!regions->getLoadBounds(bounds)){
+			std::cerr << "WARNING: --vcf-use-index requires a region filter "
+					<< "(--include-region-names or --include-region-file), reading entire VCF" << std::endl;
+		} else {
+			_pop_mgr.setLoadBounds(bounds);
+		}
+	}
+
 	_pop_mgr.loadLoci(dataset, reportPrefix, Main::OutputDelimiter, genomicBuild, cnv);
 }
 
@@ -294,13 +348,24 @@ void BinApplication::Init(const string& filename, bool reportVersion) {
 	}
 
 	sqlite3_open(dbPath.c_str(), &_db);
+	dbFilename = dbPath.string();
 
 	// set the pragma to only allow temporary storage in memory
 	string memory_pragma = "PRAGMA temp_store=2;";
 	sqlite3_exec(_db, memory_pragma.c_str(), NULL, NULL, NULL);
 
-	_info = new Knowledge::InformationSQLite(_db);
-	regions = new Knowledge::RegionCollectionSQLite(_db, dataset, _info);
+	Knowledge::InformationSQLite* info = new Knowledge::InformationSQLite(_db);
+	Knowledge::RegionCollectionSQLite* region_coll =
+			new Knowledge::RegionCollectionSQLite(_db, dataset, info);
+
+	if(!c_knowledge_cache.empty()){
+		_snapshot = new Knowledge::KnowledgeSnapshot();
+		info->setSnapshot(_snapshot);
+		region_coll->setSnapshot(_snapshot);
+	}
+
+	_info = info;
+	regions = region_coll;
 
 }
 
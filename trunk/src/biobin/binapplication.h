@@ -49,6 +49,7 @@
 #include "knowledge/Information.h"
 #include "knowledge/liftover/Converter.h"
 #include "knowledge/GroupCollectionSQLite.h"
+#include "knowledge/KnowledgeSnapshot.h"
 #include "knowledge/liftover/ConverterSQLite.h"
 
 namespace BioBin {
@@ -86,6 +87,12 @@ public:
 	void InitVcfDataset(const std::string& genomicBuild);
 	void loadRoles(){_info->loadRoles(*regions);}
 
+	/**
+	 * Saves the knowledge read from the database to the knowledge cache, if
+	 * any was read that was not already there
+	 */
+	void writeKnowledgeSnapshot();
+
 	/**
 	 * Initialize the bins.  After this call, the binmanager will have the final
 	 * bins set up and ready to output.
@@ -101,10 +108,14 @@ public:
 	static bool c_print_populations;
 	static bool s_run_normal;
 	static unsigned int n_threads;
+	//! Binary file used to cache the knowledge read from the database between runs
+	static std::string c_knowledge_cache;
 
 private:
 	void Init(const std::string& dbFilename, bool reportVersions);
 
+	void openKnowledgeSnapshot();
+
 	void binPhenotypes(PopulationManager::const_pheno_iterator& ph_itr);
 
 	void printEscapedString(std::ostream& os, const std::string& toPrint, const std::string& toRepl, const std::string& replStr) const;
@@ -123,6 +134,8 @@ private:
 	Knowledge::RegionCollection* regions;
 	///< The knowedge meta groups
 	Knowledge::GroupCollection* groups;
+	///< The knowledge cache, if used
+	Knowledge::KnowledgeSnapshot* _snapshot;
 	///< the data associated with the user
 	std::deque<Knowledge::Locus*> dataset;
 
@@ -139,6 +152,8 @@ private:
 	PopulationManager _pop_mgr;
 
 	BinManager* binData;
+	///< The bins shared by phenotypes that bin the loci the same way
+	BinManager::LayoutCache _bin_layouts;
 
 	boost::mutex _output_mutex;
 	boost::mutex _pheno_mutex;
@@ -164,6 +179,7 @@ private:
 template <class T_cont>
 unsigned int BinApplication::LoadRegionData(T_cont& aliasesNotFound, const std::vector<std::string>& aliasList) {
 
+	openKnowledgeSnapshot();
 	regions->Load(aliasList);
 
 	//T_cont::const_iterator pos = aliasesNotFound.end();
@@ -187,7 +203,10 @@ unsigned int BinApplication::LoadRegionData(T_cont& aliasesNotFound, const std::
 template <class T1_cont>
 unsigned int BinApplication::LoadGroupDataByName(T1_cont& userDefinedGroups) {
 
-	groups = new Knowledge::GroupCollectionSQLite(*regions, _db, _info);
+	Knowledge::GroupCollectionSQLite* group_coll =
+			new Knowledge::GroupCollectionSQLite(*regions, _db, _info);
+	group_coll->setSnapshot(_snapshot);
+	groups = group_coll;
 	groups->Load();
 
 	std::vector<std::string> unmatchedAliases;
@@ -7,6 +7,13 @@
 
 #include "binmanager.h"
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/ref.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
+
 #include "PopulationManager.h"
 
 #include "knowledge/RegionCollection.h"
@@ -20,6 +27,7 @@ using std::pair;
 using std::set;
 using std::deque;
 using std::make_pair;
+using std::size_t;
 
 using boost::unordered_map;
 
@@ -46,19 +54,21 @@ bool BinManager::KeepUnknown = false;
 float BinManager::mafCutoff = 0.05;
 float BinManager::mafThreshold = 0;
 bool BinManager::BinConstantLoci = false;
+unsigned int BinManager::c_n_threads = 0;
 
 BinManager::BinManager(const PopulationManager& pop_mgr,
 		const Knowledge::RegionCollection& regions,
 		const std::deque<Knowledge::Locus*>& loci,
 		const Knowledge::Information& info,
-		const Phenotype& pheno) :
-	_pop_mgr(pop_mgr), _regions(regions), _info(info), _pheno(pheno) {
+		const Phenotype& pheno,
+		LayoutCache* layouts) :
+	_layouts(layouts), _pop_mgr(pop_mgr), _regions(regions), _info(info), _pheno(pheno) {
 	InitBins(loci);
 }
 
 BinManager::~BinManager() {
-	set<Bin*>::const_iterator itr = _bin_list.begin();
-	set<Bin*>::const_iterator end = _bin_list.end();
+	vector<Bin*>::const_iterator itr = _bins.begin();
+	vector<Bin*>::const_iterator end = _bins.end();
 	while(itr != end){
 		delete *itr;
 		++itr;
@@ -67,95 +77,235 @@ BinManager::~BinManager() {
 
 void BinManager::InitBins(const deque<Knowledge::Locus*>& loci) {
 
-	deque<Knowledge::Locus*>::const_iterator l_itr = loci.begin();
-
-	_rare_variants = 0;
-
-	while(l_itr != loci.end()){
-		Knowledge::Locus& l = **l_itr;
-
-
-		if (_pop_mgr.isRare(l, _pheno.getStatus(), mafThreshold, mafCutoff)
-				&& (BinConstantLoci || _pop_mgr.isPresent(l, _pheno.getStatus()))) {
-			++_rare_variants;
-
-			// First, find all of the regions that contain this locus
-			RegionCollection::const_region_iterator r_itr =
-					_regions.locusBegin(&l);
-			RegionCollection::const_region_iterator r_end =
-					_regions.locusEnd(&l);
-
-			Bin* curr_bin;
-			if ((r_itr == r_end || (!UsePathways && !ExpandByGenes)) && IncludeIntergenic){
-				//Add to intergenic
-
-				// The algorithm is as follows:
-				// 1) find the bin # that we would find if we were just stepping
-				//    by the StepSize (non-overlapping)
-				// 2) if the position is within the bin (bin# + witdh) < position),
-				//    then add the position to the intergenic bin in question
-				// 3) decrement the bin # and go to step (2)
-				int bin_no = l.getPos() / (IntergenicBinStep*1000);
-				while((bin_no*IntergenicBinStep + IntergenicBinWidth)*1000 >= l.getPos()){
-					pair<short, int> key = make_pair(l.getChrom(), bin_no);
-					unordered_map<pair<short, int>, Bin*>::const_iterator i_bin =
-							_intergenic_bins.find(key);
-
-					if (i_bin == _intergenic_bins.end()){
-						// OK, this bin is nonexistent
-						curr_bin = new Bin(_pop_mgr, key.first, key.second, _pheno);
-						_intergenic_bins.insert(make_pair(key, curr_bin));
-						_bin_list.insert(curr_bin);
-					}else{
-						curr_bin = (*i_bin).second;
-					}
-					curr_bin->addLocus(&l);
-					_locus_bins[&l].insert(curr_bin);
-
-					--bin_no;
-				}
+	// First, find the rare loci
+	_layout.reset(new Layout(_pheno));
+	scanLoci(_pop_mgr, _pheno, loci, c_n_threads, *_layout);
+	_rare_variants = _layout->rare_idx.size();
+
+	// If an earlier phenotype has the same rare loci, each adding the same
+	// amount to the size of a bin, its bins are exactly the ones we would
+	// build, so just copy them
+	if(_layouts){
+		boost::shared_ptr<Layout> layout = _layouts->take(*_layout);
+		if(layout){
+			_layout = layout;
+			_bins.reserve(_layout->bins.size());
+			vector<Bin*>::const_iterator b_itr = _layout->bins.begin();
+			for( ; b_itr != _layout->bins.end(); ++b_itr){
+				_bins.push_back(new Bin(**b_itr, _pheno));
 			}
+			pointBins(*_layout, _bins);
+			return;
+		}
+	}
 
-			while (r_itr != r_end){
-				// For each region, get all of the groups it is in
-				Region::const_group_iterator g_itr = (*r_itr)->groupBegin();
-				Region::const_group_iterator g_end = (*r_itr)->groupEnd();
-
-				// If Gene expansion is enabled and we are either not using
-				// pathway information OR the gene belongs to no pathways,
-				// we add it to a region bin
-				if(ExpandByGenes && (!UsePathways || g_itr == g_end)){
-					curr_bin = addRegionBin(*r_itr);
-					curr_bin->addLocus(&l);
-					_locus_bins[&l].insert(curr_bin);
-				}
+	_layout->loci.reserve(_layout->rare_idx.size());
+	vector<unsigned int>::const_iterator r_itr = _layout->rare_idx.begin();
+	for( ; r_itr != _layout->rare_idx.end(); ++r_itr){
+		_layout->loci.push_back(loci[*r_itr]);
+	}
 
-				// add to all group bins that it is a member of, provided that
-				// we want to use pathway information
-				while(UsePathways && g_itr != g_end){
-					int id = (*g_itr)->getID();
-					unordered_map<int, Bin*>::const_iterator gm_itr = _group_bins.find(id);
-					if (gm_itr == _group_bins.end()){
-						curr_bin = new Bin(_pop_mgr, *g_itr, _pheno);
-						_bin_list.insert(curr_bin);
-						_group_bins.insert(make_pair(id,curr_bin));
-					}else{
-						curr_bin = (*gm_itr).second;
-					}
-					curr_bin->addLocus(&l);
-					_locus_bins[&l].insert(curr_bin);
-					++g_itr;
-				}
-				++r_itr;
-			}
+	// Taking the loci in order of position adds them to the bins in order
+	std::sort(_layout->loci.begin(), _layout->loci.end(), std::less<Locus*>());
+
+	// Now, bin each run of the rare loci on its own.  Bins that span more
+	// than one run (pathways and any bin that straddles the boundary of a
+	// run) are merged afterwards, taking the runs in order so that the loci
+	// of every bin stay in order.
+	unsigned int n_loci = _layout->loci.size();
+	unsigned int n_shards = std::max(1u, std::min(c_n_threads, n_loci / MIN_SHARD_SIZE));
+	vector<StagedShard> shards(n_shards);
+	if(n_shards <= 1){
+		stageShard(0, n_loci, shards[0]);
+	} else {
+		boost::thread_group tg;
+		for(unsigned int i=1; i<n_shards; i++){
+			tg.create_thread(boost::bind(&BinManager::stageShard, this,
+					shardStart(n_loci, n_shards, i),
+					shardStart(n_loci, n_shards, i + 1), boost::ref(shards[i])));
 		}
-		++l_itr;
+		stageShard(0, shardStart(n_loci, n_shards, 1), shards[0]);
+		tg.join_all();
+	}
+
+	for(unsigned int i=0; i<n_shards; i++){
+		mergeShard(shards[i]);
 	}
 
 	// At this point, we have all of the top level bins constructed and
 	// stored in the variable _bin_list.  We should now collapse the
 	// bins according to the preferences given
 	collapseBins();
+
+	// Offer the bins to any later phenotypes with the same rare loci
+	if(_layouts){
+		_layout->bins.reserve(_bins.size());
+		vector<Bin*>::const_iterator b_itr = _bins.begin();
+		for( ; b_itr != _bins.end(); ++b_itr){
+			_layout->bins.push_back(new Bin(**b_itr, _layout->pheno));
+		}
+		pointBins(*_layout, _layout->bins);
+		_layouts->put(_layout);
+	}
+}
+
+size_t BinManager::getLayoutKey(const PopulationManager& pop_mgr,
+		const deque<Knowledge::Locus*>& loci, const Phenotype& pheno,
+		unsigned int n_threads){
+	Layout layout(pheno);
+	scanLoci(pop_mgr, pheno, loci, n_threads, layout);
+	return layout.key;
+}
+
+unsigned int BinManager::shardStart(unsigned int n, unsigned int n_shards, unsigned int shard){
+	return static_cast<unsigned int>(static_cast<unsigned long>(n) * shard / n_shards);
+}
+
+void BinManager::scanLoci(const PopulationManager& pop_mgr, const Phenotype& pheno,
+		const deque<Knowledge::Locus*>& loci, unsigned int n_threads,
+		Layout& layout_out){
+
+	// Split the work into contiguous runs of loci, one per thread
+	unsigned int n_loci = loci.size();
+	unsigned int n_shards = std::max(1u, std::min(n_threads, n_loci / MIN_SHARD_SIZE));
+
+	vector<char> is_rare(n_loci, 0);
+	vector<unsigned int> contrib(n_loci, 0);
+	if(n_shards <= 1){
+		findRare(pop_mgr, pheno, loci, 0, n_loci, is_rare, contrib);
+	} else {
+		boost::thread_group tg;
+		for(unsigned int i=1; i<n_shards; i++){
+			tg.create_thread(boost::bind(&BinManager::findRare, boost::cref(pop_mgr),
+					boost::cref(pheno), boost::cref(loci),
+					shardStart(n_loci, n_shards, i), shardStart(n_loci, n_shards, i + 1),
+					boost::ref(is_rare), boost::ref(contrib)));
+		}
+		findRare(pop_mgr, pheno, loci, 0, shardStart(n_loci, n_shards, 1), is_rare, contrib);
+		tg.join_all();
+	}
+
+	for(unsigned int i=0; i<n_loci; i++){
+		if(is_rare[i]){
+			layout_out.rare_idx.push_back(i);
+			layout_out.rare_contrib.push_back(contrib[i]);
+		}
+	}
+	layout_out.key = 0;
+	boost::hash_combine(layout_out.key, layout_out.rare_idx);
+	boost::hash_combine(layout_out.key, layout_out.rare_contrib);
+}
+
+void BinManager::findRare(const PopulationManager& pop_mgr, const Phenotype& pheno,
+		const deque<Knowledge::Locus*>& loci, unsigned int begin, unsigned int end,
+		vector<char>& rare_out, vector<unsigned int>& contrib_out){
+	for(unsigned int i=begin; i<end; i++){
+		const Knowledge::Locus& l = *loci[i];
+		rare_out[i] = pop_mgr.isRare(l, pheno, mafThreshold, mafCutoff)
+				&& (BinConstantLoci || pop_mgr.isPresent(l, pheno));
+		if(rare_out[i]){
+			// all that the size of a bin depends on
+			contrib_out[i] = pop_mgr.genotypeContribution(l, pheno, true)
+					+ pop_mgr.genotypeContribution(l, pheno, false);
+		}
+	}
+}
+
+void BinManager::stageShard(unsigned int begin, unsigned int end,
+		StagedShard& shard_out) const{
+
+	for(unsigned int locus_idx=begin; locus_idx<end; locus_idx++){
+		Knowledge::Locus& l = *_layout->loci[locus_idx];
+
+		// First, find all of the regions that contain this locus
+		RegionCollection::const_region_iterator r_itr =
+				_regions.locusBegin(&l);
+		RegionCollection::const_region_iterator r_end =
+				_regions.locusEnd(&l);
+
+		if ((r_itr == r_end || (!UsePathways && !ExpandByGenes)) && IncludeIntergenic){
+			//Add to intergenic
+
+			// The algorithm is as follows:
+			// 1) find the bin # that we would find if we were just stepping
+			//    by the StepSize (non-overlapping)
+			// 2) if the position is within the bin (bin# + witdh) < position),
+			//    then add the position to the intergenic bin in question
+			// 3) decrement the bin # and go to step (2)
+			int bin_no = l.getPos() / (IntergenicBinStep*1000);
+			while((bin_no*IntergenicBinStep + IntergenicBinWidth)*1000 >= l.getPos()){
+				shard_out.intergenic[make_pair(l.getChrom(), bin_no)].push_back(locus_idx);
+				--bin_no;
+			}
+		}
+
+		while (r_itr != r_end){
+			// For each region, get all of the groups it is in
+			Region::const_group_iterator g_itr = (*r_itr)->groupBegin();
+			Region::const_group_iterator g_end = (*r_itr)->groupEnd();
+
+			// If Gene expansion is enabled and we are either not using
+			// pathway information OR the gene belongs to no pathways,
+			// we add it to a region bin
+			if(ExpandByGenes && (!UsePathways || g_itr == g_end)){
+				appendLocus(shard_out.regions[*r_itr], locus_idx);
+			}
+
+			// add to all group bins that it is a member of, provided that
+			// we want to use pathway information
+			while(UsePathways && g_itr != g_end){
+				appendLocus(shard_out.groups[*g_itr], locus_idx);
+				++g_itr;
+			}
+			++r_itr;
+		}
+	}
+}
+
+void BinManager::appendLocus(vector<unsigned int>& bin_loci, unsigned int locus_idx){
+	// Loci are mostly added in order, so this catches most duplicates
+	if(bin_loci.empty() || bin_loci.back() != locus_idx){
+		bin_loci.push_back(locus_idx);
+	}
+}
+
+void BinManager::mergeShard(StagedShard& shard){
+	Bin* curr_bin;
+
+	unordered_map<pair<short, int>, vector<unsigned int> >::iterator i_itr = shard.intergenic.begin();
+	for( ; i_itr != shard.intergenic.end(); ++i_itr){
+		const pair<short, int>& key = (*i_itr).first;
+		unordered_map<pair<short, int>, Bin*>::const_iterator i_bin =
+				_intergenic_bins.find(key);
+		if (i_bin == _intergenic_bins.end()){
+			// OK, this bin is nonexistent
+			curr_bin = new Bin(_pop_mgr, key.first, key.second, _pheno);
+			_intergenic_bins.insert(make_pair(key, curr_bin));
+			_bin_list.insert(curr_bin);
+		}else{
+			curr_bin = (*i_bin).second;
+		}
+		stageLoci(curr_bin, (*i_itr).second);
+	}
+
+	unordered_map<Region*, vector<unsigned int> >::iterator r_itr = shard.regions.begin();
+	for( ; r_itr != shard.regions.end(); ++r_itr){
+		stageLoci(addRegionBin((*r_itr).first), (*r_itr).second);
+	}
+
+	unordered_map<Group*, vector<unsigned int> >::iterator g_itr = shard.groups.begin();
+	for( ; g_itr != shard.groups.end(); ++g_itr){
+		int id = (*g_itr).first->getID();
+		unordered_map<int, Bin*>::const_iterator gm_itr = _group_bins.find(id);
+		if (gm_itr == _group_bins.end()){
+			curr_bin = new Bin(_pop_mgr, (*g_itr).first, _pheno);
+			_bin_list.insert(curr_bin);
+			_group_bins.insert(make_pair(id,curr_bin));
+		}else{
+			curr_bin = (*gm_itr).second;
+		}
+		stageLoci(curr_bin, (*g_itr).second);
+	}
 }
 
 void BinManager::printBinData(std::ostream& os, const string& sep, bool transpose) const{
@@ -168,15 +318,17 @@ void BinManager::printBinData(std::ostream& os, const string& sep, bool transpos
 
 void BinManager::printBins(std::ostream& os, Knowledge::Locus* l,
 		const string& sep) const{
-	unordered_map<Knowledge::Locus*, set<Bin*> >::const_iterator m_itr = _locus_bins.find(l);
-
-	if(m_itr != _locus_bins.end()){
-		set<Bin*>::const_iterator s_itr = (*m_itr).second.begin();
-		set<Bin*>::const_iterator s_end = (*m_itr).second.end();
-		if (s_itr != s_end){
-			os << (*s_itr)->getName();
-			while(++s_itr != s_end){
-				os << sep << (*s_itr)->getName();
+	vector<Locus*>::const_iterator l_itr =
+			std::lower_bound(_layout->loci.begin(), _layout->loci.end(), l, std::less<Locus*>());
+
+	if(l_itr != _layout->loci.end() && *l_itr == l){
+		unsigned int locus_idx = l_itr - _layout->loci.begin();
+		unsigned int b_itr = _layout->locus_offsets[locus_idx];
+		unsigned int b_end = _layout->locus_offsets[locus_idx + 1];
+		if (b_itr != b_end){
+			os << _bins[_layout->locus_bins[b_itr]]->getName();
+			while(++b_itr != b_end){
+				os << sep << _bins[_layout->locus_bins[b_itr]]->getName();
 			}
 		}
 	}
@@ -189,9 +341,8 @@ void BinManager::printLocusBinCount(std::ostream& os, float pct) const{
 
 	countMap[0] = 0;
 
-	unordered_map<Locus*, set<Bin*> >::const_iterator l_bin_itr = _locus_bins.begin();
-	while(l_bin_itr != _locus_bins.end()){
-		++countMap[(*(l_bin_itr++)).second.size()];
+	for(unsigned int i=0; i<_layout->loci.size(); i++){
+		++countMap[_layout->locus_offsets[i + 1] - _layout->locus_offsets[i]];
 	}
 
 	map<unsigned int, unsigned int>::const_iterator cm_itr = countMap.begin();
@@ -202,7 +353,7 @@ void BinManager::printLocusBinCount(std::ostream& os, float pct) const{
 
 	os << "Number of Bins per locus" << std::endl;
 
-	unsigned int thresh = (_locus_bins.size() - countMap[0]) * pct;
+	unsigned int thresh = (_layout->loci.size() - countMap[0]) * pct;
 	unsigned int currCount = 0;
 	unsigned int currMin = 1;
 
@@ -229,33 +380,28 @@ void BinManager::collapseBins(){
 
 	// First, we expand the groups into genes
 	set<Bin*>::iterator b_itr = _bin_list.begin();
-	Bin::locus_iterator v_itr;
-	Bin::const_locus_iterator v_end;
+	vector<unsigned int>::const_iterator v_itr;
 	while(ExpandByGenes && b_itr != _bin_list.end() && (*b_itr)->isGroup()){
+		syncBin(*b_itr);
 		if((*b_itr)->getSize() > BinTraverseThreshold){
 
-			// First, add all of the appropriate child bins
+			// First, add all of the appropriate child bins: each locus
+			// goes to the bins of the regions of this group that contain it
 			Group* curr_group = (*b_itr)->getGroup();
-			Group::const_region_iterator r_itr = curr_group->regionBegin();
-			Group::const_region_iterator r_end = curr_group->regionEnd();
-
-			Bin* curr_bin;
-			v_end = (*b_itr)->variantEnd();
-			while(r_itr != r_end){
-
-				// For all rare loci in the current region, associate them
-				// with this bin
-				v_itr = (*b_itr)->variantBegin();
-
-				while(v_itr != v_end){
-					if ((*r_itr)->containsLocus(**v_itr)){
-						curr_bin = addRegionBin(*r_itr);
-						curr_bin->addLocus(*v_itr);
-						_locus_bins[*v_itr].insert(curr_bin);
+			const vector<unsigned int>& group_loci = _staged_loci[*b_itr];
+			v_itr = group_loci.begin();
+			while(v_itr != group_loci.end()){
+				RegionCollection::const_region_iterator r_itr =
+						_regions.locusBegin(_layout->loci[*v_itr]);
+				RegionCollection::const_region_iterator r_end =
+						_regions.locusEnd(_layout->loci[*v_itr]);
+				while(r_itr != r_end){
+					if (curr_group->containsRegion(*r_itr)){
+						stageLocus(addRegionBin(*r_itr), *v_itr);
 					}
-					++v_itr;
+					++r_itr;
 				}
-				++r_itr;
+				++v_itr;
 			}
 
 			// Now, erase the bin
@@ -279,13 +425,17 @@ void BinManager::collapseBins(){
 	while (ExpandByExons && b_itr != _bin_list.end()
 			&& !(*b_itr)->isIntergenic()) {
 
+		syncBin(*b_itr);
 		if ((uint) (*b_itr)->getSize() >= BinTraverseThreshold) {
 
 			role_bin_list.clear();
 
-			v_itr = (*b_itr)->variantBegin();
-			v_end = (*b_itr)->variantEnd();
-			while (v_itr != v_end) {
+			// The loci without a role stay in the current bin
+			vector<unsigned int>& bin_loci = _staged_loci[*b_itr];
+			vector<unsigned int>::iterator keep_itr = bin_loci.begin();
+			v_itr = bin_loci.begin();
+			while (v_itr != bin_loci.end()) {
+				const Locus& l = *_layout->loci[*v_itr];
 				unsigned long role = 0;
 				if ((*b_itr)->isGroup()) {
 					Group* curr_group = (*b_itr)->getGroup();
@@ -294,11 +444,11 @@ void BinManager::collapseBins(){
 					Group::const_region_iterator r_end =
 							curr_group->regionEnd();
 					while (r_itr != r_end) {
-						role |= _info.getSNPRole(**v_itr, **r_itr);
+						role |= _info.getSNPRole(l, **r_itr);
 						++r_itr;
 					}
 				} else {
-					role = _info.getSNPRole(**v_itr, *(*b_itr)->getRegion());
+					role = _info.getSNPRole(l, *(*b_itr)->getRegion());
 				}
 
 				role_itr = Information::snp_role::begin();
@@ -315,21 +465,18 @@ void BinManager::collapseBins(){
 							new_bin = (*role_bin_itr).second;
 						}
 
-						new_bin->addLocus(*v_itr);
-						_locus_bins[*v_itr].insert(new_bin);
+						stageLocus(new_bin, *v_itr);
 					}
 					++role_itr;
 				}
 
 				// If there was a role, remove it from the current bin
-				if (role) {
-					_locus_bins[*v_itr].erase(*b_itr);
-					v_itr = (*b_itr)->erase(v_itr);
-				} else {
-					++v_itr;
+				if (!role) {
+					*(keep_itr++) = *v_itr;
 				}
-
+				++v_itr;
 			}
+			bin_loci.erase(keep_itr, bin_loci.end());
 
 			// Again, if we filter, this will be empty and correct!
 			bool unk = false;
@@ -360,6 +507,7 @@ void BinManager::collapseBins(){
 	//OK, now we go through and clean up all of the bins that are too small!
 	b_itr = _bin_list.begin();
 	while(b_itr != _bin_list.end()){
+		syncBin(*b_itr);
 		if((uint)(*b_itr)->getSize() < MinBinSize){
 			eraseBin(b_itr);
 		}else{
@@ -367,6 +515,8 @@ void BinManager::collapseBins(){
 			++b_itr;
 		}
 	}
+
+	freezeBins();
 	return;
 }
 
@@ -382,13 +532,8 @@ void BinManager::eraseBin(set<Bin*>::iterator& b_itr){
 		_region_bins.erase((*b_itr)->getID());
 	}
 
-	// remove the bin from the locus->set<Bin*>
-	Bin::const_locus_iterator v_itr = (*b_itr)->variantBegin();
-	Bin::const_locus_iterator v_end = (*b_itr)->variantEnd();
-	while(v_itr != v_end){
-		_locus_bins[*v_itr].erase(*b_itr);
-		++v_itr;
-	}
+	// remove the loci of the bin
+	_staged_loci.erase(*b_itr);
 
 	// Delete the bin itself
 	delete *b_itr;
@@ -411,6 +556,132 @@ Bin* BinManager::addRegionBin(Region* reg){
 	return curr_bin;
 }
 
+void BinManager::stageLocus(Bin* bin, unsigned int locus_idx){
+	appendLocus(_staged_loci[bin], locus_idx);
+}
+
+void BinManager::stageLoci(Bin* bin, vector<unsigned int>& loci){
+	vector<unsigned int>& bin_loci = _staged_loci[bin];
+	if(bin_loci.empty()){
+		bin_loci.swap(loci);
+	} else {
+		bin_loci.insert(bin_loci.end(), loci.begin(), loci.end());
+	}
+}
+
+void BinManager::syncBin(Bin* bin){
+	vector<unsigned int>& bin_loci = _staged_loci[bin];
+	std::sort(bin_loci.begin(), bin_loci.end());
+	bin_loci.erase(std::unique(bin_loci.begin(), bin_loci.end()), bin_loci.end());
+
+	const unsigned int* begin = bin_loci.empty() ? 0 : &bin_loci[0];
+	bin->setVariants(_layout->loci.empty() ? 0 : &_layout->loci[0], begin, begin + bin_loci.size());
+}
+
+void BinManager::freezeBins(){
+
+	// Number the bins in order and lay out their loci one after the other,
+	// counting the bins of each locus as we go
+	_bins.assign(_bin_list.begin(), _bin_list.end());
+	_bin_list.clear();
+
+	_layout->bin_offsets.clear();
+	_layout->bin_offsets.reserve(_bins.size() + 1);
+	_layout->bin_loci.clear();
+	_layout->locus_offsets.assign(_layout->loci.size() + 1, 0);
+	for(unsigned int i=0; i<_bins.size(); i++){
+		syncBin(_bins[i]);
+		const vector<unsigned int>& bin_loci = _staged_loci[_bins[i]];
+		_layout->bin_offsets.push_back(_layout->bin_loci.size());
+		_layout->bin_loci.insert(_layout->bin_loci.end(), bin_loci.begin(), bin_loci.end());
+		for(unsigned int j=0; j<bin_loci.size(); j++){
+			++_layout->locus_offsets[bin_loci[j] + 1];
+		}
+	}
+	_layout->bin_offsets.push_back(_layout->bin_loci.size());
+	_staged_loci.clear();
+
+	// Now, the transpose: the bins of each locus
+	for(unsigned int i=0; i<_layout->loci.size(); i++){
+		_layout->locus_offsets[i + 1] += _layout->locus_offsets[i];
+	}
+	vector<unsigned int> locus_next(_layout->locus_offsets.begin(), _layout->locus_offsets.end() - 1);
+	_layout->locus_bins.resize(_layout->bin_loci.size());
+	for(unsigned int i=0; i<_bins.size(); i++){
+		for(unsigned int j=_layout->bin_offsets[i]; j<_layout->bin_offsets[i + 1]; j++){
+			_layout->locus_bins[locus_next[_layout->bin_loci[j]]++] = i;
+		}
+	}
+
+	// Finally, point the bins at their loci
+	pointBins(*_layout, _bins);
+}
+
+void BinManager::pointBins(const Layout& layout, const vector<Bin*>& bins){
+	const unsigned int* bin_loci = layout.bin_loci.empty() ? 0 : &layout.bin_loci[0];
+	for(unsigned int i=0; i<bins.size(); i++){
+		bins[i]->setVariants(layout.loci.empty() ? 0 : &layout.loci[0],
+				bin_loci + layout.bin_offsets[i], bin_loci + layout.bin_offsets[i + 1]);
+	}
+}
+
+BinManager::Layout::~Layout(){
+	vector<Bin*>::const_iterator itr = bins.begin();
+	for( ; itr != bins.end(); ++itr){
+		delete *itr;
+	}
+}
+
+void BinManager::LayoutCache::expect(size_t key){
+	boost::unique_lock<boost::mutex> l(_lock);
+	++_expected[key];
+}
+
+boost::shared_ptr<BinManager::Layout> BinManager::LayoutCache::take(const Layout& inputs){
+	boost::unique_lock<boost::mutex> l(_lock);
+
+	unordered_map<size_t, unsigned int>::iterator e_itr = _expected.find(inputs.key);
+	bool more_expected = false;
+	if(e_itr != _expected.end() && (*e_itr).second > 0){
+		more_expected = (--(*e_itr).second) > 0;
+	}
+
+	vector<boost::shared_ptr<Layout> >::iterator l_itr = _layouts.begin();
+	for( ; l_itr != _layouts.end(); ++l_itr){
+		if(sameInputs(**l_itr, inputs)){
+			boost::shared_ptr<Layout> layout = *l_itr;
+			// Once the last phenotype with this key has it, drop it
+			if(!more_expected){
+				_layouts.erase(l_itr);
+			}
+			return layout;
+		}
+	}
+	return boost::shared_ptr<Layout>();
+}
+
+void BinManager::LayoutCache::put(const boost::shared_ptr<Layout>& layout){
+	boost::unique_lock<boost::mutex> l(_lock);
+
+	unordered_map<size_t, unsigned int>::const_iterator e_itr = _expected.find(layout->key);
+	if(e_itr == _expected.end() || (*e_itr).second == 0){
+		return;
+	}
+
+	// Another thread may have built the same bins at the same time
+	vector<boost::shared_ptr<Layout> >::const_iterator l_itr = _layouts.begin();
+	for( ; l_itr != _layouts.end(); ++l_itr){
+		if(sameInputs(**l_itr, *layout)){
+			return;
+		}
+	}
+	_layouts.push_back(layout);
+}
+
+bool BinManager::LayoutCache::sameInputs(const Layout& x, const Layout& y){
+	return x.key == y.key && x.rare_idx == y.rare_idx && x.rare_contrib == y.rare_contrib;
+}
+
 } // namespace BioBin;
 
 
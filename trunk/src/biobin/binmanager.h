@@ -15,6 +15,8 @@
 #include <utility>
 #include <deque>
 #include <boost/unordered_map.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #define BOOST_IOSTREAMS_USE_DEPRECATED
 #include <boost/iostreams/stream.hpp>
@@ -43,13 +45,23 @@ namespace BioBin {
 
 class BinManager {
 public:
-	typedef std::set<Bin*>::const_iterator const_iterator;
+	typedef std::vector<Bin*>::const_iterator const_iterator;
 
+	class LayoutCache;
+
+	/*!
+	 * \brief Bins the rare loci for a phenotype.
+	 *
+	 * \param layouts If given, the bins are copied from an earlier phenotype
+	 * that bins the loci exactly the same way, if there is one, and are
+	 * offered to later phenotypes otherwise.
+	 */
 	BinManager(const BioBin::PopulationManager& pop_mgr,
 			const Knowledge::RegionCollection& regions,
 			const std::deque<Knowledge::Locus*>& loci,
 			const Knowledge::Information& info,
-			const Utility::Phenotype& pheno);
+			const Utility::Phenotype& pheno,
+			LayoutCache* layouts = 0);
 
 	virtual ~BinManager();
 	//BinManager(const BinManager& orig);
@@ -57,11 +69,11 @@ public:
 	void InitBins(const std::deque<Knowledge::Locus*>& loci);
 
 	int numRareVariants() const { return _rare_variants;}
-	int size() const {return _bin_list.size();}
+	int size() const {return _bins.size();}
 	//int numTotalVariants() const {return _total_variants;}
 
-	const_iterator begin() const {return _bin_list.begin();}
-	const_iterator end() const {return _bin_list.end();}
+	const_iterator begin() const {return _bins.begin();}
+	const_iterator end() const {return _bins.end();}
 
 	void printBinData(std::ostream& os, const std::string& sep, bool transpose= false) const;
 
@@ -71,6 +83,14 @@ public:
 	void printBins(std::ostream& os, Knowledge::Locus* locus, const std::string& sep="|") const;
 	void printLocusBinCount(std::ostream& os, float pct=0.1) const;
 
+	/*!
+	 * \brief Computes a key for the bins of a phenotype, without building
+	 * them.  Phenotypes that bin the loci the same way have the same key.
+	 */
+	static std::size_t getLayoutKey(const BioBin::PopulationManager& pop_mgr,
+			const std::deque<Knowledge::Locus*>& loci,
+			const Utility::Phenotype& pheno, unsigned int n_threads);
+
 	static unsigned int IntergenicBinWidth;				///< The width of the intergenic bins within a chromosome
 	static unsigned int IntergenicBinStep;				///< The size of the step to take for intergenic sliding-window analysis
 	static unsigned int BinTraverseThreshold;			///< The number of SNPs to determine whether we continue traversing
@@ -86,12 +106,83 @@ public:
 	static float mafCutoff; 	///< Max maf to produce result in a bin
 	static float mafThreshold; ///< Min maf to produce result in a bin
 	static bool BinConstantLoci;
+	//! Number of threads used to build the bins of a single phenotype (0 or 1 = run on the calling thread only)
+	static unsigned int c_n_threads;
 
 private:
 
 	BinManager(const BinManager&);
 	BinManager& operator=(const BinManager&);
 
+	// The fewest loci worth giving to a thread of their own
+	static const unsigned int MIN_SHARD_SIZE = 1000;
+
+	/*
+	 * The loci of the bins.  These depend on the phenotype only through
+	 * which loci are rare and how much each one adds to the size of a bin, so
+	 * they are shared by all phenotypes for which those are the same.
+	 */
+	struct Layout{
+		explicit Layout(const Utility::Phenotype& ph) : key(0), pheno(ph) {}
+		~Layout();
+
+		// What the bins are built from: the index (in the loci given to
+		// InitBins) and the total contribution of each rare locus, and a hash
+		// of both
+		std::size_t key;
+		std::vector<unsigned int> rare_idx;
+		std::vector<unsigned int> rare_contrib;
+
+		// The rare loci, in order of position.  Loci are referred to by their
+		// index in this list.
+		std::vector<Knowledge::Locus*> loci;
+		// The loci of bin i are bin_loci[bin_offsets[i]] up to (but not
+		// including) bin_loci[bin_offsets[i+1]], in order of position
+		std::vector<unsigned int> bin_offsets;
+		std::vector<unsigned int> bin_loci;
+		// The bins of locus i are locus_bins[locus_offsets[i]] up to (but not
+		// including) locus_bins[locus_offsets[i+1]], in order
+		std::vector<unsigned int> locus_offsets;
+		std::vector<unsigned int> locus_bins;
+
+		// Copies of the bins, from which the bins of other phenotypes are
+		// copied; only kept when the layout is offered to other phenotypes
+		Utility::Phenotype pheno;
+		std::vector<Bin*> bins;
+
+	private:
+		Layout(const Layout&);
+		Layout& operator=(const Layout&);
+	};
+
+	// The loci (by index in _layout->loci) of the bins built from one run of
+	// the loci
+	struct StagedShard{
+		boost::unordered_map<std::pair<short, int>, std::vector<unsigned int> > intergenic;
+		boost::unordered_map<Knowledge::Region*, std::vector<unsigned int> > regions;
+		boost::unordered_map<Knowledge::Group*, std::vector<unsigned int> > groups;
+	};
+
+	// The first of n items in the given shard, when split into n_shards
+	static unsigned int shardStart(unsigned int n, unsigned int n_shards, unsigned int shard);
+	// Finds the rare loci and their contributions, filling the key,
+	// rare_idx and rare_contrib of layout_out
+	static void scanLoci(const PopulationManager& pop_mgr, const Utility::Phenotype& pheno,
+			const std::deque<Knowledge::Locus*>& loci, unsigned int n_threads,
+			Layout& layout_out);
+	// Determines which of the loci [begin, end) are rare, setting rare_out[i]
+	// and (for rare loci) contrib_out[i]
+	static void findRare(const PopulationManager& pop_mgr, const Utility::Phenotype& pheno,
+			const std::deque<Knowledge::Locus*>& loci, unsigned int begin,
+			unsigned int end, std::vector<char>& rare_out,
+			std::vector<unsigned int>& contrib_out);
+	// Bins the loci [begin, end) of _layout->loci, without touching any of the bins
+	void stageShard(unsigned int begin, unsigned int end, StagedShard& shard_out) const;
+	// Adds a locus to the end of the loci of a bin, unless it is already there
+	static void appendLocus(std::vector<unsigned int>& bin_loci, unsigned int locus_idx);
+	// Creates the bins of a shard, or adds its loci to the existing bins
+	void mergeShard(StagedShard& shard);
+
 	// Collapses all of the bins according to the preferences we set.
 	void collapseBins();
 	// Erases (and increments) a single bin
@@ -99,8 +190,22 @@ private:
 
 	Bin* addRegionBin(Knowledge::Region* reg);
 
-	// The authoritative list of all of the bins.  Everything else holds pointers
-	// to bins in this set.
+	// Adds a locus (by index in _layout->loci) to a bin that is being built
+	void stageLocus(Bin* bin, unsigned int locus_idx);
+	// Adds loci (in order, after any already added) to a bin that is being
+	// built; may take the contents of loci
+	void stageLoci(Bin* bin, std::vector<unsigned int>& loci);
+	// Sorts the loci added to a bin that is being built and points the bin
+	// at them, so that the bin can be sized and iterated
+	void syncBin(Bin* bin);
+	// Lays out the loci of all of the bins in _layout
+	void freezeBins();
+	// Points each of the bins at its loci in the layout
+	static void pointBins(const Layout& layout, const std::vector<Bin*>& bins);
+
+	// The authoritative list of all of the bins while they are built and
+	// collapsed.  Everything else holds pointers to bins in this set.  When
+	// done, the bins are moved to _bins.
 	std::set<Bin*> _bin_list;
 	// Mapping of Region IDs to bins
 	boost::unordered_map<int, Bin*> _region_bins;
@@ -108,8 +213,15 @@ private:
 	boost::unordered_map<int, Bin*> _group_bins;
 	// List of intergenic bins
 	boost::unordered_map<std::pair<short, int>, Bin*> _intergenic_bins;
-	// List of bins by locus
-	boost::unordered_map<Knowledge::Locus*, std::set<Bin*> > _locus_bins;
+	// Loci (by index in _layout->loci) of each bin while the bins are built
+	boost::unordered_map<Bin*, std::vector<unsigned int> > _staged_loci;
+
+	// All of the bins, in order.  Bins are referred to by their index in
+	// this list.
+	std::vector<Bin*> _bins;
+	// The loci of the bins, possibly shared with other phenotypes
+	boost::shared_ptr<Layout> _layout;
+	LayoutCache* _layouts;
 
 	// # of all variants, rare and common
 	int _rare_variants;
@@ -122,6 +234,35 @@ private:
 };
 
 
+/*!
+ * \brief Keeps the bins built for one phenotype, for the later phenotypes
+ * that bin the loci exactly the same way.
+ * Before any bins are built, expect is called with the key of every
+ * phenotype (see BinManager::getLayoutKey); the bins are then kept until
+ * all of the phenotypes with the same key have taken them.  May be used by
+ * several BinManagers at once.
+ */
+class BinManager::LayoutCache{
+public:
+	//! Notes that the bins of a phenotype with the given key will be built
+	void expect(std::size_t key);
+
+private:
+	friend class BinManager;
+
+	// Finds the layout built from the same loci, if there is one, noting
+	// that one of the phenotypes expected has arrived
+	boost::shared_ptr<Layout> take(const Layout& inputs);
+	// Keeps a new layout, if any more phenotypes are expected to take it
+	void put(const boost::shared_ptr<Layout>& layout);
+
+	static bool sameInputs(const Layout& x, const Layout& y);
+
+	boost::mutex _lock;
+	boost::unordered_map<std::size_t, unsigned int> _expected;
+	std::vector<boost::shared_ptr<Layout> > _layouts;
+};
+
 template <class L_cont>
 FILE* BinManager::printLocusBins(const L_cont& loci, const std::string& pheno_name, const std::string& sep) const{
 	FILE* tmpf = std::tmpfile();
@@ -68,6 +68,8 @@ void Main::RunCommands() {
 		app.LoadGroupDataByName(c_custom_groups);
 	}
 
+	app.writeKnowledgeSnapshot();
+
 	app.InitBins();
 
 	if (WriteLociData){
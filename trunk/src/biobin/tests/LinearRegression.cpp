@@ -10,10 +10,13 @@
 #include "detail/MatrixUtils.h"
 
 #include <limits>
+#include <iostream>
+#include <cmath>
 
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_cdf.h>
 #include <gsl/gsl_blas.h>
+#include <gsl/gsl_linalg.h>
 #include <gsl/gsl_permute_vector.h>
 #include <gsl/gsl_errno.h>
 
@@ -29,32 +32,125 @@ namespace Test {
 
 string LinearRegression::testname = LinearRegression::doRegister("linear");
 
+LinearRegression::~LinearRegression(){
+	if(_qr){
+		gsl_matrix_free(_qr);
+	}
+	if(_qr_tau){
+		gsl_vector_free(_qr_tau);
+	}
+	if(_qty){
+		gsl_vector_free(_qty);
+	}
+}
+
+void LinearRegression::init(){
+	regressionSetup(*_pop_mgr_ptr, *_pheno_ptr);
+
+	if(_willfail){
+		return;
+	}
+
+	int errcode = GSL_SUCCESS;
+
+	// the covariates, without the bin column (colinear columns are already
+	// dropped by the null model)
+	gsl_matrix_const_view X_v = gsl_matrix_const_submatrix(_data, 0, 0, _data->size1, _data->size2 - 1);
+
+	_qr = gsl_matrix_alloc(X_v.matrix.size1, X_v.matrix.size2);
+	_qr_tau = gsl_vector_alloc(X_v.matrix.size2);
+	_qty = gsl_vector_alloc(_phenos->size);
+	errcode |= gsl_matrix_memcpy(_qr, &X_v.matrix);
+	errcode |= gsl_vector_memcpy(_qty, _phenos);
+
+	if(errcode == GSL_SUCCESS){
+		errcode |= gsl_linalg_QR_decomp(_qr, _qr_tau);
+	}
+	if(errcode == GSL_SUCCESS){
+		errcode |= gsl_linalg_QR_QTvec(_qr, _qr_tau, _qty);
+		_colinear.setup(*_qr);
+	}
+
+	if(errcode != GSL_SUCCESS){
+		std::cerr << "WARNING: Could not factor the covariates; "
+				<< "linear regression will fail" << std::endl;
+		_willfail = true;
+	}
+}
+
 double LinearRegression::runTest(const Bin& bin, double *accuracy) const{
+	vector<const Bin*> bins(1, &bin);
+	vector<double> pvals, accs;
+	runTestBlock(bins, pvals, accs);
+	accuracy[0] = accs[0];
+	return pvals[0];
+}
+
+void LinearRegression::runTestBlock(const vector<const Bin*>& bins,
+		vector<double>& pvals_out, vector<double>& accs_out) const{
+
+	accs_out.assign(bins.size(), 0); // TODO
+	pvals_out.assign(bins.size(), 1);
 
 	if (_willfail) {
-		return 1;
+		return;
 	}
 
-	for(unsigned int i=0; i<_samp_name.size(); i++){
-		gsl_matrix_set(_data, i, _data->size2 - 1,
-				_pop_mgr_ptr->getTotalIndivContrib(bin, _samp_name[i].second, *_pheno_ptr));
+	gsl_matrix* G = gsl_matrix_alloc(_samp_name.size(), bins.size());
+	getBinMatrix(*_contrib_ptr, bins, G);
+
+	int errcode = GSL_SUCCESS;
+
+	// G = Q'G; as Q is orthogonal, the rows past the first n_cov are the
+	// coordinates of the part of each bin not explained by the covariates
+	// (and likewise for Y), so the bin's coefficient in the full model is
+	// that of a regression of the Y residuals on the bin residuals
+	unsigned int n_cov = _qr->size2;
+	errcode |= gsl_linalg_QR_QTmat(_qr, _qr_tau, G);
+
+	vector<double> ee(G->size2, 0);
+	vector<double> ey(G->size2, 0);
+	for(unsigned int i=n_cov; i<G->size1; i++){
+		double y_i = gsl_vector_get(_qty, i);
+		for(unsigned int j=0; j<G->size2; j++){
+			double e_ij = gsl_matrix_get(G, i, j);
+			ee[j] += e_ij * e_ij;
+			ey[j] += e_ij * y_i;
+		}
 	}
 
-	// run the model now
-	Result* r = calculate(*_phenos, *_data);
+	double yy;
+	gsl_vector_const_view y_v = gsl_vector_const_subvector(_qty, n_cov, _qty->size - n_cov);
+	errcode |= gsl_blas_ddot(&y_v.vector, &y_v.vector, &yy);
+
+	// The full model [X g] = Q [R q; 0 e]; see ColinearUpdate
+	vector<bool> colinear(bins.size(), false);
+	for(unsigned int j=0; errcode == GSL_SUCCESS && j<bins.size(); j++){
+		gsl_vector_const_view q_v = gsl_matrix_const_subcolumn(G, j, 0, n_cov);
+		bool is_colinear;
+		errcode |= _colinear.isColinear(q_v.vector, ee[j], is_colinear);
+		colinear[j] = is_colinear;
+	}
 
-	accuracy[0] = 0; // TODO
-	double pval = 1;
-	if(r && r->_conv){
-	// Get the p-value of the last term
-		double se = sqrt(gsl_matrix_get(r->cov, r->cov->size1 - 1, r->cov->size2 - 1));
-		double c = gsl_vector_get(r->beta, r->beta->size - 1);
-		pval = 2*gsl_cdf_tdist_Q(fabs(c / se),_data->size1 - _data->size2 + 1);
+	gsl_matrix_free(G);
 
-		delete r;
+	if(errcode != GSL_SUCCESS){
+		return;
 	}
 
-	return pval;
+	for(unsigned int j=0; j<bins.size(); j++){
+		if(colinear[j]){
+			// The bin is (numerically) a combination of the covariates, so
+			// the full model drops it as colinear and it has no coefficient
+			pvals_out[j] = std::numeric_limits<double>::quiet_NaN();
+		} else {
+			double c = ey[j] / ee[j];
+			// chisq / dof of the full model, as in gsl_multifit_linear
+			double s2 = (yy - ey[j] * c) / (_data->size1 - _data->size2);
+			double se = sqrt(s2 / ee[j]);
+			pvals_out[j] = 2*gsl_cdf_tdist_Q(fabs(c / se),_data->size1 - _data->size2 + 1);
+		}
+	}
 }
 
 float LinearRegression::getPhenotype(const PopulationManager& pop_mgr,
@@ -10,6 +10,7 @@
 
 #include "Test.h"
 #include "detail/Regression.h"
+#include "detail/MatrixUtils.h"
 
 namespace BioBin {
 
@@ -19,14 +20,17 @@ class LinearRegression : public TestImpl<LinearRegression>, public Regression {
 //TODO:SKAT	friend class SKATLinear;
 
 public:
-	LinearRegression() : TestImpl<LinearRegression>(testname), Regression() {}
-	virtual ~LinearRegression() {}
+	LinearRegression() : TestImpl<LinearRegression>(testname), Regression(),
+		_qr(0), _qr_tau(0), _qty(0) {}
+	virtual ~LinearRegression();
 
 //	virtual Test* clone() const {return new LinearRegression();}
 
 //protected:
-	virtual void init(){regressionSetup(*_pop_mgr_ptr, *_pheno_ptr);}
+	virtual void init();
 	virtual double runTest(const Bin& bin, double *accuracy) const;
+	virtual void runTestBlock(const std::vector<const Bin*>& bins,
+			std::vector<double>& pvals_out, std::vector<double>& accs_out) const;
 
 	virtual Regression::Result* calculate(const gsl_vector& Y, const gsl_matrix& X) const;
 	virtual float getPhenotype(const PopulationManager& pop_mgr,
@@ -35,6 +39,18 @@ public:
 private:
 	static std::string testname;
 
+	/*
+	 * The QR decomposition of the covariates (the null model's X), computed
+	 * once in init.  Only the bin column changes from bin to bin, so each bin
+	 * is fit by residualizing it against Q rather than refitting everything.
+	 */
+	gsl_matrix* _qr;
+	gsl_vector* _qr_tau;
+	//! Q'Y
+	gsl_vector* _qty;
+	//! Checks each bin for colinearity with the covariates, from R
+	mutable ColinearUpdate _colinear;
+
 };
 
 }
@@ -0,0 +1,78 @@
+/*
+ * LinearScore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "LinearScore.h"
+
+#include <iostream>
+#include <vector>
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+using std::string;
+using std::vector;
+
+namespace BioBin {
+namespace Test {
+
+string LinearScore::testname = LinearScore::doRegister("linear-score");
+
+void LinearScore::init(){
+	_base_reg.setup(*_pop_mgr_ptr, *_pheno_ptr);
+
+	if(_base_reg._willfail){
+		std::cerr << "WARNING: Base linear regression will fail, so will the linear score test." << std::endl;
+		_willfail = true;
+		return;
+	}
+
+	int errcode = GSL_SUCCESS;
+
+	gsl_matrix_const_view X_v = gsl_matrix_const_submatrix(_base_reg._data, 0,0,
+			_base_reg._data->size1, _base_reg._data->size2-1);
+
+	// the residual variance of the null model
+	const gsl_vector* resid = _base_reg._null_result->resid;
+	double rss;
+	errcode |= gsl_blas_ddot(resid, resid, &rss);
+	double sigma_sq = rss / (X_v.matrix.size1 - X_v.matrix.size2);
+
+	if(errcode == GSL_SUCCESS){
+		errcode |= _score.setup(X_v.matrix, *resid, 0, sigma_sq);
+	}
+
+	if(errcode != GSL_SUCCESS){
+		std::cerr << "WARNING: Could not factor the null linear model; "
+				<< "linear score test will fail" << std::endl;
+		_willfail = true;
+	}
+}
+
+double LinearScore::runTest(const Bin& bin, double *accuracy) const{
+	vector<const Bin*> bins(1, &bin);
+	vector<double> pvals, accs;
+	runTestBlock(bins, pvals, accs);
+	accuracy[0] = accs[0];
+	return pvals[0];
+}
+
+void LinearScore::runTestBlock(const vector<const Bin*>& bins,
+		vector<double>& pvals_out, vector<double>& accs_out) const{
+	accs_out.assign(bins.size(), 0); // TODO
+	if(_willfail){
+		pvals_out.assign(bins.size(), 1);
+		return;
+	}
+
+	gsl_matrix* G = gsl_matrix_alloc(_base_reg._samp_name.size(), bins.size());
+	_base_reg.getBinMatrix(*_contrib_ptr, bins, G);
+	_score.pvalues(*G, pvals_out);
+	gsl_matrix_free(G);
+}
+
+}
+
+}
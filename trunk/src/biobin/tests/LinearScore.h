@@ -0,0 +1,51 @@
+/*
+ * LinearScore.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_TEST_LINEARSCORE_H
+#define BIOBIN_TEST_LINEARSCORE_H
+
+#include "Test.h"
+#include "LinearRegression.h"
+#include "detail/ScoreTest.h"
+
+namespace BioBin {
+
+namespace Test {
+
+/*!
+ * \brief The score test of the bin in the linear regression model.
+ * Only the null model (covariates alone) is fit, once per phenotype; each
+ * bin is then tested against it without refitting, see ScoreTest.
+ */
+class LinearScore : public TestImpl<LinearScore> {
+public:
+	LinearScore() : TestImpl<LinearScore>(testname), _willfail(false) {}
+
+	virtual ~LinearScore() {}
+
+protected:
+	virtual void init();
+	virtual double runTest(const Bin& bin, double *accuracy) const;
+	virtual void runTestBlock(const std::vector<const Bin*>& bins,
+			std::vector<double>& pvals_out, std::vector<double>& accs_out) const;
+
+private:
+
+	static std::string testname;
+
+	LinearRegression _base_reg;
+
+	ScoreTest _score;
+
+	bool _willfail;
+
+};
+
+}
+
+}
+
+#endif /* BIOBIN_TEST_LINEARSCORE_H */
@@ -10,17 +10,20 @@
 #include <iostream>
 #include <limits>
 #include <cmath>
+#include <algorithm>
 
 #include <gsl/gsl_cdf.h>
 #include <gsl/gsl_blas.h>
 #include <gsl/gsl_multifit.h>
 #include <gsl/gsl_permute_vector.h>
 #include <gsl/gsl_errno.h>
+#include <gsl/gsl_linalg.h>
 
 #include "detail/MatrixUtils.h"
 
 using std::numeric_limits;
 using std::string;
+using std::vector;
 
 using boost::array;
 
@@ -32,6 +35,58 @@ namespace Test {
 
 string LogisticRegression::testname = LogisticRegression::doRegister("logistic");
 
+LogisticRegression::~LogisticRegression(){
+	if(_beta_null){
+		gsl_vector_free(_beta_null);
+	}
+	if(_bin_ws){
+		delete _bin_ws;
+	}
+}
+
+LogisticRegression::Workspace::Workspace(unsigned int n, unsigned int p){
+	weight = gsl_vector_calloc(n);
+	rhs = gsl_vector_alloc(n);
+	b_prev = gsl_vector_alloc(p);
+	fit_ws = gsl_multifit_linear_alloc(n, p);
+}
+
+LogisticRegression::Workspace::~Workspace(){
+	gsl_vector_free(weight);
+	gsl_vector_free(rhs);
+	gsl_vector_free(b_prev);
+	gsl_multifit_linear_free(fit_ws);
+}
+
+LogisticRegression::BinWorkspace::BinWorkspace(const gsl_matrix& data) :
+		irls(data.size1, data.size2) {
+	unsigned int n = data.size1;
+	unsigned int k = data.size2 - 1;
+
+	X = gsl_matrix_alloc(n, k + 1);
+	gsl_matrix_memcpy(X, &data);
+
+	qr = gsl_matrix_alloc(n, k);
+	qr_tau = gsl_vector_alloc(k);
+	gsl_matrix_const_view cov_v = gsl_matrix_const_submatrix(X, 0, 0, n, k);
+	gsl_matrix_memcpy(qr, &cov_v.matrix);
+	gsl_linalg_QR_decomp(qr, qr_tau);
+	colinear.setup(*qr);
+
+	g_qt = gsl_vector_alloc(n);
+	beta = gsl_vector_alloc(k + 1);
+	cov = gsl_matrix_alloc(k + 1, k + 1);
+}
+
+LogisticRegression::BinWorkspace::~BinWorkspace(){
+	gsl_matrix_free(X);
+	gsl_matrix_free(qr);
+	gsl_vector_free(qr_tau);
+	gsl_vector_free(g_qt);
+	gsl_vector_free(beta);
+	gsl_matrix_free(cov);
+}
+
 void LogisticRegression::init(){
 	if(_pheno_ptr->getStatus().first.count() == 0 ||
 			_pheno_ptr->getStatus().second.count() == 0){
@@ -46,6 +101,17 @@ void LogisticRegression::init(){
 			_willfail = true;
 		}
 	}
+
+	if(_willfail){
+		return;
+	}
+
+	// regressionSetup has dropped the colinear covariates from both _data and
+	// the null model, so every bin is fit starting from the null model, with
+	// 0 for the bin
+	_beta_null = gsl_vector_alloc(_null_result->beta->size);
+	gsl_vector_memcpy(_beta_null, _null_result->beta);
+	_dev_intercept = getInterceptDeviance(*_phenos);
 }
 
 double LogisticRegression::runTest(const Bin& bin, double *accuracy) const {
@@ -54,26 +120,56 @@ double LogisticRegression::runTest(const Bin& bin, double *accuracy) const {
 		return 1;
 	}
 
-	for(unsigned int i=0; i<_samp_name.size(); i++){
-		gsl_matrix_set(_data, i, _data->size2 - 1,
-				_pop_mgr_ptr->getTotalIndivContrib(bin, _samp_name[i].second, *_pheno_ptr));
+	if(!_bin_ws){
+		_bin_ws = new BinWorkspace(*_data);
+	}
+	BinWorkspace& ws = *_bin_ws;
+	unsigned int k = _data->size2 - 1;
+
+	// Only the carriers contribute to the bin
+	gsl_vector_view g = gsl_matrix_column(ws.X, k);
+	gsl_vector_set_zero(&g.vector);
+	_contrib_ptr->getNonzeroContribs(bin, ws.samples, ws.contribs);
+	for(unsigned int i=0; i<ws.samples.size(); i++){
+		int row = _samp_row[ws.samples[i]];
+		if(row >= 0){
+			gsl_vector_set(&g.vector, row, ws.contribs[i]);
+		}
 	}
 
-	// run the model now
-	Regression::Result* r = calculate(*_phenos, *_data);
-
-	// Get the p-value of the last term
-
-	double pval = 1;
 	accuracy[0] = 0; // TODO
-	if(r){
-		double se = sqrt(gsl_matrix_get(r->cov, r->cov->size1 - 1, r->cov->size2 - 1));
-		double c = gsl_vector_get(r->beta, r->beta->size - 1);
-		pval = 2*gsl_cdf_tdist_Q(fabs(c / se),_data->size1 - _data->size2 + 1);
-		delete r;
+	int errcode = GSL_SUCCESS;
+
+	// A bin that is a combination of the covariates is dropped from the
+	// model as colinear, leaving no coefficient to test.  This is the same
+	// check as in LinearRegression, so both tests drop the same bins.
+	double e_sq;
+	bool is_colinear;
+	errcode |= gsl_vector_memcpy(ws.g_qt, &g.vector);
+	errcode |= gsl_linalg_QR_QTvec(ws.qr, ws.qr_tau, ws.g_qt);
+	gsl_vector_const_view q_v = gsl_vector_const_subvector(ws.g_qt, 0, k);
+	gsl_vector_const_view e_v = gsl_vector_const_subvector(ws.g_qt, k, ws.g_qt->size - k);
+	errcode |= gsl_blas_ddot(&e_v.vector, &e_v.vector, &e_sq);
+	errcode |= ws.colinear.isColinear(q_v.vector, e_sq, is_colinear);
+	if(errcode != GSL_SUCCESS){
+		return 1;
+	}
+	if(is_colinear){
+		return std::numeric_limits<double>::quiet_NaN();
 	}
 
-	return pval;
+	// run the model now, starting from the null model
+	gsl_vector_view b0 = gsl_vector_subvector(ws.beta, 0, k);
+	gsl_vector_memcpy(&b0.vector, _beta_null);
+	gsl_vector_set(ws.beta, k, 0);
+	double chisq;
+	bool conv;
+	runIRLS(*_phenos, *ws.X, _dev_intercept, ws.beta, ws.cov, ws.irls, chisq, conv);
+
+	// Get the p-value of the last term
+	double se = sqrt(gsl_matrix_get(ws.cov, k, k));
+	double c = gsl_vector_get(ws.beta, k);
+	return 2*gsl_cdf_tdist_Q(fabs(c / se),_data->size1 - _data->size2 + 1);
 
 }
 
@@ -98,17 +194,8 @@ float LogisticRegression::getPhenotype(const PopulationManager& pop_mgr,
 
 Regression::Result* LogisticRegression::calculate(const gsl_vector& Y, const gsl_matrix& X) const {
 
-	static const unsigned int maxIterations = 30;
-
 	int errcode = GSL_SUCCESS;
 
-	// val is the value of the logit function
-	// deriv is the derivative of the logit
-	// log_val and log_val_c are log(val) and log(1-val), respectively.
-	// NOTE: the reason we do them here is to prevent underflow; for large values
-	// of the exponent, we need to use approximations for log_val and log_val_c
-	//double val, deriv, log_val, log_val_c;
-
 	// This is the current estimate of the parameters
 	// Note: position 0 is reserved for the intercept
 
@@ -146,8 +233,6 @@ Regression::Result* LogisticRegression::calculate(const gsl_vector& Y, const gsl
 		}
 	}
 
-	gsl_vector* weight = gsl_vector_calloc(Y.size);
-	//gsl_matrix* P = gsl_matrix_alloc(X.size2,X.size2);
 	// First, let's check for colinearity!
 	gsl_permutation* permu = gsl_permutation_alloc(X.size2);
 	unsigned int n_drop = MatrixUtils::checkColinear(&X, permu);
@@ -159,17 +244,14 @@ Regression::Result* LogisticRegression::calculate(const gsl_vector& Y, const gsl
 
 	unsigned int n_indep = X.size2 - n_drop;
 
-	// Right-hand side of the IRLS equation.  Defined to be X*w_t + S_t^-1*(y-mu_t)
-	// Or, in our parlance: rhs_i = (X*beta_t)_i + 1/deriv * (y_i - val)
-	gsl_vector* rhs = gsl_vector_alloc(Y.size);
+	// The colinear columns are the last n_drop of the permutation; report
+	// them (smallest first), so regressionSetup drops them from the model
+	r->dropped_cols.assign(permu->data + n_indep, permu->data + X.size2);
+	std::sort(r->dropped_cols.begin(), r->dropped_cols.end());
 
-	// I need these to work with the default values
-	gsl_multifit_linear_workspace *ws = gsl_multifit_linear_alloc(Y.size, n_indep);
-	//gsl_matrix_set_all(cov_mat, -1);
+	Workspace ws(Y.size, n_indep);
 	gsl_matrix_view cov_view = gsl_matrix_submatrix(r->cov, 0, 0, n_indep, n_indep);
-	gsl_matrix* cov = &cov_view.matrix;
 	gsl_matrix* A = gsl_matrix_calloc(Y.size, X.size2);
-	double tmp_chisq;
 
 	// Let's permute the columns of A
 	errcode |= gsl_matrix_memcpy(A, &X);
@@ -178,22 +260,82 @@ Regression::Result* LogisticRegression::calculate(const gsl_vector& Y, const gsl
 		errcode |= MatrixUtils::applyPermutation(A, permu);
 	}
 
-	// this is the previous beta vector, for checking convergence
-	gsl_vector* b_prev = gsl_vector_alloc(n_indep);
-	// make this b_prev nonzero to begin
-	gsl_vector_set_all(b_prev, 1.0);
 	gsl_vector_view b = gsl_vector_subvector(r->beta, 0, n_indep);
 	gsl_matrix_const_view X_v = gsl_matrix_const_submatrix(A, 0, 0, Y.size, n_indep);
 
-	double LLp = std::numeric_limits<double>::infinity(); // stores previous value of LL to check for convergence
-	double LLn, LL = 0;
+	double tmp_chisq = 0;
+	bool conv = false;
+	if(errcode == GSL_SUCCESS){
+		errcode |= runIRLS(Y, X_v.matrix, getInterceptDeviance(Y), &b.vector,
+				&cov_view.matrix, ws, tmp_chisq, conv);
+	}
+
+	// set the residuals here
+	r->resid = gsl_vector_alloc(X_v.matrix.size1);
 
-	LLn = 0;
+	if (errcode == GSL_SUCCESS) {
+		// Let's get the value of the exponent for every person
+		// (we can re-use the rhs vector since we're done with it!)
+		errcode |= gsl_blas_dgemv(CblasNoTrans, 1, &X_v.matrix, &b.vector, 0, ws.rhs);
+		for (unsigned int i = 0; i < Y.size; i++) {
 
-	for(unsigned int i=0; i<Y.size; i++){
-		LLn -= 2 *(gsl_vector_get(&Y, i) * null_v[2] + (1-gsl_vector_get(&Y, i)) * null_v[3]);
+			// calculate the value of the exponent for the individual
+			double v = gsl_vector_get(ws.rhs, i);
+
+			// At this point, v is the value of the exponent
+			array<double, 4> v_arr = linkFunction(v);
+
+			// and the residual is Y[i] - predicted_val[i], or Y[i] - v_arr[0]
+			gsl_vector_set(r->resid, i, gsl_vector_get(&Y, i) - v_arr[0]);
+		}
+	}
+
+	// OK, now time to unpermute everything!
+	// Note: to unpermute, multiply by P transpose!
+	// Also, we need to unpermute both the rows AND columns of cov_mat
+	// permute columns
+
+	if(errcode == GSL_SUCCESS){
+		MatrixUtils::applyInversePermutation(r->cov, permu, true);
+		// permute rows
+		MatrixUtils::applyInversePermutation(r->cov, permu, false);
+		errcode |= gsl_permute_vector_inverse(permu, r->beta);
 	}
 
+	if(errcode != GSL_SUCCESS || !conv){
+		r->_conv = false;
+	}
+
+	r->chisq = tmp_chisq;
+
+	gsl_matrix_free(A);
+	gsl_permutation_free(permu);
+
+	return r;
+}
+
+int LogisticRegression::runIRLS(const gsl_vector& Y, const gsl_matrix& X, double LLn,
+		gsl_vector* b, gsl_matrix* cov, Workspace& ws,
+		double& chisq_out, bool& conv_out){
+
+	static const unsigned int maxIterations = 30;
+
+	int errcode = GSL_SUCCESS;
+	unsigned int n_indep = X.size2;
+
+	// Right-hand side of the IRLS equation.  Defined to be X*w_t + S_t^-1*(y-mu_t)
+	// Or, in our parlance: rhs_i = (X*beta_t)_i + 1/deriv * (y_i - val)
+	gsl_vector* rhs = ws.rhs;
+	gsl_vector* weight = ws.weight;
+
+	// this is the previous beta vector, for checking convergence
+	gsl_vector* b_prev = ws.b_prev;
+	// make this b_prev nonzero to begin
+	gsl_vector_set_all(b_prev, 1.0);
+
+	double LLp = std::numeric_limits<double>::infinity(); // stores previous value of LL to check for convergence
+	double LL = 0;
+
 	unsigned int numIterations = 0;
 
 	// set the tolerances in single precision, but do work in double precision!
@@ -207,15 +349,15 @@ Regression::Result* LogisticRegression::calculate(const gsl_vector& Y, const gsl
 	// 2) divergence of one (or more) coefficients
 	// 3) maximum number of iterations
 	while (errcode == GSL_SUCCESS &&
-		  (fabs(LLp - LL) > TOL*LLn || gsl_blas_dasum(b_prev) > TOL*n_indep*gsl_blas_dasum(&b.vector)) &&
-		   gsl_blas_dasum(&b.vector) < MAX_vec &&
+		  (fabs(LLp - LL) > TOL*LLn || gsl_blas_dasum(b_prev) > TOL*n_indep*gsl_blas_dasum(b)) &&
+		   gsl_blas_dasum(b) < MAX_vec &&
 		   ++numIterations < maxIterations ) {
 
 		// save the old beta vector in b_prev
-		errcode |= gsl_vector_memcpy(b_prev, &b.vector);
+		errcode |= gsl_vector_memcpy(b_prev, b);
 
 		// First, let's initialize the RHS to X*beta_t (rhs = 1 * X * b + 0* rhs)
-		errcode |= gsl_blas_dgemv(CblasNoTrans, 1, &X_v.matrix, &b.vector, 0, rhs);
+		errcode |= gsl_blas_dgemv(CblasNoTrans, 1, &X, b, 0, rhs);
 
 		LLp = LL;
 		LL = 0;
@@ -234,86 +376,51 @@ Regression::Result* LogisticRegression::calculate(const gsl_vector& Y, const gsl
 			LL -= 2 *(gsl_vector_get(&Y, i) * v_arr[2] + (1-gsl_vector_get(&Y, i)) * v_arr[3]);
 
 			// get the weight and update the rhs for IRLS
-			//weight[i] = v_arr[1];
 			gsl_vector_set(weight, i, v_arr[1] );
 			gsl_vector_set(rhs, i, v + 1/v_arr[1] * (gsl_vector_get(&Y, i) - v_arr[0]));
 
 		}
 
 		// Look, magic!
-		errcode |= gsl_multifit_wlinear(&X_v.matrix, weight, rhs, &b.vector, cov, &tmp_chisq, ws);
+		errcode |= gsl_multifit_wlinear(&X, weight, rhs, b, cov, &chisq_out, ws.fit_ws);
 
 		// check for NaNs here
-		if(std::isfinite(gsl_blas_dasum(&b.vector))){
+		if(std::isfinite(gsl_blas_dasum(b))){
 			// get the difference between the old beta and the new beta
-			errcode |= gsl_vector_sub(b_prev, &b.vector);
+			errcode |= gsl_vector_sub(b_prev, b);
 		} else {
 			// terminate the iteration, giving us the previous beta
-			errcode |= gsl_vector_memcpy(&b.vector, b_prev);
+			errcode |= gsl_vector_memcpy(b, b_prev);
 			// and set the "difference" to 0
 			gsl_vector_set_zero(b_prev);
 			// set loglikelihood to NaN
 			LL = std::numeric_limits<double>::quiet_NaN();
 		}
 
-		LL += 0;
-
 	} // complete iteration
 
-
-	// set the residuals here
-	r->resid = gsl_vector_alloc(X_v.matrix.size1);
-
-	if (errcode == GSL_SUCCESS) {
-		// Let's get the value of the exponent for every person
-		// (we can re-use the rhs vector since we're done with it!)
-		errcode |= gsl_blas_dgemv(CblasNoTrans, 1, &X_v.matrix, &b.vector, 0, rhs);
-		for (unsigned int i = 0; i < Y.size; i++) {
-
-			// calculate the value of the exponent for the individual
-			double v = gsl_vector_get(rhs, i);
-
-			// At this point, v is the value of the exponent
-			array<double, 4> v_arr = linkFunction(v);
-
-			// and the residual is Y[i] - predicted_val[i], or Y[i] - v_arr[0]
-			gsl_vector_set(r->resid, i, gsl_vector_get(&Y, i) - v_arr[0]);
-		}
-	}
-
-	// OK, now time to unpermute everything!
-	// Note: to unpermute, multiply by P transpose!
-	// Also, we need to unpermute both the rows AND columns of cov_mat
-	// permute columns
-
-	if(errcode == GSL_SUCCESS){
-		MatrixUtils::applyInversePermutation(r->cov, permu, true);
-		// permute rows
-		MatrixUtils::applyInversePermutation(r->cov, permu, false);
-		errcode |= gsl_permute_vector_inverse(permu, r->beta);
-	}
-
 	// nonconvergence happens if:
 	// -Log likelihood is not finite (inf or NaN)
 	// too many iteratons
 	// The current log likelihood is less than the null model
-	if(errcode != GSL_SUCCESS ||
+	conv_out = !(errcode != GSL_SUCCESS ||
 	   !std::isfinite(LL) ||
 	   numIterations >= maxIterations ||
-	   LL-LLn > 0 ){
-		r->_conv = false;
-	}
+	   LL-LLn > 0);
 
-	r->chisq = tmp_chisq;
+	return errcode;
+}
 
-	gsl_vector_free(weight);
-	gsl_vector_free(b_prev);
-	gsl_vector_free(rhs);
-	gsl_multifit_linear_free(ws);
-	gsl_matrix_free(A);
-	gsl_permutation_free(permu);
+double LogisticRegression::getInterceptDeviance(const gsl_vector& Y){
+	// the intercept-only model predicts the fraction of cases for everyone
+	double sum_Y = gsl_blas_dasum(&Y);
+	array<double, 4> null_v = linkFunction(log(sum_Y / (Y.size - sum_Y)));
 
-	return r;
+	double LLn = 0;
+	for(unsigned int i=0; i<Y.size; i++){
+		LLn -= 2 *(gsl_vector_get(&Y, i) * null_v[2] + (1-gsl_vector_get(&Y, i)) * null_v[3]);
+	}
+	return LLn;
 }
 
 array<double, 4> LogisticRegression::linkFunction(double v){
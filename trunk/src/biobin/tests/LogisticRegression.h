@@ -10,9 +10,14 @@
 
 #include "Test.h"
 #include "detail/Regression.h"
+#include "detail/MatrixUtils.h"
+
+#include <vector>
 
 #include <boost/array.hpp>
 
+#include <gsl/gsl_multifit.h>
+
 namespace BioBin {
 
 namespace Test {
@@ -21,10 +26,11 @@ class LogisticRegression : public TestImpl<LogisticRegression> , public Regressi
 public:
 //TODO:SKAT	friend class SKATLogistic;
 
-	LogisticRegression() : TestImpl<LogisticRegression>(testname), Regression(){
+	LogisticRegression() : TestImpl<LogisticRegression>(testname), Regression(),
+		_beta_null(0), _dev_intercept(0), _bin_ws(0) {
 	}
 
-	virtual ~LogisticRegression() {}
+	virtual ~LogisticRegression();
 
 	//virtual Test* clone() const { return new LogisticRegression();}
 
@@ -40,10 +46,74 @@ protected:
 			const Utility::Phenotype& pheno, const std::string& samp) const;
 
 private:
+	//! Working space for IRLS on an n x p design
+	struct Workspace{
+		Workspace(unsigned int n, unsigned int p);
+		~Workspace();
+
+		gsl_vector* weight;
+		gsl_vector* rhs;
+		gsl_vector* b_prev;
+		gsl_multifit_linear_workspace* fit_ws;
+
+	private:
+		// No copying or assignment!
+		Workspace(const Workspace&);
+		Workspace& operator=(const Workspace&);
+	};
+
+	/*
+	 * Everything needed to fit the model of a bin, built on the first bin
+	 * and reused for every bin after, so fitting a bin allocates nothing.
+	 * Each thread has its own clone of the test, and so its own workspace.
+	 */
+	struct BinWorkspace{
+		BinWorkspace(const gsl_matrix& data);
+		~BinWorkspace();
+
+		//! The covariates, then the bin
+		gsl_matrix* X;
+		//! QR decomposition of the covariates, to check the bin for colinearity
+		gsl_matrix* qr;
+		gsl_vector* qr_tau;
+		gsl_vector* g_qt;
+		ColinearUpdate colinear;
+		gsl_vector* beta;
+		gsl_matrix* cov;
+		Workspace irls;
+		std::vector<unsigned int> samples;
+		std::vector<float> contribs;
+
+	private:
+		// No copying or assignment!
+		BinWorkspace(const BinWorkspace&);
+		BinWorkspace& operator=(const BinWorkspace&);
+	};
+
+	/*!
+	 * \brief Runs IRLS for Y ~ X, starting from (and updating) b and filling
+	 * cov with its covariance.  X must not have colinear columns.
+	 *
+	 * \param LLn The deviance of the intercept-only model
+	 * \param conv_out Set to true if the fit converged
+	 * \return a GSL error code
+	 */
+	static int runIRLS(const gsl_vector& Y, const gsl_matrix& X, double LLn,
+			gsl_vector* b, gsl_matrix* cov, Workspace& ws,
+			double& chisq_out, bool& conv_out);
+
+	static double getInterceptDeviance(const gsl_vector& Y);
+
 	static std::string testname;
 
 	static boost::array<double, 4> linkFunction(double v);
 
+	//! The null model coefficients, the start of every fit
+	gsl_vector* _beta_null;
+	double _dev_intercept;
+
+	mutable BinWorkspace* _bin_ws;
+
 };
 
 }
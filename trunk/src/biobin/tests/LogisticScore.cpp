@@ -0,0 +1,83 @@
+/*
+ * LogisticScore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "LogisticScore.h"
+
+#include <iostream>
+#include <vector>
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_errno.h>
+
+using std::string;
+using std::vector;
+
+namespace BioBin {
+namespace Test {
+
+string LogisticScore::testname = LogisticScore::doRegister("logistic-score");
+
+void LogisticScore::init(){
+	_base_reg.setup(*_pop_mgr_ptr, *_pheno_ptr);
+
+	if(_base_reg._willfail){
+		std::cerr << "WARNING: Base logistic regression will fail, so will the logistic score test." << std::endl;
+		_willfail = true;
+		return;
+	}
+
+	int errcode = GSL_SUCCESS;
+
+	gsl_matrix_const_view X_v = gsl_matrix_const_submatrix(_base_reg._data, 0,0,
+			_base_reg._data->size1, _base_reg._data->size2-1);
+
+	// The weights are val * (1-val), where val = Y - resid is the predicted
+	// value of the null model
+	gsl_vector* wt = gsl_vector_alloc(_base_reg._phenos->size);
+	errcode |= gsl_vector_memcpy(wt, _base_reg._phenos);
+	errcode |= gsl_blas_daxpy(-1, _base_reg._null_result->resid, wt);
+	for(unsigned int i=0; i<wt->size; i++){
+		double val = gsl_vector_get(wt, i);
+		gsl_vector_set(wt, i, val*(1-val));
+	}
+
+	if(errcode == GSL_SUCCESS){
+		errcode |= _score.setup(X_v.matrix, *_base_reg._null_result->resid, wt, 1);
+	}
+
+	gsl_vector_free(wt);
+
+	if(errcode != GSL_SUCCESS){
+		std::cerr << "WARNING: Could not factor the null logistic model; "
+				<< "logistic score test will fail" << std::endl;
+		_willfail = true;
+	}
+}
+
+double LogisticScore::runTest(const Bin& bin, double *accuracy) const{
+	vector<const Bin*> bins(1, &bin);
+	vector<double> pvals, accs;
+	runTestBlock(bins, pvals, accs);
+	accuracy[0] = accs[0];
+	return pvals[0];
+}
+
+void LogisticScore::runTestBlock(const vector<const Bin*>& bins,
+		vector<double>& pvals_out, vector<double>& accs_out) const{
+	accs_out.assign(bins.size(), 0); // TODO
+	if(_willfail){
+		pvals_out.assign(bins.size(), 1);
+		return;
+	}
+
+	gsl_matrix* G = gsl_matrix_alloc(_base_reg._samp_name.size(), bins.size());
+	_base_reg.getBinMatrix(*_contrib_ptr, bins, G);
+	_score.pvalues(*G, pvals_out);
+	gsl_matrix_free(G);
+}
+
+}
+}
@@ -0,0 +1,51 @@
+/*
+ * LogisticScore.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_TEST_LOGISTICSCORE_H
+#define BIOBIN_TEST_LOGISTICSCORE_H
+
+#include "Test.h"
+#include "LogisticRegression.h"
+#include "detail/ScoreTest.h"
+
+namespace BioBin {
+
+namespace Test {
+
+/*!
+ * \brief The score test of the bin in the logistic regression model.
+ * Only the null model (covariates alone) is fit, once per phenotype; each
+ * bin is then tested against it without refitting, see ScoreTest.
+ */
+class LogisticScore : public TestImpl<LogisticScore> {
+public:
+	LogisticScore() : TestImpl<LogisticScore>(testname), _willfail(false) {}
+
+	virtual ~LogisticScore() {}
+
+protected:
+	virtual void init();
+	virtual double runTest(const Bin& bin, double *accuracy) const;
+	virtual void runTestBlock(const std::vector<const Bin*>& bins,
+			std::vector<double>& pvals_out, std::vector<double>& accs_out) const;
+
+private:
+
+	static std::string testname;
+
+	LogisticRegression _base_reg;
+
+	ScoreTest _score;
+
+	bool _willfail;
+
+};
+
+}
+
+}
+
+#endif /* BIOBIN_TEST_LOGISTICSCORE_H */
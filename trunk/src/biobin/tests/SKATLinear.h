@@ -9,6 +9,7 @@
 #define BIOBIN_TEST_SKATLINEAR_H
 
 #include "Test.h"
+#include "detail/SKATWorkspace.h"
 #include "LinearRegression.h"
 
 #include <gsl/gsl_vector.h>
@@ -46,6 +47,9 @@ private:
 
 	bool _willfail;
 
+	// scratch space for each bin (each thread has its own clone)
+	mutable SKATWorkspace _ws;
+
 };
 
 }
@@ -115,77 +115,56 @@ double SKATLogistic::runTest(const Bin& bin, double *accuracy) const{
 
 	int errcode = GSL_SUCCESS;
 
+	// all of the space for this bin comes from the workspace
+	_ws.reset();
+
 	// first things first, let's set up the genotype matrix
 
-	gsl_matrix* GW;
+	gsl_matrix_view GW_v;
 
 	unsigned int n_snp = SKATUtils::getGenoWeights(*_pop_mgr_ptr, *_pheno_ptr, _base_reg._included,
-			bin, _base_reg._samp_name, GW);
+			bin, _base_reg._samp_name, _ws, GW_v);
 	if(n_snp == 0){
-		// clean up and return 1
-		// note: GW will come out unallocated!
+		// return 1
+		// note: GW_v will come out unset!
 		return 1;
 	}
+	gsl_matrix* GW = &GW_v.matrix;
 
 	// now, get the Q statistic, defined to be
 	// r*GKG*r, with K == Weights
 	// temporary vectors - we want to keep everyting BLAS lv. 2 at this point
-	gsl_vector* tmp_nsnp = gsl_vector_calloc(GW->size2);
+	gsl_vector_view tmp_nsnp = _ws.getVector(GW->size2);
 
 	// Now, tmp_nsnp = (GW)^T * resid
-	errcode |= gsl_blas_dgemv(CblasTrans, 1.0, GW, _base_reg._null_result->resid, 0, tmp_nsnp);
+	errcode |= gsl_blas_dgemv(CblasTrans, 1.0, GW, _base_reg._null_result->resid, 0, &tmp_nsnp.vector);
 
 	double Q;
 	// taking t(tmp_nsnp) %*% tmp_nsnp gives:
 	// resid^T * (GW) * (GW)^T * resid
-	errcode |= gsl_blas_ddot(tmp_nsnp, tmp_nsnp, &Q);
+	errcode |= gsl_blas_ddot(&tmp_nsnp.vector, &tmp_nsnp.vector, &Q);
 
 	// now divide by 2
 	// acutally, multiply by the inverse of the above for a hint of extra speed
 	Q *= 0.5;
 
-	// get rid of the temporary vectors
-	gsl_vector_free(tmp_nsnp);
-
 	// And now we get the matrix for calculating the p-value
 	gsl_matrix_const_view X_v = gsl_matrix_const_submatrix(_base_reg._data,
 			0,0,_base_reg._data->size1, _base_reg._data->size2 - 1);
 
 	// Now, calculate (GW) * (GW)^T - (GW)^T * X * (X^T * X)^(-1) * X^T * (GW)
-	gsl_matrix* tmp_ss = gsl_matrix_calloc(GW->size2, GW->size2);
-	if(tmp_ss == 0){
-		// out of memory
-		gsl_matrix_free(GW);
-		return 11;
-	}
-
-	gsl_matrix* tmp_vs = gsl_matrix_calloc(X_v.matrix.size2,GW->size2);
-	if(tmp_vs == 0){
-		// out of memory
-		gsl_matrix_free(tmp_ss);
-		gsl_matrix_free(GW);
-		return 12;
-	}
-	gsl_matrix* tmp_sv = gsl_matrix_calloc(GW->size2,X_v.matrix.size2);
-	if(tmp_sv == 0){
-		// out of memory
-		gsl_matrix_free(tmp_ss);
-		gsl_matrix_free(tmp_vs);
-		gsl_matrix_free(GW);
-		return 13;
-	}
+	// (each of these is completely overwritten below)
+	gsl_matrix_view tmp_ss_v = _ws.getMatrix(GW->size2, GW->size2);
+	gsl_matrix_view tmp_vs_v = _ws.getMatrix(X_v.matrix.size2,GW->size2);
+	gsl_matrix_view tmp_sv_v = _ws.getMatrix(GW->size2,X_v.matrix.size2);
+	gsl_matrix* tmp_ss = &tmp_ss_v.matrix;
+	gsl_matrix* tmp_vs = &tmp_vs_v.matrix;
+	gsl_matrix* tmp_sv = &tmp_sv_v.matrix;
 
 	// First, set Z = Z * pi_1 (or in our parlance GW_w = GW * _resid_wt)
 	// We do this by scaling each row appropriately
-	gsl_matrix* GW_w = gsl_matrix_alloc(GW->size1, GW->size2);
-	if(GW_w == 0){
-		// out of memory
-		gsl_matrix_free(tmp_sv);
-		gsl_matrix_free(tmp_ss);
-		gsl_matrix_free(tmp_vs);
-		gsl_matrix_free(GW);
-		return 14;
-	}
+	gsl_matrix_view GW_w_v = _ws.getMatrix(GW->size1, GW->size2);
+	gsl_matrix* GW_w = &GW_w_v.matrix;
 
 	errcode |= gsl_matrix_memcpy(GW_w, GW);
 	for(unsigned int i=0; i<GW->size1; i++){
@@ -215,21 +194,14 @@ double SKATLogistic::runTest(const Bin& bin, double *accuracy) const{
 	// now, tmp_ss = tmp_ss - tmp_sv * tmp_vs
 	errcode |= gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, -1, tmp_sv, tmp_vs, 1, tmp_ss);
 
-	gsl_matrix_free(tmp_sv);
-	gsl_matrix_free(tmp_vs);
-	gsl_matrix_free(GW);
-	gsl_matrix_free(GW_w);
-
 	double pval;
 	if(errcode == GSL_SUCCESS){
 		// get the p-value from tmp_ss and the Q statistic
-		pval = SKATUtils::getPvalue(Q, tmp_ss, accuracy);
+		pval = SKATUtils::getPvalue(Q, tmp_ss, accuracy, _ws);
 	} else {
 		pval = 10;
 	}
 
-	gsl_matrix_free(tmp_ss);
-
 	return pval;
 }
 
@@ -9,6 +9,7 @@
 #define BIOBIN_TEST_SKATLOGISTIC_H
 
 #include "Test.h"
+#include "detail/SKATWorkspace.h"
 #include "LogisticRegression.h"
 
 #include <gsl/gsl_matrix.h>
@@ -45,6 +46,9 @@ private:
 
 	bool _willfail;
 
+	// scratch space for each bin (each thread has its own clone)
+	mutable SKATWorkspace _ws;
+
 };
 
 }
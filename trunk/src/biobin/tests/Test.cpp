@@ -9,16 +9,284 @@
 #include "biobin/PopulationManager.h"
 #include "biobin/Bin.h"
 
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <new>
+#include <iostream>
+
+#include <boost/bind.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+using std::vector;
+using std::pair;
+
 namespace BioBin {
 
 namespace Test{
 
-void Test::setup(const PopulationManager& pop_mgr, const Utility::Phenotype& pheno){
+namespace {
+
+// The largest block of bins (as an n_samples x n_bins matrix of doubles)
+// given to runTestBlock at once, sized to stay in a typical L2 cache
+const unsigned long BLOCK_BYTES = 1 << 20;
+const unsigned int MAX_BLOCK_BINS = 64;
+
+unsigned int getBlockSize(unsigned int n_samples){
+	unsigned long n_bins = BLOCK_BYTES / (sizeof(double) * std::max(n_samples, 1u));
+	return static_cast<unsigned int>(std::max(1UL, std::min(n_bins,
+			static_cast<unsigned long>(MAX_BLOCK_BINS))));
+}
+
+// Keeps the warnings from different threads from interleaving
+boost::mutex warn_lock;
+
+/*
+ * Runs the test on a block of bins.  If the block runs out of memory, the
+ * bins are retried one at a time, and any bin that still cannot be tested
+ * gets a NaN p-value, with a warning naming the bin.
+ */
+void runBlock(const Test* test, const vector<const Bin*>& block,
+		vector<double>& pvals, vector<double>& accs){
+	try{
+		test->runTestBlock(block, pvals, accs);
+		return;
+	} catch(std::bad_alloc&){
+	}
+
+	if(block.size() > 1){
+		boost::unique_lock<boost::mutex> l(warn_lock);
+		std::cerr << "WARNING: Out of memory running " << test->getName()
+				<< " on a block of " << block.size()
+				<< " bins; retrying one bin at a time" << std::endl;
+	}
+
+	pvals.assign(block.size(), std::numeric_limits<double>::quiet_NaN());
+	accs.assign(block.size(), 0);
+	vector<const Bin*> one(1);
+	vector<double> pval, acc;
+	for(unsigned int i=0; i<block.size(); i++){
+		one[0] = block[i];
+		try{
+			test->runTestBlock(one, pval, acc);
+			pvals[i] = pval[0];
+			accs[i] = acc[0];
+		} catch(std::bad_alloc&){
+			boost::unique_lock<boost::mutex> l(warn_lock);
+			std::cerr << "WARNING: Out of memory running " << test->getName()
+					<< " on bin " << block[i]->getName()
+					<< "; its p-value will be NaN" << std::endl;
+		}
+	}
+}
+
+/*
+ * Runs the test on the bins at the given indexes, in blocks of at most
+ * block_size bins.
+ */
+void runBlocks(const Test* test, const vector<const Bin*>& bins,
+		const unsigned int* idx_begin, const unsigned int* idx_end, unsigned int block_size,
+		vector<double>& pvals_out, vector<double>& accs_out){
+	vector<const Bin*> block;
+	vector<double> pvals, accs;
+	while(idx_begin != idx_end){
+		unsigned int n = std::min(block_size, static_cast<unsigned int>(idx_end - idx_begin));
+		block.clear();
+		for(unsigned int i=0; i<n; i++){
+			block.push_back(bins[idx_begin[i]]);
+		}
+		runBlock(test, block, pvals, accs);
+		for(unsigned int i=0; i<n; i++){
+			pvals_out[idx_begin[i]] = pvals[i];
+			accs_out[idx_begin[i]] = accs[i];
+		}
+		idx_begin += n;
+	}
+}
+
+/*
+ * Hands out the bins to the worker threads in chunks.  The cost of a test
+ * grows with the number of variants in the bin, which ranges from 1 to many
+ * thousands, so the bins are ordered from most to least expensive and split
+ * into chunks of roughly equal cost: the largest bins are taken one at a
+ * time at the start, and the many small bins at the end are taken in large
+ * chunks.  Each thread takes the next chunk as soon as it is done with its
+ * last one, so no thread is left idle while there is still work to do.
+ */
+class BinScheduler {
+public:
+	BinScheduler(const vector<const Bin*>& bins, unsigned int n_threads) :
+			_next_chunk(0) {
+		vector<pair<unsigned int, unsigned int> > cost_idx;
+		cost_idx.reserve(bins.size());
+		unsigned long total_cost = 0;
+		for(unsigned int i=0; i<bins.size(); i++){
+			unsigned int cost = bins[i]->getVariantSize() + 1;
+			cost_idx.push_back(std::make_pair(cost, i));
+			total_cost += cost;
+		}
+		// most expensive first, ties in bin order
+		std::sort(cost_idx.begin(), cost_idx.end(), compareCost);
+
+		// aim for many chunks per thread, so the last ones finish together
+		unsigned long chunk_cost = std::max(total_cost / (CHUNKS_PER_THREAD * n_threads), 1UL);
+
+		_order.reserve(bins.size());
+		unsigned long curr_cost = 0;
+		for(unsigned int i=0; i<cost_idx.size(); i++){
+			if(curr_cost >= chunk_cost){
+				_chunk_start.push_back(_order.size());
+				curr_cost = 0;
+			}
+			if(_order.empty()){
+				_chunk_start.push_back(0);
+			}
+			_order.push_back(cost_idx[i].second);
+			curr_cost += cost_idx[i].first;
+		}
+		_chunk_start.push_back(_order.size());
+	}
+
+	/*!
+	 * \brief Gets the next chunk of bin indexes, [begin, end) in getOrder().
+	 * \return false if there is no work left
+	 */
+	bool next(unsigned int& begin_out, unsigned int& end_out){
+		boost::unique_lock<boost::mutex> l(_lock);
+		if(_next_chunk + 1 >= _chunk_start.size()){
+			return false;
+		}
+		begin_out = _chunk_start[_next_chunk];
+		end_out = _chunk_start[++_next_chunk];
+		return true;
+	}
+
+	const vector<unsigned int>& getOrder() const {return _order;}
+
+	/*!
+	 * \brief Stops handing out chunks, keeping the first error given so that
+	 * it can be rethrown once all of the threads are done.
+	 */
+	void abort(const boost::exception_ptr& err){
+		boost::unique_lock<boost::mutex> l(_lock);
+		if(!_error){
+			_error = err;
+		}
+		_next_chunk = _chunk_start.size();
+	}
+
+	//! Rethrows the error given to abort, if any
+	void rethrow() const{
+		if(_error){
+			boost::rethrow_exception(_error);
+		}
+	}
+
+private:
+	static const unsigned long CHUNKS_PER_THREAD = 16;
+
+	static bool compareCost(const pair<unsigned int, unsigned int>& a,
+			const pair<unsigned int, unsigned int>& b){
+		return a.first > b.first || (a.first == b.first && a.second < b.second);
+	}
+
+	vector<unsigned int> _order;
+	vector<unsigned int> _chunk_start;
+	unsigned int _next_chunk;
+	boost::exception_ptr _error;
+	boost::mutex _lock;
+};
+
+/*
+ * Runs chunks until there are none left.  Nothing would catch an exception
+ * thrown on a worker thread, so it is handed to the scheduler instead, and
+ * the other threads stop after their current chunk.
+ */
+void runChunks(const Test* test, BinScheduler& sched, const vector<const Bin*>& bins,
+		unsigned int block_size, vector<double>& pvals_out, vector<double>& accs_out){
+	const vector<unsigned int>& order = sched.getOrder();
+	unsigned int begin, end;
+	try{
+		while(sched.next(begin, end)){
+			// every bin is written by exactly one thread
+			runBlocks(test, bins, &order[0] + begin, &order[0] + end, block_size,
+					pvals_out, accs_out);
+		}
+	} catch(std::exception&){
+		sched.abort(boost::current_exception());
+	}
+}
+
+}
+
+unsigned int Test::c_n_threads = 0;
+
+void Test::setup(const PopulationManager& pop_mgr, const Utility::Phenotype& pheno,
+		const BinContributionCache* contrib){
 	_pop_mgr_ptr = &pop_mgr;
 	_pheno_ptr = &pheno;
+	_contrib_ptr = contrib;
 	init();
 }
 
+void Test::runTestBlock(const vector<const Bin*>& bins,
+		vector<double>& pvals_out, vector<double>& accs_out) const{
+	pvals_out.resize(bins.size());
+	accs_out.resize(bins.size());
+	for(unsigned int i=0; i<bins.size(); i++){
+		pvals_out[i] = runTest(*bins[i], &accs_out[i]);
+	}
+}
+
+void Test::runTests(const vector<const Bin*>& bins,
+		vector<double>& pvals_out, vector<double>& accs_out){
+	pvals_out.resize(bins.size());
+	accs_out.resize(bins.size());
+
+	unsigned int block_size = getBlockSize(_pop_mgr_ptr->getNumSamples());
+	unsigned int n_threads = std::min(c_n_threads, static_cast<unsigned int>(bins.size()));
+	if(n_threads <= 1){
+		vector<unsigned int> idx(bins.size());
+		for(unsigned int i=0; i<idx.size(); i++){
+			idx[i] = i;
+		}
+		if(!idx.empty()){
+			runBlocks(this, bins, &idx[0], &idx[0] + idx.size(), block_size, pvals_out, accs_out);
+		}
+		return;
+	}
+
+	BinScheduler sched(bins, n_threads);
+
+	// The tests keep per-phenotype state, so every extra thread needs its
+	// own clone, set up here before any of the threads start
+	vector<Test*> clones;
+	for(unsigned int i=1; i<n_threads; i++){
+		Test* t = clone();
+		t->setup(*_pop_mgr_ptr, *_pheno_ptr, _contrib_ptr);
+		clones.push_back(t);
+	}
+
+	boost::thread_group tg;
+	for(unsigned int i=0; i<clones.size(); i++){
+		tg.create_thread(boost::bind(&runChunks, clones[i], boost::ref(sched),
+				boost::cref(bins), block_size, boost::ref(pvals_out), boost::ref(accs_out)));
+	}
+	// this thread does its share, too
+	runChunks(this, sched, bins, block_size, pvals_out, accs_out);
+	tg.join_all();
+
+	for(unsigned int i=0; i<clones.size(); i++){
+		delete clones[i];
+	}
+
+	// now that no thread is using the scheduler, pass on any error
+	sched.rethrow();
+}
+
 }
 
 }
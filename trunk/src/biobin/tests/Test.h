@@ -9,8 +9,10 @@
 #define BIOBIN_TEST_TEST_H
 
 #include <string>
+#include <vector>
 
 #include "biobin/Bin.h"
+#include "biobin/BinContributionCache.h"
 #include "biobin/PopulationManager.h"
 
 #include "biobin/util/Phenotype.h"
@@ -27,7 +29,7 @@ namespace Test{
  */
 class Test {
 public:
-	Test() : _pop_mgr_ptr(0), _pheno_ptr(0) {}
+	Test() : _pop_mgr_ptr(0), _pheno_ptr(0), _contrib_ptr(0) {}
 	virtual ~Test() {}
 
 	virtual const std::string& getName() const  = 0;
@@ -36,19 +38,48 @@ public:
 	void runAllTests(const PopulationManager& pop_mgr,
 			const Utility::Phenotype& pheno,
 			const Bin_ptr_cont& bins,
+			const BinContributionCache& contrib,
 			Pval_cont& pvals_out,
 			Acc_cont& accs_out);
 
 	virtual Test* clone() const = 0;
 
+	/*!
+	 * \brief Number of threads used to run the tests on the bins of a
+	 * single phenotype (0 or 1 = run on the calling thread only).
+	 */
+	static unsigned int c_n_threads;
+
 //protected:
 	virtual void init() = 0;
 	virtual double runTest(const Bin& bin, double *accuracy) const = 0;
 
-	void setup(const PopulationManager& pop_mgr, const Utility::Phenotype& pheno);
+	/*!
+	 * \brief Runs the test on a block of bins, filling pvals_out and accs_out
+	 * in the order of the bins.  By default, runs runTest on each bin; tests
+	 * that can share work between the bins (a single matrix product over the
+	 * whole block, say) override this.
+	 */
+	virtual void runTestBlock(const std::vector<const Bin*>& bins,
+			std::vector<double>& pvals_out, std::vector<double>& accs_out) const;
+
+	void setup(const PopulationManager& pop_mgr, const Utility::Phenotype& pheno,
+			const BinContributionCache* contrib=0);
+
+	/*!
+	 * \brief Runs the test on every bin, filling pvals_out and accs_out in
+	 * the order of the bins.  Uses up to c_n_threads threads, each running
+	 * its own clone of this test, and passes the bins to runTestBlock in
+	 * blocks sized so the contributions of a block stay in cache.  A bin
+	 * that cannot be tested for lack of memory gets a NaN p-value.
+	 */
+	void runTests(const std::vector<const Bin*>& bins,
+			std::vector<double>& pvals_out, std::vector<double>& accs_out);
 
 	const PopulationManager* _pop_mgr_ptr;
 	const Utility::Phenotype* _pheno_ptr;
+	//! The contribution of each sample to each bin, shared by all tests
+	const BinContributionCache* _contrib_ptr;
 };
 
 template <class T>
@@ -75,16 +106,18 @@ protected:
 template<class Bin_ptr_cont, class Pval_cont, class Acc_cont>
 void Test::runAllTests(const PopulationManager& pop_mgr,
 		const Utility::Phenotype& pheno, const Bin_ptr_cont& bins,
+		const BinContributionCache& contrib,
 		Pval_cont& pvals_out, Acc_cont& accs_out) {
-	setup(pop_mgr, pheno);
+	setup(pop_mgr, pheno, &contrib);
+
+	std::vector<const Bin*> bin_list(bins.begin(), bins.end());
+	std::vector<double> pvals, accs;
+	runTests(bin_list, pvals, accs);
+
 	pvals_out.clear();
-	typename Bin_ptr_cont::const_iterator bin_itr = bins.begin();
-	double pval, accuracy;
-	while(bin_itr != bins.end()){
-		pval = runTest(**bin_itr, &accuracy);
-		pvals_out.push_back(pval);
-		accs_out.push_back(accuracy);
-		++bin_itr;
+	for(unsigned int i=0; i<bin_list.size(); i++){
+		pvals_out.push_back(pvals[i]);
+		accs_out.push_back(accs[i]);
 	}
 }
 
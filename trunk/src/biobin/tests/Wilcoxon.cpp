@@ -41,10 +41,13 @@ double Wilcoxon::runTest(const Bin& bin, double *accuracy) const{
 	vector<std::pair<float, unsigned int> > data;
 	data.reserve(status.first.size());
 
+	vector<float> contrib;
+	_contrib_ptr->getContribs(bin, contrib);
+
 	// case/control status doesn't really matter here, as long as it's not missing!
 	for(unsigned int i=0; i<status.first.size(); i++){
 		if(nonmiss[i]){
-			data.push_back(std::make_pair(_pop_mgr_ptr->getTotalIndivContrib(bin, i,  *_pheno_ptr), i));
+			data.push_back(std::make_pair(contrib[i], i));
 		}
 	}
 
@@ -223,5 +223,67 @@ int MatrixUtils::getPermuMatrix(const vector<unsigned int>& idx_permu,
 	return errcode;
 }
 
+ColinearUpdate::ColinearUpdate() : _R(0), _T(0), _V(0), _S(0), _ws_v(0),
+		_ws_m(0) {}
+
+ColinearUpdate::~ColinearUpdate(){
+	clear();
+}
+
+void ColinearUpdate::clear(){
+	if(_R){
+		gsl_matrix_free(_R);
+		gsl_matrix_free(_T);
+		gsl_matrix_free(_V);
+		gsl_vector_free(_S);
+		gsl_vector_free(_ws_v);
+		gsl_matrix_free(_ws_m);
+	}
+	_R = _T = _V = _ws_m = 0;
+	_S = _ws_v = 0;
+}
+
+void ColinearUpdate::setup(const gsl_matrix& R, bool lower){
+	clear();
+
+	unsigned int n = R.size2;
+	_R = gsl_matrix_calloc(n, n);
+	_T = gsl_matrix_alloc(n + 1, n + 1);
+	_V = gsl_matrix_alloc(n + 1, n + 1);
+	_S = gsl_vector_alloc(n + 1);
+	_ws_v = gsl_vector_alloc(n + 1);
+	_ws_m = gsl_matrix_alloc(n + 1, n + 1);
+
+	for(unsigned int i=0; i<n; i++){
+		for(unsigned int k=i; k<n; k++){
+			gsl_matrix_set(_R, i, k,
+					lower ? gsl_matrix_get(&R, k, i) : gsl_matrix_get(&R, i, k));
+		}
+	}
+}
+
+int ColinearUpdate::isColinear(const gsl_vector& q, double e_sq,
+		bool& colinear_out){
+	colinear_out = false;
+	if(!_R){
+		return GSL_EFAILED;
+	}
+
+	unsigned int n = _R->size1;
+	gsl_matrix_set_zero(_T);
+	for(unsigned int i=0; i<n; i++){
+		for(unsigned int k=i; k<n; k++){
+			gsl_matrix_set(_T, i, k, gsl_matrix_get(_R, i, k));
+		}
+		gsl_matrix_set(_T, i, n, gsl_vector_get(&q, i));
+	}
+	// |g|^2 - |q|^2 can round to slightly below 0 when g is in the span of X
+	gsl_matrix_set(_T, n, n, sqrt(std::max(e_sq, 0.0)));
+
+	int errcode = gsl_linalg_SV_decomp_mod(_T, _ws_m, _V, _S, _ws_v);
+	colinear_out = gsl_vector_get(_S, n) < std::numeric_limits<float>::epsilon();
+	return errcode;
+}
+
 }
 }
@@ -66,6 +66,52 @@ private:
 
 };
 
+/*
+ * \brief Checks columns added one at a time to a fixed, full-rank X
+ * If X = QR, then [X g] = Q[R q; 0 e] with q the first columns of Q'g and e
+ * the rest, so [X g] has the same singular values as the small triangular
+ * matrix [R q; 0 |e|].  This flags exactly the columns that
+ * MatrixUtils::checkColinear would find colinear in [X g], without an SVD
+ * of an n-row matrix for every column.
+ *
+ * The workspace is kept between calls, so an instance is not thread safe.
+ */
+class ColinearUpdate {
+public:
+	ColinearUpdate();
+	~ColinearUpdate();
+
+	/*
+	 * \brief Sets the triangular factor R of X
+	 * \param R a square matrix holding R in its upper triangle, or R' in its
+	 * lower triangle if lower is true (as from a Cholesky decomposition of X'X)
+	 */
+	void setup(const gsl_matrix& R, bool lower = false);
+
+	/*
+	 * \brief Checks whether [X g] is colinear
+	 * \param q the coordinates of g in the column space of X (R'^-1 X'g)
+	 * \param e_sq the squared norm of the rest of g, |g|^2 - |q|^2
+	 * \param colinear_out set to true if [X g] is colinear
+	 * \return GSL_SUCCESS, or the error code from the SVD
+	 */
+	int isColinear(const gsl_vector& q, double e_sq, bool& colinear_out);
+
+private:
+	// no copying, please
+	ColinearUpdate(const ColinearUpdate&);
+	ColinearUpdate& operator=(const ColinearUpdate&);
+
+	void clear();
+
+	gsl_matrix* _R;
+	gsl_matrix* _T;
+	gsl_matrix* _V;
+	gsl_vector* _S;
+	gsl_vector* _ws_v;
+	gsl_matrix* _ws_m;
+};
+
 }
 
 }
@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 #include <gsl/gsl_blas.h>
 
@@ -43,6 +44,7 @@ void Regression::regressionSetup(const PopulationManager& pop_mgr, const Phenoty
 	gsl_matrix* data_tmp = gsl_matrix_alloc(pop_mgr.getNumSamples(), pop_mgr.getNumCovars() + 2);
 	gsl_vector* pheno_tmp = gsl_vector_alloc(pop_mgr.getNumSamples());
 	_included.resize(pop_mgr.getNumSamples(),false);
+	_samp_row.resize(pop_mgr.getNumSamples(), -1);
 
 	unsigned int i=0;
 	unsigned int s_idx=0;
@@ -75,6 +77,7 @@ void Regression::regressionSetup(const PopulationManager& pop_mgr, const Phenoty
 
 			_samp_name.push_back(std::make_pair(*si, s_idx));
 			_included.set(s_idx, true);
+			_samp_row[s_idx] = i;
 			++i;
 		}
 		++s_idx;
@@ -137,6 +140,29 @@ void Regression::regressionSetup(const PopulationManager& pop_mgr, const Phenoty
 		// free the data_new structure (which was the "old" _data)
 		gsl_matrix_free(data_new);
 		gsl_permutation_free(permu);
+
+		// and drop the same columns from the null model, so its coefficients
+		// line up with the columns of _data
+		const vector<unsigned int>& dropped = _null_result->dropped_cols;
+		vector<unsigned int> kept;
+		for(unsigned int j=0; j<_null_result->beta->size; j++){
+			if(!std::binary_search(dropped.begin(), dropped.end(), j)){
+				kept.push_back(j);
+			}
+		}
+
+		gsl_vector* beta_new = gsl_vector_alloc(kept.size());
+		gsl_matrix* cov_new = gsl_matrix_alloc(kept.size(), kept.size());
+		for(unsigned int j=0; j<kept.size(); j++){
+			gsl_vector_set(beta_new, j, gsl_vector_get(_null_result->beta, kept[j]));
+			for(unsigned int k=0; k<kept.size(); k++){
+				gsl_matrix_set(cov_new, j, k, gsl_matrix_get(_null_result->cov, kept[j], kept[k]));
+			}
+		}
+		std::swap(beta_new, _null_result->beta);
+		std::swap(cov_new, _null_result->cov);
+		gsl_vector_free(beta_new);
+		gsl_matrix_free(cov_new);
 		_null_result->dropped_cols.clear();
 	}
 
@@ -147,6 +173,24 @@ void Regression::regressionSetup(const PopulationManager& pop_mgr, const Phenoty
 
 }
 
+void Regression::getBinMatrix(const BinContributionCache& contrib,
+		const vector<const Bin*>& bins, gsl_matrix* G_out) const{
+	gsl_matrix_set_zero(G_out);
+
+	// only the carriers contribute, so only set their entries
+	vector<unsigned int> samples;
+	vector<float> bin_contrib;
+	for(unsigned int j=0; j<bins.size(); j++){
+		contrib.getNonzeroContribs(*bins[j], samples, bin_contrib);
+		for(unsigned int k=0; k<samples.size(); k++){
+			int row = _samp_row[samples[k]];
+			if(row >= 0){
+				gsl_matrix_set(G_out, row, j, bin_contrib[k]);
+			}
+		}
+	}
+}
+
 }
 
 }
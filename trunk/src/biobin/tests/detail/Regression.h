@@ -17,6 +17,8 @@
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_vector.h>
 
+#include "biobin/Bin.h"
+#include "biobin/BinContributionCache.h"
 #include "biobin/PopulationManager.h"
 #include "biobin/util/Phenotype.h"
 
@@ -61,6 +63,13 @@ public:
 	virtual float getPhenotype(const PopulationManager& pop_mgr,
 			const Utility::Phenotype& pheno, const std::string& samp) const = 0;
 
+	/*!
+	 * \brief Fills column j of G_out (one row per row of _data) with the
+	 * contributions to bins[j].
+	 */
+	void getBinMatrix(const BinContributionCache& contrib,
+			const std::vector<const Bin*>& bins, gsl_matrix* G_out) const;
+
 	//! The matrix of covariates + bin
 	gsl_matrix* _data;
 
@@ -76,6 +85,9 @@ public:
 	//! along with the index of each!
 	std::vector<std::pair<std::string, unsigned int> > _samp_name;
 
+	//! The row of _data of each sample (by index), -1 if not included
+	std::vector<int> _samp_row;
+
 	// set this in the init if we know that we will fail for some reason
 	bool _willfail;
 
@@ -13,7 +13,6 @@
 #include <string>
 
 #include <boost/dynamic_bitset.hpp>
-#include <boost/thread.hpp>
 
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_vector.h>
@@ -21,6 +20,8 @@
 #include "biobin/PopulationManager.h"
 #include "biobin/util/Phenotype.h"
 
+#include "SKATWorkspace.h"
+
 
 namespace BioBin {
 
@@ -36,15 +37,18 @@ private:
 public:
 	// gets the genotype matrix and weight vector, returning the number of
 	// SNPs in the gentoype matrix.  (Note: you really should check to see
-	// if this is == 0, b/c it will fail!)
+	// if this is == 0, b/c it will fail!)  The matrix is a view into the
+	// workspace, and is left unset if there are no SNPs.
 	static unsigned int getGenoWeights(const PopulationManager& pop_mgr,
 			const Utility::Phenotype& pheno,
 			const boost::dynamic_bitset<>& incl,
 			const Bin& bin,
 			const std::vector<std::pair<std::string, unsigned int> >& name_pos,
-			gsl_matrix* &geno_wt);
+			SKATWorkspace& ws,
+			gsl_matrix_view& geno_wt);
 
-	static double getPvalue(double Q, const gsl_matrix* W, double *accuracy);
+	static double getPvalue(double Q, const gsl_matrix* W, double *accuracy,
+			SKATWorkspace& ws);
 
         // configurable p-value calculation settings
         static double skat_matrix_threshold;
@@ -58,8 +62,6 @@ private:
 		v = (v & 0x33) + ((v >> 2) & 0x33); // put count of each 4 bits into those 4 bits
 		return (v + ((v >> 4) & 0x0F)); // add the counts of each 4 bit
 	}
-
-	static boost::mutex _qfc_lock;
 };
 
 }
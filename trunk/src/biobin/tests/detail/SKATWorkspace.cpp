@@ -0,0 +1,87 @@
+/*
+ * SKATWorkspace.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "SKATWorkspace.h"
+
+#include <algorithm>
+#include <new>
+
+namespace BioBin {
+
+namespace Test {
+
+SKATWorkspace::~SKATWorkspace(){
+	for(unsigned int i=0; i<_blocks.size(); i++){
+		delete[] _blocks[i].data;
+	}
+	if(_eigen_ws){
+		gsl_eigen_symm_free(_eigen_ws);
+	}
+}
+
+void SKATWorkspace::reset(){
+	if(_blocks.size() > 1){
+		Block b;
+		b.size = 0;
+		for(unsigned int i=0; i<_blocks.size(); i++){
+			b.size += _blocks[i].size;
+		}
+		// If the merged block does not fit, keep the blocks we have and
+		// carry on from the last one
+		b.data = new (std::nothrow) double[b.size];
+		if(b.data){
+			for(unsigned int i=0; i<_blocks.size(); i++){
+				delete[] _blocks[i].data;
+			}
+			_blocks.clear();
+			_blocks.push_back(b);
+		}
+	}
+	_used = 0;
+}
+
+double* SKATWorkspace::alloc(std::size_t n){
+	// The views handed out so far must stay valid, so never move a block;
+	// start a new one instead
+	if(_blocks.empty() || _used + n > _blocks.back().size){
+		Block b;
+		b.size = std::max(n, _blocks.empty() ? MIN_BLOCK_SIZE : 2 * _blocks.back().size);
+		b.data = new (std::nothrow) double[b.size];
+		if(!b.data){
+			// Try for just what was asked; this throws if even that fails
+			b.size = n;
+			b.data = new double[b.size];
+		}
+		_blocks.push_back(b);
+		_used = 0;
+	}
+
+	double* p = _blocks.back().data + _used;
+	_used += n;
+	return p;
+}
+
+gsl_matrix_view SKATWorkspace::getMatrix(std::size_t size1, std::size_t size2){
+	return gsl_matrix_view_array(alloc(size1 * size2), size1, size2);
+}
+
+gsl_vector_view SKATWorkspace::getVector(std::size_t size){
+	return gsl_vector_view_array(alloc(size), size);
+}
+
+gsl_eigen_symm_workspace* SKATWorkspace::getEigen(std::size_t n){
+	if(!_eigen_ws || _eigen_ws->size < n){
+		if(_eigen_ws){
+			gsl_eigen_symm_free(_eigen_ws);
+		}
+		_eigen_ws = gsl_eigen_symm_alloc(n);
+	}
+	return _eigen_ws;
+}
+
+}
+
+}
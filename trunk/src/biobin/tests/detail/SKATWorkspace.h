@@ -0,0 +1,85 @@
+/*
+ * SKATWorkspace.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_TEST_SKATWORKSPACE_H
+#define BIOBIN_TEST_SKATWORKSPACE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+#include <gsl/gsl_eigen.h>
+
+namespace BioBin {
+
+namespace Test {
+
+/*!
+ * \brief Working space for the SKAT tests, reused from bin to bin.
+ *
+ * The matrices and vectors used to test a bin are views into blocks of
+ * memory owned by the workspace.  reset() is called at the start of each
+ * bin; if the last bin needed more than one block, they are replaced by a
+ * single block large enough for all of them, so once the largest bin has
+ * been seen, testing a bin allocates nothing.
+ *
+ * Each thread runs its own clone of a test, and so has its own workspace.
+ */
+class SKATWorkspace {
+public:
+	SKATWorkspace() : _used(0), _eigen_ws(0) {}
+	~SKATWorkspace();
+
+	//! Releases every view handed out since the last reset
+	void reset();
+
+	//! Gets an (uninitialized) size1 x size2 matrix, valid until the next reset
+	gsl_matrix_view getMatrix(std::size_t size1, std::size_t size2);
+
+	//! Gets an (uninitialized) vector, valid until the next reset
+	gsl_vector_view getVector(std::size_t size);
+
+	/*!
+	 * \brief Gets a workspace for the eigenvalues of an n x n symmetric matrix.
+	 * gsl_eigen_symm only needs the workspace to be at least as large as the
+	 * matrix, so the largest one is kept.
+	 */
+	gsl_eigen_symm_workspace* getEigen(std::size_t n);
+
+	// Scratch space for SKATUtils, kept for its capacity
+	std::vector<double> weights;
+	std::vector<unsigned int> good_idx;
+	std::vector<double> nct;
+	std::vector<int> df;
+	std::vector<double> qfc_detail;
+
+private:
+	// No copying or assignment!
+	SKATWorkspace(const SKATWorkspace&);
+	SKATWorkspace& operator=(const SKATWorkspace&);
+
+	double* alloc(std::size_t n);
+
+	//! Smallest block allocated, in doubles
+	static const std::size_t MIN_BLOCK_SIZE = 1 << 16;
+
+	struct Block{
+		double* data;
+		std::size_t size;
+	};
+
+	std::vector<Block> _blocks;
+	//! Doubles used in the last block
+	std::size_t _used;
+	gsl_eigen_symm_workspace* _eigen_ws;
+};
+
+}
+
+}
+
+#endif /* BIOBIN_TEST_SKATWORKSPACE_H */
@@ -0,0 +1,184 @@
+/*
+ * ScoreTest.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "ScoreTest.h"
+
+#include <limits>
+
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_cdf.h>
+#include <gsl/gsl_errno.h>
+
+namespace BioBin {
+
+namespace Test {
+
+ScoreTest::~ScoreTest(){
+	clear();
+}
+
+void ScoreTest::clear(){
+	if(_proj){
+		gsl_matrix_free(_proj);
+		_proj = 0;
+	}
+	if(_proj_x){
+		gsl_matrix_free(_proj_x);
+		_proj_x = 0;
+	}
+	if(_resid){
+		gsl_vector_free(_resid);
+		_resid = 0;
+	}
+	if(_wt){
+		gsl_vector_free(_wt);
+		_wt = 0;
+	}
+}
+
+int ScoreTest::project(const gsl_matrix& X, const gsl_vector* wt,
+		gsl_matrix* proj, gsl_matrix* L){
+	int errcode = GSL_SUCCESS;
+
+	// start with proj = X'W
+	errcode |= gsl_matrix_transpose_memcpy(proj, &X);
+	if(wt){
+		for(unsigned int j=0; j<wt->size; j++){
+			gsl_vector_view col = gsl_matrix_column(proj, j);
+			errcode |= gsl_vector_scale(&col.vector, gsl_vector_get(wt, j));
+		}
+	}
+
+	// factor X'WX = LL' (L is left in the lower triangle)
+	errcode |= gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1, proj, &X, 0, L);
+	if(errcode == GSL_SUCCESS){
+		errcode |= gsl_linalg_cholesky_decomp(L);
+	}
+
+	// and proj = L^-1 X'W
+	if(errcode == GSL_SUCCESS){
+		errcode |= gsl_blas_dtrsm(CblasLeft, CblasLower, CblasNoTrans, CblasNonUnit,
+				1, L, proj);
+	}
+
+	return errcode;
+}
+
+int ScoreTest::setup(const gsl_matrix& X, const gsl_vector& resid,
+		const gsl_vector* wt, double scale){
+	clear();
+
+	int errcode = GSL_SUCCESS;
+	_scale = scale;
+
+	_resid = gsl_vector_alloc(resid.size);
+	errcode |= gsl_vector_memcpy(_resid, &resid);
+	if(wt){
+		_wt = gsl_vector_alloc(wt->size);
+		errcode |= gsl_vector_memcpy(_wt, wt);
+	}
+
+	gsl_matrix* L = gsl_matrix_alloc(X.size2, X.size2);
+	_proj = gsl_matrix_alloc(X.size2, X.size1);
+	if(errcode == GSL_SUCCESS){
+		errcode |= project(X, _wt, _proj, L);
+	}
+
+	// The colinearity check needs the unweighted factor; L0' is the R of X
+	if(errcode == GSL_SUCCESS && _wt){
+		_proj_x = gsl_matrix_alloc(X.size2, X.size1);
+		errcode |= project(X, 0, _proj_x, L);
+	}
+	if(errcode == GSL_SUCCESS){
+		_colinear.setup(*L, true);
+	}
+
+	gsl_matrix_free(L);
+
+	if(errcode != GSL_SUCCESS){
+		clear();
+	}
+
+	return errcode;
+}
+
+void ScoreTest::pvalues(const gsl_matrix& G, std::vector<double>& pvals_out) const{
+	pvals_out.assign(G.size2, 1);
+	if(!_proj){
+		return;
+	}
+
+	int errcode = GSL_SUCCESS;
+
+	// The scores, G'r
+	gsl_vector* U = gsl_vector_alloc(G.size2);
+	errcode |= gsl_blas_dgemv(CblasTrans, 1, &G, _resid, 0, U);
+
+	// the part of g'Wg explained by X is |L^-1 X'Wg|^2, so all at once,
+	// Z = (L^-1 X'W) G
+	gsl_matrix* Z = gsl_matrix_alloc(_proj->size1, G.size2);
+	errcode |= gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1, _proj, &G, 0, Z);
+
+	// and the coordinates of g in the column space of X, unweighted, for
+	// the colinearity check: Z0 = (L0^-1 X') G
+	gsl_matrix* Z0 = Z;
+	if(_proj_x){
+		Z0 = gsl_matrix_alloc(_proj_x->size1, G.size2);
+		errcode |= gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1, _proj_x, &G, 0, Z0);
+	}
+
+	// g'Wg, g'g, |z|^2 and |z0|^2 for each column, walking the rows in order
+	std::vector<double> gWg(G.size2, 0);
+	std::vector<double> gg(G.size2, 0);
+	for(unsigned int i=0; i<G.size1; i++){
+		double w_i = _wt ? gsl_vector_get(_wt, i) : 1;
+		for(unsigned int j=0; j<G.size2; j++){
+			double g_ij = gsl_matrix_get(&G, i, j);
+			gWg[j] += w_i * g_ij * g_ij;
+			gg[j] += g_ij * g_ij;
+		}
+	}
+	std::vector<double> gWX_proj(G.size2, 0);
+	std::vector<double> gX_proj(G.size2, 0);
+	for(unsigned int i=0; i<Z->size1; i++){
+		for(unsigned int j=0; j<Z->size2; j++){
+			double z_ij = gsl_matrix_get(Z, i, j);
+			double z0_ij = gsl_matrix_get(Z0, i, j);
+			gWX_proj[j] += z_ij * z_ij;
+			gX_proj[j] += z0_ij * z0_ij;
+		}
+	}
+
+	for(unsigned int j=0; errcode == GSL_SUCCESS && j<G.size2; j++){
+		// if [X g] is colinear, the regressions drop g, so there's nothing
+		// to test
+		gsl_vector_const_view q_v = gsl_matrix_const_column(Z0, j);
+		bool is_colinear;
+		errcode |= _colinear.isColinear(q_v.vector, gg[j] - gX_proj[j], is_colinear);
+		if(errcode != GSL_SUCCESS){
+			break;
+		}
+
+		if(is_colinear){
+			pvals_out[j] = std::numeric_limits<double>::quiet_NaN();
+		} else {
+			double resid_var = gWg[j] - gWX_proj[j];
+			double u = gsl_vector_get(U, j);
+			pvals_out[j] = gsl_cdf_chisq_Q(u * u / (_scale * resid_var), 1);
+		}
+	}
+
+	if(Z0 != Z){
+		gsl_matrix_free(Z0);
+	}
+	gsl_vector_free(U);
+	gsl_matrix_free(Z);
+}
+
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+ * ScoreTest.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_TEST_SCORETEST_H
+#define BIOBIN_TEST_SCORETEST_H
+
+#include <vector>
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include "MatrixUtils.h"
+
+namespace BioBin {
+
+namespace Test {
+
+/*!
+ * \brief The score test of adding a single column to a fitted null model.
+ *
+ * Given the null design X, the null residuals r and the weights W of the
+ * final IRLS step (the identity for linear regression), the score of a new
+ * column g is U = g'r, with variance
+ *   V = s * (g'Wg - g'WX (X'WX)^-1 X'Wg)
+ * where s is the dispersion (the residual variance for linear regression,
+ * 1 for logistic).  U^2/V is chi-squared with 1 degree of freedom under the
+ * null.
+ *
+ * setup factors X'WX = LL' and keeps B = L^-1 X'W, so that each column
+ * costs a single product Bg, or O(n*p), instead of a full refit, and a
+ * block of columns a single matrix product.
+ *
+ * Columns are checked for colinearity on the unweighted [X g], exactly as
+ * the regressions check their full model, so a weighted test also keeps
+ * the unweighted B0 = L0^-1 X' (with X'X = L0 L0').
+ */
+class ScoreTest {
+public:
+	ScoreTest() : _proj(0), _proj_x(0), _resid(0), _wt(0), _scale(1) {}
+	~ScoreTest();
+
+	/*!
+	 * \brief Precomputes everything that does not depend on the tested column.
+	 *
+	 * \param X The null design matrix, with no colinear columns
+	 * \param resid The residuals of the null model
+	 * \param wt The weights of the null model, or NULL if unweighted
+	 * \param scale The dispersion of the null model
+	 * \return a GSL error code
+	 */
+	int setup(const gsl_matrix& X, const gsl_vector& resid,
+			const gsl_vector* wt, double scale);
+
+	/*!
+	 * \brief Gets the p-value of the score test of each column of G, which
+	 * has one row per row of X.  The p-value is NaN if [X g] is colinear,
+	 * as the regressions would drop g from the model.
+	 */
+	void pvalues(const gsl_matrix& G, std::vector<double>& pvals_out) const;
+
+private:
+	// No copying or assignment!
+	ScoreTest(const ScoreTest&);
+	ScoreTest& operator=(const ScoreTest&);
+
+	void clear();
+
+	//! Sets proj = L^-1 X'W and L, where X'WX = LL'
+	static int project(const gsl_matrix& X, const gsl_vector* wt,
+			gsl_matrix* proj, gsl_matrix* L);
+
+	//! L^-1 X'W, p x n
+	gsl_matrix* _proj;
+	//! L0^-1 X', p x n; NULL if unweighted, as it is then _proj
+	gsl_matrix* _proj_x;
+	gsl_vector* _resid;
+	//! NULL if unweighted
+	gsl_vector* _wt;
+	double _scale;
+	mutable ColinearUpdate _colinear;
+};
+
+}
+
+}
+
+#endif /* BIOBIN_TEST_SCORETEST_H */
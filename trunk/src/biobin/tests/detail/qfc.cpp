@@ -3,6 +3,9 @@
 *	qfc function from CompQuadForm package
 *		date: 12/05/2011
 *
+*	Modified to keep all of its state in a qfc_state local to each
+*	call, so that it is reentrant and thread-safe
+*
 ****************************************************************/
 
 
@@ -24,23 +27,26 @@ typedef int BOOL;
 
 extern "C" {
 
-static double sigsq, lmax, lmin, mean, c;
-static double intl, ersm;
-static int count, r, lim;  static BOOL ndtsrt, fail;
-static int *n,*th; static double *lb,*nc;
-static jmp_buf env;
+/* The state of a single call to qfc, so that it may be called from
+   several threads at once */
+typedef struct {
+   double sigsq, lmax, lmin, mean, c;
+   double intl, ersm;
+   int count, r, lim;  BOOL ndtsrt, fail;
+   int *n,*th; double *lb,*nc;
+   jmp_buf env;
+} qfc_state;
 
 
 
 static double exp1(double x)               /* to avoid underflows  */
 { return x < -50.0 ? 0.0 : exp(x); }
 
-   static void counter(void)
+   static void counter(qfc_state* st)
    /*  count number of calls to errbd, truncation, cfe */
    {
-      extern int count,lim;
-      count = count + 1;
-      if ( count > lim ) longjmp(env,1);
+      st->count = st->count + 1;
+      if ( st->count > st->lim ) longjmp(st->env,1);
    }
 
    static double square(double x)  { return x*x; }
@@ -66,38 +72,36 @@ static double exp1(double x)               /* to avoid underflows  */
       }
   }
 
-  static void order(void)
+  static void order(qfc_state* st)
   /* find order of absolute values of lb */
   {
       int j, k; double lj;
-      extern double *lb; extern int *th; extern int r; extern BOOL ndtsrt;
-      for ( j=0; j<r; j++ )
+      for ( j=0; j<st->r; j++ )
       {
-         lj = fabs(lb[j]);
+         lj = fabs(st->lb[j]);
          for (k = j-1; k>=0; k--)
          {
-            if ( lj > fabs(lb[th[k]]) )  th[k + 1] = th[k];
+            if ( lj > fabs(st->lb[st->th[k]]) )  st->th[k + 1] = st->th[k];
             else goto l1;
          }
          k = -1;
       l1 :
-         th[k + 1] = j;
+         st->th[k + 1] = j;
       }
-      ndtsrt = FALSE;
+      st->ndtsrt = FALSE;
    }
 
 
-   static double   errbd(double u, double* cx)
+   static double   errbd(qfc_state* st, double u, double* cx)
    /*  find bound on tail probability using mgf, cutoff
       point returned to *cx */
    {
       double sum1, lj, ncj, x, y, xconst; int j, nj;
-      extern double sigsq,*lb,*nc; extern int *n; extern int r;
-      counter();
-      xconst = u * sigsq;  sum1 = u * xconst;  u = 2.0 * u;
-      for (j=r-1; j>=0; j--)
+      counter(st);
+      xconst = u * st->sigsq;  sum1 = u * xconst;  u = 2.0 * u;
+      for (j=st->r-1; j>=0; j--)
       {
-         nj = n[j]; lj = lb[j]; ncj = nc[j];
+         nj = st->n[j]; lj = st->lb[j]; ncj = st->nc[j];
          x = u * lj; y = 1.0 - x;
          xconst = xconst + lj * (ncj / y + nj) / y;
          sum1 = sum1 + ncj * square(x / y)
@@ -106,24 +110,23 @@ static double exp1(double x)               /* to avoid underflows  */
       *cx = xconst; return exp1(-0.5 * sum1);
    }
 
-   static double  ctff(double accx, double* upn)
+   static double  ctff(qfc_state* st, double accx, double* upn)
    /*  find ctff so that p(qf > ctff) < accx  if (upn > 0,
        p(qf < ctff) < accx otherwise */
    {
       double u1, u2, u, rb, xconst, c1, c2;
-      extern double lmin,lmax,mean;
-      u2 = *upn;   u1 = 0.0;  c1 = mean;
-      rb = 2.0 * ((u2 > 0.0) ? lmax : lmin);
-      for (u = u2 / (1.0 + u2 * rb); errbd(u, &c2) > accx; 
+      u2 = *upn;   u1 = 0.0;  c1 = st->mean;
+      rb = 2.0 * ((u2 > 0.0) ? st->lmax : st->lmin);
+      for (u = u2 / (1.0 + u2 * rb); errbd(st, u, &c2) > accx; 
          u = u2 / (1.0 + u2 * rb))
       {
          u1 = u2;  c1 = c2;  u2 = 2.0 * u2;
       }
-      for (u = (c1 - mean) / (c2 - mean); u < 0.9;
-         u = (c1 - mean) / (c2 - mean))
+      for (u = (c1 - st->mean) / (c2 - st->mean); u < 0.9;
+         u = (c1 - st->mean) / (c2 - st->mean))
       {
          u = (u1 + u2) / 2.0;
-         if (errbd(u / (1.0 + u * rb), &xconst) > accx)
+         if (errbd(st, u / (1.0 + u * rb), &xconst) > accx)
             {  u1 = u; c1 = xconst;  }
          else
             {  u2 = u;  c2 = xconst; }
@@ -131,21 +134,20 @@ static double exp1(double x)               /* to avoid underflows  */
       *upn = u2; return c2;
    }
 
-   static double truncation(double u, double tausq)
+   static double truncation(qfc_state* st, double u, double tausq)
    /* bound integration error due to truncation at u */
    {
       double sum1, sum2, prod1, prod2, prod3, lj, ncj,
          x, y, err1, err2;
       int j, nj, s;
-      extern double sigsq,*lb,*nc; extern int *n; extern int r;
 
-      counter();
+      counter(st);
       sum1  = 0.0; prod2 = 0.0;  prod3 = 0.0;  s = 0;
-      sum2 = (sigsq + tausq) * square(u); prod1 = 2.0 * sum2;
+      sum2 = (st->sigsq + tausq) * square(u); prod1 = 2.0 * sum2;
       u = 2.0 * u;
-      for (j=0; j<r; j++ )
+      for (j=0; j<st->r; j++ )
       {
-         lj = lb[j];  ncj = nc[j]; nj = n[j];
+         lj = st->lb[j];  ncj = st->nc[j]; nj = st->n[j];
          x = square(u * lj);
          sum1 = sum1 + ncj * x / (1.0 + x);
          if (x > 1.0)
@@ -168,48 +170,46 @@ static double exp1(double x)               /* to avoid underflows  */
       return  ( err1 < err2 )  ? err1  :  err2;
    }
 
-   static void findu(double* utx, double accx)
+   static void findu(qfc_state* st, double* utx, double accx)
    /*  find u such that truncation(u) < accx and truncation(u / 1.2) > accx */
    {
       double u, ut; int i;
-      static double divis[]={2.0,1.4,1.2,1.1};
+      static const double divis[]={2.0,1.4,1.2,1.1};
       ut = *utx; u = ut / 4.0;
-      if ( truncation(u, 0.0) > accx )
+      if ( truncation(st, u, 0.0) > accx )
       {
-         for ( u = ut; truncation(u, 0.0) > accx; u = ut) ut = ut * 4.0;
+         for ( u = ut; truncation(st, u, 0.0) > accx; u = ut) ut = ut * 4.0;
       }
       else
       {
          ut = u;
-         for ( u = u / 4.0; truncation(u, 0.0) <=  accx; u = u / 4.0 )
+         for ( u = u / 4.0; truncation(st, u, 0.0) <=  accx; u = u / 4.0 )
          ut = u;
       }
       for ( i=0;i<4;i++)
-         { u = ut/divis[i]; if ( truncation(u, 0.0)  <=  accx )  ut = u; }
+         { u = ut/divis[i]; if ( truncation(st, u, 0.0)  <=  accx )  ut = u; }
       *utx = ut;
    }
 
 
-   static void integrate(int nterm, double interv, double tausq, BOOL mainx)
+   static void integrate(qfc_state* st, int nterm, double interv, double tausq, BOOL mainx)
    /*  carry out integration with nterm terms, at stepsize
       interv.  if (! mainx) multiply integrand by
          1.0-exp(-0.5*tausq*u^2) */
    {
       double inpi, u, sum1, sum2, sum3, x, y, z;
       int k, j, nj;
-      extern double intl,ersm; extern double sigsq,c;
-      extern int *n; extern double *lb,*nc; extern int r;
       inpi = interv / pi;
       for ( k = nterm; k>=0; k--)
       {
          u = (k + 0.5) * interv;
-         sum1 = - 2.0 * u * c;  sum2 = fabs(sum1);
-         sum3 = - 0.5 * sigsq * square(u);
-         for ( j = r-1; j>=0; j--)
+         sum1 = - 2.0 * u * st->c;  sum2 = fabs(sum1);
+         sum3 = - 0.5 * st->sigsq * square(u);
+         for ( j = st->r-1; j>=0; j--)
          {
-            nj = n[j];  x = 2.0 * lb[j] * u;  y = square(x);
+            nj = st->n[j];  x = 2.0 * st->lb[j] * u;  y = square(x);
             sum3 = sum3 - 0.25 * nj * log1(y, TRUE );
-            y = nc[j] * x / (1.0 + y);
+            y = st->nc[j] * x / (1.0 + y);
             z = nj * atan(x) + y;
             sum1 = sum1 + z;   sum2 = sum2 + fabs(z);
             sum3 = sum3 - 0.5 * x * y;
@@ -218,39 +218,37 @@ static double exp1(double x)               /* to avoid underflows  */
 	 if ( !  mainx )
          x = x * (1.0 - exp1(-0.5 * tausq * square(u)));
          sum1 = sin(0.5 * sum1) * x;  sum2 = 0.5 * sum2 * x;
-         intl = intl + sum1; ersm = ersm + sum2;
+         st->intl = st->intl + sum1; st->ersm = st->ersm + sum2;
       }
    }
 
-   static double cfe(double x)
+   static double cfe(qfc_state* st, double x)
    /*  coef of tausq in error when convergence factor of
       exp1(-0.5*tausq*u^2) is used when df is evaluated at x */
    {
       double axl, axl1, axl2, sxl, sum1, lj; int j, k, t;
-      extern BOOL ndtsrt,fail; extern int *th,*n; extern double *lb,*nc;
-      extern int r;
-      counter();
-      if (ndtsrt) order();
+      counter(st);
+      if (st->ndtsrt) order(st);
       axl = fabs(x);  sxl = (x>0.0) ? 1.0 : -1.0;  sum1 = 0.0;
-      for ( j = r-1; j>=0; j-- )
-      { t = th[j];
-         if ( lb[t] * sxl > 0.0 )
+      for ( j = st->r-1; j>=0; j-- )
+      { t = st->th[j];
+         if ( st->lb[t] * sxl > 0.0 )
          {
-            lj = fabs(lb[t]);
-            axl1 = axl - lj * (n[t] + nc[t]);  axl2 = lj / log28;
+            lj = fabs(st->lb[t]);
+            axl1 = axl - lj * (st->n[t] + st->nc[t]);  axl2 = lj / log28;
             if ( axl1 > axl2 )  axl = axl1  ; else
             {
                if ( axl > axl2 )  axl = axl2;
                sum1 = (axl - axl1) / lj;
                for ( k = j-1; k>=0; k--)
-               sum1 = sum1 + (n[th[k]] + nc[th[k]]);
+               sum1 = sum1 + (st->n[st->th[k]] + st->nc[st->th[k]]);
                goto  l;
             }
          }
       }
    l:
       if (sum1 > 100.0)
-      { fail = TRUE; return 1.0; } else
+      { st->fail = TRUE; return 1.0; } else
       return pow(2.0,(sum1 / 4.0)) / (pi * square(axl));
    }
 
@@ -288,56 +286,55 @@ output:
 {
       int j, nj, nt, ntm;  double acc1, almx, xlim, xnt, xntm;
       double utx, tausq, sd, intv, intv1, x, up, un, d1, d2, lj, ncj;
-      extern double sigsq, lmax, lmin, mean;
-      extern double intl,ersm;
-      extern int r,lim; extern double c;
-      extern int *n,*th; extern double *lb,*nc;
       double qfval = -1.0;
-      static int rats[]={1,2,4,8};
-
-      if (setjmp(env) != 0) { *ifault=4; goto endofproc; }
-      r=r1[0]; lim=lim1[0]; c=c1[0];
-      n=n1; lb=lb1; nc=nc1;
+      static const int rats[]={1,2,4,8};
+      qfc_state state;
+      qfc_state* st = &state;
+      st->th = 0;
+
+      if (setjmp(st->env) != 0) { *ifault=4; goto endofproc; }
+      st->r=r1[0]; st->lim=lim1[0]; st->c=c1[0];
+      st->n=n1; st->lb=lb1; st->nc=nc1;
       for ( j = 0; j<7; j++ )  trace[j] = 0.0;
-      *ifault = 0; count = 0;
-      intl = 0.0; ersm = 0.0;
-      qfval = -1.0; acc1 = acc[0]; ndtsrt = TRUE;  fail = FALSE;
-      xlim = (double)lim;
-      th=(int*)malloc(r*(sizeof(int)));
-      if (! th) { *ifault=5;  goto  endofproc; } 
+      *ifault = 0; st->count = 0;
+      st->intl = 0.0; st->ersm = 0.0;
+      qfval = -1.0; acc1 = acc[0]; st->ndtsrt = TRUE;  st->fail = FALSE;
+      xlim = (double)st->lim;
+      st->th=(int*)malloc(st->r*(sizeof(int)));
+      if (! st->th) { *ifault=5;  goto  endofproc; } 
 
       /* find mean, sd, max and min of lb,
          check that parameter values are valid */
-      sigsq = square(sigma[0]); sd = sigsq;
-      lmax = 0.0; lmin = 0.0; mean = 0.0;
-      for (j=0; j<r; j++ )
+      st->sigsq = square(sigma[0]); sd = st->sigsq;
+      st->lmax = 0.0; st->lmin = 0.0; st->mean = 0.0;
+      for (j=0; j<st->r; j++ )
       {
-         nj = n[j];  lj = lb[j];  ncj = nc[j];
+         nj = st->n[j];  lj = st->lb[j];  ncj = st->nc[j];
          if ( nj < 0  ||  ncj < 0.0 ) { *ifault = 3;  goto  endofproc;  }
          sd  = sd  + square(lj) * (2 * nj + 4.0 * ncj);
-         mean = mean + lj * (nj + ncj);
-         if (lmax < lj) lmax = lj ; else if (lmin > lj) lmin = lj;
+         st->mean = st->mean + lj * (nj + ncj);
+         if (st->lmax < lj) st->lmax = lj ; else if (st->lmin > lj) st->lmin = lj;
       }
       if ( sd == 0.0  )
-      {  qfval = (c > 0.0) ? 1.0 : 0.0; goto  endofproc;  }
-      if ( lmin == 0.0 && lmax == 0.0 && sigma[0] == 0.0 )
+      {  qfval = (st->c > 0.0) ? 1.0 : 0.0; goto  endofproc;  }
+      if ( st->lmin == 0.0 && st->lmax == 0.0 && sigma[0] == 0.0 )
          { *ifault = 3;  goto  endofproc;  }
       sd = sqrt(sd);
-      almx = (lmax < - lmin) ? - lmin : lmax;
+      almx = (st->lmax < - st->lmin) ? - st->lmin : st->lmax;
 
       /* starting values for findu, ctff */
       utx = 16.0 / sd;  up = 4.5 / sd;  un = - up;
       /* truncation point with no convergence factor */
-      findu(&utx, .5 * acc1);
+      findu(st, &utx, .5 * acc1);
       /* does convergence factor help */
-      if (c != 0.0  && (almx > 0.07 * sd))
+      if (st->c != 0.0  && (almx > 0.07 * sd))
       {
-         tausq = .25 * acc1 / cfe(c);
-         if (fail) fail = FALSE ;
-         else if (truncation(utx, tausq) < .2 * acc1)
+         tausq = .25 * acc1 / cfe(st, st->c);
+         if (st->fail) st->fail = FALSE ;
+         else if (truncation(st, utx, tausq) < .2 * acc1)
          {
-            sigsq = sigsq + tausq;
-            findu(&utx, .25 * acc1);
+            st->sigsq = st->sigsq + tausq;
+            findu(st, &utx, .25 * acc1);
             trace[5] = sqrt(tausq);
          }
       }
@@ -345,9 +342,9 @@ output:
 
       /* find RANGE of distribution, quit if outside this */
    l1:
-      d1 = ctff(acc1, &up) - c;
+      d1 = ctff(st, acc1, &up) - st->c;
       if (d1 < 0.0) { qfval = 1.0; goto endofproc; }
-      d2 = c - ctff(acc1, &un);
+      d2 = st->c - ctff(st, acc1, &un);
       if (d2 < 0.0) { qfval = 0.0; goto endofproc; }
       /* find integration interval */
       intv = 2.0 * pi / ((d1 > d2) ? d1 : d2);
@@ -360,17 +357,17 @@ output:
          if (xntm > xlim) { *ifault = 1; goto endofproc; }
          ntm = (int)floor(xntm+0.5);
          intv1 = utx / ntm;  x = 2.0 * pi / intv1;
-         if (x <= fabs(c)) goto l2;
+         if (x <= fabs(st->c)) goto l2;
          /* calculate convergence factor */
-         tausq = .33 * acc1 / (1.1 * (cfe(c - x) + cfe(c + x)));
-         if (fail) goto l2;
+         tausq = .33 * acc1 / (1.1 * (cfe(st, st->c - x) + cfe(st, st->c + x)));
+         if (st->fail) goto l2;
          acc1 = .67 * acc1;
          /* auxillary integration */
-         integrate(ntm, intv1, tausq, FALSE );
-         xlim = xlim - xntm;  sigsq = sigsq + tausq;
+         integrate(st, ntm, intv1, tausq, FALSE );
+         xlim = xlim - xntm;  st->sigsq = st->sigsq + tausq;
          trace[2] = trace[2] + 1; trace[1] = trace[1] + ntm + 1;
          /* find truncation point with new convergence factor */
-         findu(&utx, .25 * acc1);  acc1 = 0.75 * acc1;
+         findu(st, &utx, .25 * acc1);  acc1 = 0.75 * acc1;
          goto l1;
       }
 
@@ -379,19 +376,19 @@ output:
       trace[3] = intv;
       if (xnt > xlim) { *ifault = 1; goto endofproc; }
       nt = (int)floor(xnt+0.5);
-      integrate(nt, intv, 0.0, TRUE );
+      integrate(st, nt, intv, 0.0, TRUE );
       trace[2] = trace[2] + 1; trace[1] = trace[1] + nt + 1;
-      qfval = 0.5 - intl;
-      trace[0] = ersm;
+      qfval = 0.5 - st->intl;
+      trace[0] = st->ersm;
 
       /* test whether round-off error could be significant
          allow for radix 8 or 16 machines */
-      up=ersm; x = up + acc[0] / 10.0;
+      up=st->ersm; x = up + acc[0] / 10.0;
       for (j=0;j<4;j++) { if (rats[j] * x == rats[j] * up) *ifault = 2; }
 
    endofproc :
-      free((char*)th);
-      trace[6] = (double)count;
+      free((char*)st->th);
+      trace[6] = (double)st->count;
       res[0] = qfval;
       return;
 }
@@ -0,0 +1,212 @@
+/*
+ * BGZFReader.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "BGZFReader.h"
+
+#include "ICompressedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/read.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+namespace {
+
+// Size of the fixed portion of a gzip header, up to and including XLEN
+const unsigned int GZ_HDR_LEN = 12;
+// Size of the gzip footer (CRC32 + ISIZE)
+const unsigned int GZ_FTR_LEN = 8;
+
+unsigned int readLE16(const unsigned char* p){
+	return p[0] | (p[1] << 8);
+}
+
+unsigned int readLE32(const unsigned char* p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<unsigned int>(p[3]) << 24);
+}
+
+bool isBGZFHeader(const unsigned char* hdr){
+	// gzip magic, deflate, FEXTRA set
+	return hdr[0] == 31 && hdr[1] == 139 && hdr[2] == 8 && (hdr[3] & 4);
+}
+
+}
+
+BGZFReader::BGZFReader() : _block_addr(0), _next_addr(0), _pos(0) {}
+
+BGZFReader::BGZFReader(const std::string& fn) : _block_addr(0), _next_addr(0), _pos(0) {
+	open(fn);
+}
+
+bool BGZFReader::open(const std::string& fn){
+	close();
+	_base_f.open(fn.c_str(), std::ios_base::in | std::ios_base::binary);
+	return _base_f.is_open();
+}
+
+void BGZFReader::close(){
+	if(_base_f.is_open()){
+		_base_f.close();
+	}
+	_base_f.clear();
+	_data.clear();
+	_block_addr = _next_addr = 0;
+	_pos = 0;
+}
+
+bool BGZFReader::seek(boost::uint64_t voffset){
+	boost::uint64_t addr = voffset >> 16;
+	std::size_t offset = static_cast<std::size_t>(voffset & 0xFFFF);
+
+	// Avoid re-reading the block if we are already in it
+	if(addr != _block_addr || _data.empty()){
+		_base_f.clear();
+		_base_f.seekg(static_cast<std::streamoff>(addr));
+		_next_addr = addr;
+		if(!loadBlock()){
+			return offset == 0;
+		}
+	}
+
+	if(offset > _data.size()){
+		return false;
+	}
+	_pos = offset;
+	return true;
+}
+
+boost::uint64_t BGZFReader::tell() const{
+	// At the end of a block, we are really at the start of the next one
+	if(_pos >= _data.size()){
+		return _next_addr << 16;
+	}
+	return (_block_addr << 16) | _pos;
+}
+
+std::size_t BGZFReader::read(char* buf, std::size_t n){
+	std::size_t n_read = 0;
+	while(n_read < n){
+		if(_pos >= _data.size()){
+			if(!loadBlock()){
+				break;
+			}
+			continue;
+		}
+		std::size_t amt = std::min(n - n_read, _data.size() - _pos);
+		memcpy(buf + n_read, &_data[_pos], amt);
+		_pos += amt;
+		n_read += amt;
+	}
+	return n_read;
+}
+
+bool BGZFReader::getline(std::string& line_out){
+	line_out.clear();
+	bool read_any = false;
+	while(true){
+		if(_pos >= _data.size()){
+			if(!loadBlock()){
+				return read_any;
+			}
+			continue;
+		}
+
+		read_any = true;
+		const char* begin = &_data[_pos];
+		std::size_t avail = _data.size() - _pos;
+		const char* nl = static_cast<const char*>(memchr(begin, '\n', avail));
+		if(nl){
+			line_out.append(begin, nl);
+			_pos += (nl - begin) + 1;
+			return true;
+		}
+		line_out.append(begin, avail);
+		_pos += avail;
+	}
+}
+
+bool BGZFReader::loadBlock(){
+	_block_addr = _next_addr;
+	_pos = 0;
+	if(!readBlock(_base_f, _compressed)){
+		_data.clear();
+		return false;
+	}
+	_next_addr = _block_addr + _compressed.size();
+	inflateBlock(_compressed, _data);
+	return true;
+}
+
+bool BGZFReader::readBlock(std::istream& f, std::vector<char>& buf_out){
+	buf_out.resize(GZ_HDR_LEN);
+	f.read(&buf_out[0], GZ_HDR_LEN);
+	if(f.gcount() == 0){
+		return false;
+	}
+
+	const unsigned char* hdr = reinterpret_cast<const unsigned char*>(&buf_out[0]);
+	if(f.gcount() != GZ_HDR_LEN || !isBGZFHeader(hdr)){
+		throw std::runtime_error("Malformed BGZF block header");
+	}
+
+	unsigned int xlen = readLE16(hdr + 10);
+	buf_out.resize(GZ_HDR_LEN + xlen);
+	if(!f.read(&buf_out[GZ_HDR_LEN], xlen)){
+		throw std::runtime_error("Truncated BGZF block header");
+	}
+
+	// BSIZE is the total block size - 1
+	const unsigned char* extra = reinterpret_cast<const unsigned char*>(&buf_out[GZ_HDR_LEN]);
+	unsigned int block_size = 0;
+	for(unsigned int i=0; i + 4 <= xlen; i += 4 + readLE16(extra + i + 2)){
+		if(extra[i] == 'B' && extra[i+1] == 'C' && readLE16(extra + i + 2) == 2 && i + 6 <= xlen){
+			block_size = readLE16(extra + i + 4) + 1;
+		}
+	}
+
+	if(block_size < GZ_HDR_LEN + xlen + GZ_FTR_LEN){
+		throw std::runtime_error("BGZF block is missing its size");
+	}
+
+	unsigned int remaining = block_size - GZ_HDR_LEN - xlen;
+	buf_out.resize(block_size);
+	if(!f.read(&buf_out[GZ_HDR_LEN + xlen], remaining)){
+		throw std::runtime_error("Truncated BGZF block");
+	}
+	return true;
+}
+
+void BGZFReader::inflateBlock(const std::vector<char>& compressed, std::vector<char>& data_out){
+	const unsigned char* ftr = reinterpret_cast<const unsigned char*>(
+			&compressed[compressed.size() - GZ_FTR_LEN]);
+	unsigned int isize = readLE32(ftr + 4);
+	data_out.resize(isize);
+	if(isize == 0){
+		return;
+	}
+
+	boost::iostreams::filtering_istreambuf inf;
+	inf.push(boost::iostreams::bgzip_decompressor());
+	inf.push(boost::iostreams::array_source(&compressed[0], compressed.size()));
+
+	std::streamsize n_read = 0;
+	while(n_read < static_cast<std::streamsize>(isize)){
+		std::streamsize amt = boost::iostreams::read(inf, &data_out[n_read], isize - n_read);
+		if(amt <= 0){
+			throw std::runtime_error("BGZF block shorter than expected");
+		}
+		n_read += amt;
+	}
+}
+
+}
+}
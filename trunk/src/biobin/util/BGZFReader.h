@@ -0,0 +1,93 @@
+/*
+ * BGZFReader.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_BGZFREADER_H
+#define BIOBIN_UTILITY_BGZFREADER_H
+
+#include <istream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief A random-access reader for BGZF files.
+ * Positions in a BGZF file are given as "virtual offsets", as used by tabix
+ * and CSI indexes: the upper 48 bits are the file offset of a compressed
+ * block and the lower 16 bits are the offset within the inflated block.
+ * This class allows seeking to a virtual offset and reading lines from there.
+ */
+class BGZFReader {
+public:
+	BGZFReader();
+	explicit BGZFReader(const std::string& fn);
+
+	bool open(const std::string& fn);
+	bool is_open() const {return _base_f.is_open();}
+	void close();
+
+	/*!
+	 * \brief Moves to the given virtual offset.
+	 * \return false if the offset does not point to a valid block.
+	 */
+	bool seek(boost::uint64_t voffset);
+
+	/*!
+	 * \brief Returns the virtual offset of the next byte to be read.
+	 */
+	boost::uint64_t tell() const;
+
+	/*!
+	 * \brief Reads up to n bytes, crossing block boundaries as needed.
+	 * \return The number of bytes read; less than n only at the end of file.
+	 */
+	std::size_t read(char* buf, std::size_t n);
+
+	/*!
+	 * \brief Reads the next line (without the newline).
+	 * \return false if at the end of the file.
+	 */
+	bool getline(std::string& line_out);
+
+	/*!
+	 * \brief Reads a single compressed BGZF block from the given stream.
+	 * \return false if the stream is at the end of the file; throws if the
+	 * block is malformed.
+	 */
+	static bool readBlock(std::istream& f, std::vector<char>& buf_out);
+
+	/*!
+	 * \brief Inflates a block read by readBlock; throws on error.
+	 */
+	static void inflateBlock(const std::vector<char>& compressed, std::vector<char>& data_out);
+
+private:
+	// No copying or assignment!
+	BGZFReader(const BGZFReader&);
+	BGZFReader& operator=(const BGZFReader&);
+
+	bool loadBlock();
+
+	std::ifstream _base_f;
+
+	std::vector<char> _compressed;
+	std::vector<char> _data;
+
+	// file offset of the current block and of the block after it
+	boost::uint64_t _block_addr;
+	boost::uint64_t _next_addr;
+	// position in _data
+	std::size_t _pos;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_BGZFREADER_H */
@@ -0,0 +1,278 @@
+/*
+ * BitCount.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "BitCount.h"
+
+#include <boost/cstdint.hpp>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BIOBIN_BITCOUNT_X86
+#include <immintrin.h>
+
+// AVX-512 VPOPCNTDQ intrinsics and CPU detection need a recent compiler
+#if (defined(__clang__) && __clang_major__ >= 8) || (!defined(__clang__) && __GNUC__ >= 8)
+#define BIOBIN_BITCOUNT_AVX512
+#endif
+#endif
+
+#ifdef __GNUC__
+#define BIOBIN_BITCOUNT_INLINE inline __attribute__((always_inline))
+#else
+#define BIOBIN_BITCOUNT_INLINE inline
+#endif
+
+namespace BioBin {
+namespace Utility {
+
+namespace {
+
+typedef BitCount::word_type word_type;
+
+/*
+ * Portable implementation.  The functions are always inlined so that the
+ * POPCNT wrappers below get the single-instruction popcount.
+ */
+
+BIOBIN_BITCOUNT_INLINE unsigned int popcount(word_type w){
+#ifdef __GNUC__
+	return __builtin_popcountl(w);
+#else
+	unsigned int c = 0;
+	for( ; w; c++){
+		w &= w - 1;
+	}
+	return c;
+#endif
+}
+
+BIOBIN_BITCOUNT_INLINE unsigned int countScalar(const word_type* a, std::size_t n){
+	unsigned int c = 0;
+	for(std::size_t i=0; i<n; i++){
+		c += popcount(a[i]);
+	}
+	return c;
+}
+
+BIOBIN_BITCOUNT_INLINE void countGenotypesScalar(const word_type* first, const word_type* second,
+		const word_type* mask, std::size_t n,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out){
+	for(std::size_t i=0; i<n; i++){
+		word_type nonmissing = ~(first[i] & second[i]) & mask[i];
+		n_nonmiss_out += popcount(nonmissing);
+		n_first_out += popcount(nonmissing & first[i]);
+		n_second_out += popcount(nonmissing & second[i]);
+	}
+}
+
+unsigned int countGeneric(const word_type* a, std::size_t n){
+	return countScalar(a, n);
+}
+
+void countGenotypesGeneric(const word_type* first, const word_type* second,
+		const word_type* mask, std::size_t n,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out){
+	n_nonmiss_out = n_first_out = n_second_out = 0;
+	countGenotypesScalar(first, second, mask, n, n_nonmiss_out, n_first_out, n_second_out);
+}
+
+#ifdef BIOBIN_BITCOUNT_X86
+
+/*
+ * POPCNT implementation: the portable loops, compiled for the instruction
+ */
+
+__attribute__((target("popcnt")))
+unsigned int countPopcnt(const word_type* a, std::size_t n){
+	return countScalar(a, n);
+}
+
+__attribute__((target("popcnt")))
+void countGenotypesPopcnt(const word_type* first, const word_type* second,
+		const word_type* mask, std::size_t n,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out){
+	n_nonmiss_out = n_first_out = n_second_out = 0;
+	countGenotypesScalar(first, second, mask, n, n_nonmiss_out, n_first_out, n_second_out);
+}
+
+/*
+ * AVX2 implementation.  AVX2 has no vector popcount, so count the bits of
+ * each nibble with a table lookup (vpshufb), then sum the bytes of each
+ * 64-bit lane with vpsadbw (W. Mula, "Faster population counts using AVX2
+ * instructions").  Any words left over are counted one at a time.
+ */
+
+const std::size_t AVX2_WORDS = sizeof(__m256i) / sizeof(word_type);
+
+__attribute__((target("avx2,popcnt"))) BIOBIN_BITCOUNT_INLINE
+__m256i popcount256(__m256i v){
+	const __m256i lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+	__m256i lo = _mm256_and_si256(v, low_mask);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+	__m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+			_mm256_shuffle_epi8(lookup, hi));
+	return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2,popcnt"))) BIOBIN_BITCOUNT_INLINE
+unsigned int sum256(__m256i v){
+	__m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	return static_cast<unsigned int>(_mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1));
+}
+
+__attribute__((target("avx2,popcnt"))) BIOBIN_BITCOUNT_INLINE
+__m256i load256(const word_type* p){
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2,popcnt")))
+unsigned int countAVX2(const word_type* a, std::size_t n){
+	__m256i acc = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for( ; i + AVX2_WORDS <= n; i += AVX2_WORDS){
+		acc = _mm256_add_epi64(acc, popcount256(load256(a + i)));
+	}
+	return sum256(acc) + countScalar(a + i, n - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+void countGenotypesAVX2(const word_type* first, const word_type* second,
+		const word_type* mask, std::size_t n,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out){
+	__m256i acc_nonmiss = _mm256_setzero_si256();
+	__m256i acc_first = _mm256_setzero_si256();
+	__m256i acc_second = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for( ; i + AVX2_WORDS <= n; i += AVX2_WORDS){
+		__m256i f = load256(first + i);
+		__m256i s = load256(second + i);
+		__m256i nonmissing = _mm256_andnot_si256(_mm256_and_si256(f, s), load256(mask + i));
+		acc_nonmiss = _mm256_add_epi64(acc_nonmiss, popcount256(nonmissing));
+		acc_first = _mm256_add_epi64(acc_first, popcount256(_mm256_and_si256(nonmissing, f)));
+		acc_second = _mm256_add_epi64(acc_second, popcount256(_mm256_and_si256(nonmissing, s)));
+	}
+	n_nonmiss_out = sum256(acc_nonmiss);
+	n_first_out = sum256(acc_first);
+	n_second_out = sum256(acc_second);
+	countGenotypesScalar(first + i, second + i, mask + i, n - i,
+			n_nonmiss_out, n_first_out, n_second_out);
+}
+
+#ifdef BIOBIN_BITCOUNT_AVX512
+
+/*
+ * AVX-512 implementation, using the vector popcount of VPOPCNTDQ
+ */
+
+const std::size_t AVX512_WORDS = sizeof(__m512i) / sizeof(word_type);
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt"))) BIOBIN_BITCOUNT_INLINE
+__m512i load512(const word_type* p){
+	return _mm512_loadu_si512(reinterpret_cast<const void*>(p));
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt"))) BIOBIN_BITCOUNT_INLINE
+unsigned int sum512(__m512i v){
+	boost::uint64_t lanes[8];
+	_mm512_storeu_si512(reinterpret_cast<void*>(lanes), v);
+	boost::uint64_t s = 0;
+	for(int i=0; i<8; i++){
+		s += lanes[i];
+	}
+	return static_cast<unsigned int>(s);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+unsigned int countAVX512(const word_type* a, std::size_t n){
+	__m512i acc = _mm512_setzero_si512();
+	std::size_t i = 0;
+	for( ; i + AVX512_WORDS <= n; i += AVX512_WORDS){
+		acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(load512(a + i)));
+	}
+	return sum512(acc) + countScalar(a + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+void countGenotypesAVX512(const word_type* first, const word_type* second,
+		const word_type* mask, std::size_t n,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out){
+	__m512i acc_nonmiss = _mm512_setzero_si512();
+	__m512i acc_first = _mm512_setzero_si512();
+	__m512i acc_second = _mm512_setzero_si512();
+	std::size_t i = 0;
+	for( ; i + AVX512_WORDS <= n; i += AVX512_WORDS){
+		__m512i f = load512(first + i);
+		__m512i s = load512(second + i);
+		__m512i m = load512(mask + i);
+		// m & ~(f & s)
+		__m512i nonmissing = _mm512_xor_si512(m, _mm512_and_si512(m, _mm512_and_si512(f, s)));
+		acc_nonmiss = _mm512_add_epi64(acc_nonmiss, _mm512_popcnt_epi64(nonmissing));
+		acc_first = _mm512_add_epi64(acc_first, _mm512_popcnt_epi64(_mm512_and_si512(nonmissing, f)));
+		acc_second = _mm512_add_epi64(acc_second, _mm512_popcnt_epi64(_mm512_and_si512(nonmissing, s)));
+	}
+	n_nonmiss_out = sum512(acc_nonmiss);
+	n_first_out = sum512(acc_first);
+	n_second_out = sum512(acc_second);
+	countGenotypesScalar(first + i, second + i, mask + i, n - i,
+			n_nonmiss_out, n_first_out, n_second_out);
+}
+
+#endif /* BIOBIN_BITCOUNT_AVX512 */
+
+#endif /* BIOBIN_BITCOUNT_X86 */
+
+struct Impl{
+	unsigned int (*count)(const word_type*, std::size_t);
+	void (*countGenotypes)(const word_type*, const word_type*, const word_type*, std::size_t,
+			unsigned int&, unsigned int&, unsigned int&);
+};
+
+Impl selectImpl(){
+	Impl impl = {&countGeneric, &countGenotypesGeneric};
+
+#ifdef BIOBIN_BITCOUNT_X86
+	__builtin_cpu_init();
+#ifdef BIOBIN_BITCOUNT_AVX512
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")){
+		Impl avx512 = {&countAVX512, &countGenotypesAVX512};
+		return avx512;
+	}
+#endif
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")){
+		Impl avx2 = {&countAVX2, &countGenotypesAVX2};
+		return avx2;
+	}
+	if(__builtin_cpu_supports("popcnt")){
+		Impl popcnt = {&countPopcnt, &countGenotypesPopcnt};
+		return popcnt;
+	}
+#endif
+
+	return impl;
+}
+
+const Impl& getImpl(){
+	static const Impl impl = selectImpl();
+	return impl;
+}
+
+}
+
+unsigned int BitCount::count(const word_type* a, std::size_t n){
+	return getImpl().count(a, n);
+}
+
+void BitCount::countGenotypes(const word_type* first, const word_type* second,
+		const word_type* mask, std::size_t n,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out){
+	getImpl().countGenotypes(first, second, mask, n, n_nonmiss_out, n_first_out, n_second_out);
+}
+
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * BitCount.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_BITCOUNT_H
+#define BIOBIN_UTILITY_BITCOUNT_H
+
+#include <cstddef>
+
+#include <boost/dynamic_bitset.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief Population counts over spans of bitset words.
+ * Each function counts a whole span in one pass, combining the operands
+ * word by word, so no temporary bitsets are ever created.
+ *
+ * The implementation is chosen once, at the first call, from the
+ * instructions supported by the running CPU: AVX-512 (VPOPCNTDQ), AVX2,
+ * the POPCNT instruction or portable C++.  All implementations give the
+ * same results.
+ */
+class BitCount {
+public:
+	typedef boost::dynamic_bitset<>::block_type word_type;
+
+	//! count(a)
+	static unsigned int count(const word_type* a, std::size_t n);
+
+	/*!
+	 * \brief Counts the genotypes of the samples in a mask, encoded as in
+	 * PopulationManager (both bits set = missing).
+	 *
+	 * With nonmiss = mask & ~(first & second), gives count(nonmiss),
+	 * count(nonmiss & first) and count(nonmiss & second).
+	 */
+	static void countGenotypes(const word_type* first, const word_type* second,
+			const word_type* mask, std::size_t n,
+			unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out);
+
+private:
+	BitCount();
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_BITCOUNT_H */
@@ -0,0 +1,182 @@
+/*
+ * GenotypeCache.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "GenotypeCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace BioBin {
+namespace Utility {
+
+namespace {
+
+const char BBG_MAGIC[4] = {'B', 'B', 'G', '1'};
+
+struct BBGHeader{
+	char magic[4];
+	boost::uint32_t block_size;
+	boost::uint64_t key;
+	boost::uint32_t n_samples;
+	boost::uint32_t n_loci;
+	boost::uint32_t n_unlifted;
+};
+
+template <typename T>
+void writeVal(std::ostream& o, const T& val){
+	o.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+}
+
+GenotypeCache::GenotypeCache() : _key(0), _n_samples(0), _n_loci(0),
+		_n_unlifted(0), _pos(0) {}
+
+bool GenotypeCache::open(const std::string& fn, boost::uint64_t key, unsigned int n_samples){
+	_fn = fn;
+	if(!_map.open(fn)){
+		return false;
+	}
+	if(_map.size() < sizeof(BBGHeader)){
+		_map.close();
+		return false;
+	}
+
+	BBGHeader hdr;
+	memcpy(&hdr, _map.begin(), sizeof(BBGHeader));
+	if(memcmp(hdr.magic, BBG_MAGIC, sizeof(BBG_MAGIC)) != 0
+			|| hdr.block_size != sizeof(bitset::block_type)
+			|| hdr.key != key || hdr.n_samples != n_samples){
+		_map.close();
+		return false;
+	}
+
+	_key = key;
+	_n_samples = n_samples;
+	_n_loci = hdr.n_loci;
+	_n_unlifted = hdr.n_unlifted;
+	_pos = _map.begin() + sizeof(BBGHeader);
+	return true;
+}
+
+const char* GenotypeCache::advance(std::size_t n){
+	if(static_cast<std::size_t>(_map.end() - _pos) < n){
+		std::cerr << "ERROR: Genotype cache " << _fn << " is truncated; "
+				<< "please remove it and try again" << std::endl;
+		throw std::runtime_error("Truncated genotype cache");
+	}
+	const char* p = _pos;
+	_pos += n;
+	return p;
+}
+
+void GenotypeCache::readRecord(Record& rec_out){
+	boost::uint16_t chrom;
+	boost::uint32_t pos, id_len;
+	memcpy(&chrom, advance(sizeof(chrom)), sizeof(chrom));
+	memcpy(&pos, advance(sizeof(pos)), sizeof(pos));
+	memcpy(&id_len, advance(sizeof(id_len)), sizeof(id_len));
+	const char* id = advance(id_len);
+
+	rec_out.chrom = chrom;
+	rec_out.pos = pos;
+	rec_out.id.assign(id, id + id_len);
+}
+
+const GenotypeCache::word_type* GenotypeCache::readLocus(Record& rec_out){
+	readRecord(rec_out);
+
+	std::size_t n_words = 2 * getNumWords();
+	const char* data = advance(n_words * sizeof(word_type));
+
+	// copied, as the mapped data is not necessarily aligned
+	_words.resize(n_words);
+	if(n_words){
+		memcpy(&_words[0], data, n_words * sizeof(word_type));
+	}
+	return n_words ? &_words[0] : 0;
+}
+
+void GenotypeCache::readUnlifted(Record& rec_out){
+	readRecord(rec_out);
+}
+
+bool GenotypeCache::create(const std::string& fn, boost::uint64_t key, unsigned int n_samples){
+	_fn = fn;
+	_key = key;
+	_n_samples = n_samples;
+	_n_loci = 0;
+	_n_unlifted = 0;
+	_unlifted.clear();
+
+	std::string tmp_fn = fn + ".tmp";
+	_out.open(tmp_fn.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!_out.is_open()){
+		std::cerr << "WARNING: Unable to write genotype cache " << fn << std::endl;
+		return false;
+	}
+
+	// The counts are filled in by finish()
+	BBGHeader hdr;
+	memset(&hdr, 0, sizeof(BBGHeader));
+	_out.write(reinterpret_cast<const char*>(&hdr), sizeof(BBGHeader));
+	return true;
+}
+
+void GenotypeCache::writeRecord(unsigned short chrom, unsigned int pos, const std::string& id){
+	writeVal(_out, static_cast<boost::uint16_t>(chrom));
+	writeVal(_out, static_cast<boost::uint32_t>(pos));
+	writeVal(_out, static_cast<boost::uint32_t>(id.size()));
+	_out.write(id.data(), id.size());
+}
+
+void GenotypeCache::writeLocus(unsigned short chrom, unsigned int pos, const std::string& id,
+		const word_type* first, const word_type* second){
+	writeRecord(chrom, pos, id);
+	_out.write(reinterpret_cast<const char*>(first), getNumWords() * sizeof(word_type));
+	_out.write(reinterpret_cast<const char*>(second), getNumWords() * sizeof(word_type));
+	++_n_loci;
+}
+
+void GenotypeCache::writeUnlifted(unsigned short chrom, unsigned int pos, const std::string& id){
+	Record r;
+	r.chrom = chrom;
+	r.pos = pos;
+	r.id = id;
+	_unlifted.push_back(r);
+}
+
+bool GenotypeCache::finish(){
+	std::vector<Record>::const_iterator itr = _unlifted.begin();
+	for( ; itr != _unlifted.end(); ++itr){
+		writeRecord((*itr).chrom, (*itr).pos, (*itr).id);
+	}
+	_n_unlifted = _unlifted.size();
+
+	BBGHeader hdr;
+	memcpy(hdr.magic, BBG_MAGIC, sizeof(BBG_MAGIC));
+	hdr.block_size = sizeof(bitset::block_type);
+	hdr.key = _key;
+	hdr.n_samples = _n_samples;
+	hdr.n_loci = _n_loci;
+	hdr.n_unlifted = _n_unlifted;
+	_out.seekp(0);
+	_out.write(reinterpret_cast<const char*>(&hdr), sizeof(BBGHeader));
+	_out.close();
+
+	std::string tmp_fn = _fn + ".tmp";
+	if(_out.fail() || std::rename(tmp_fn.c_str(), _fn.c_str()) != 0){
+		std::cerr << "WARNING: Unable to write genotype cache " << _fn << std::endl;
+		std::remove(tmp_fn.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
+}
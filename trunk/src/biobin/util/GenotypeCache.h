@@ -0,0 +1,116 @@
+/*
+ * GenotypeCache.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_GENOTYPECACHE_H
+#define BIOBIN_UTILITY_GENOTYPECACHE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <boost/cstdint.hpp>
+#include <boost/dynamic_bitset.hpp>
+
+#include "MappedFile.h"
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief A binary cache of the loci and genotypes loaded from a VCF.
+ * Parsing a large VCF is by far the slowest part of startup, so the loci
+ * (after liftover and filtering) and their genotype bit-planes can be saved
+ * to a ".bbg" file and mapped back in on later runs.  The file is tagged
+ * with a key that the caller computes from everything that affects the
+ * loaded data; a cache with a different key is ignored.
+ *
+ * Layout (native byte order):
+ *   header: "BBG1", uint32 bitset block size, uint64 key, uint32 n_samples,
+ *           uint32 n_loci, uint32 n_unlifted
+ *   n_loci records: uint16 chrom, uint32 pos, uint32 id length, id,
+ *           then both genotype bit-planes as bitset blocks
+ *   n_unlifted records: uint16 chrom, uint32 pos, uint32 id length, id
+ */
+class GenotypeCache {
+public:
+	typedef boost::dynamic_bitset<> bitset;
+	typedef bitset::block_type word_type;
+
+	struct Record{
+		Record() : chrom(0), pos(0) {}
+		unsigned short chrom;
+		unsigned int pos;
+		std::string id;
+	};
+
+	GenotypeCache();
+
+	/*!
+	 * \brief Maps an existing cache file.
+	 * \return false if the file does not exist or was written with a
+	 * different key or number of samples.
+	 */
+	bool open(const std::string& fn, boost::uint64_t key, unsigned int n_samples);
+
+	unsigned int getNumLoci() const {return _n_loci;}
+	unsigned int getNumUnlifted() const {return _n_unlifted;}
+
+	//! The number of words in each genotype bit-plane
+	unsigned int getNumWords() const {return (_n_samples + bitset::bits_per_block - 1) / bitset::bits_per_block;}
+
+	/*!
+	 * \brief Reads the next locus; throws if the file is truncated.
+	 * All loci are read before any unlifted loci.
+	 *
+	 * \return Both bit-planes of the locus, one after the other.  Valid
+	 * until the next call.
+	 */
+	const word_type* readLocus(Record& rec_out);
+	void readUnlifted(Record& rec_out);
+
+	/*!
+	 * \brief Starts writing a new cache file.
+	 * The data is written to a temporary file that replaces fn on finish(),
+	 * so an interrupted run never leaves a partial cache behind.
+	 */
+	bool create(const std::string& fn, boost::uint64_t key, unsigned int n_samples);
+
+	void writeLocus(unsigned short chrom, unsigned int pos, const std::string& id,
+			const word_type* first, const word_type* second);
+	void writeUnlifted(unsigned short chrom, unsigned int pos, const std::string& id);
+
+	bool finish();
+
+private:
+	// No copying or assignment!
+	GenotypeCache(const GenotypeCache&);
+	GenotypeCache& operator=(const GenotypeCache&);
+
+	void readRecord(Record& rec_out);
+	const char* advance(std::size_t n);
+
+	void writeRecord(unsigned short chrom, unsigned int pos, const std::string& id);
+
+	std::string _fn;
+	boost::uint64_t _key;
+	unsigned int _n_samples;
+	unsigned int _n_loci;
+	unsigned int _n_unlifted;
+
+	// reading
+	MappedFile _map;
+	const char* _pos;
+	std::vector<word_type> _words;
+
+	// writing
+	std::ofstream _out;
+	std::vector<Record> _unlifted;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_GENOTYPECACHE_H */
@@ -0,0 +1,257 @@
+/*
+ * GenotypeStore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "GenotypeStore.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <new>
+
+#include "BitCount.h"
+
+namespace BioBin {
+namespace Utility {
+
+namespace {
+
+// Size of a cache line, in bytes
+const std::size_t CACHE_LINE = 64;
+const std::size_t WORDS_PER_LINE = CACHE_LINE / sizeof(GenotypeStore::word_type);
+
+// Bytes used by each sample in a sparse locus
+const std::size_t SPARSE_ENTRY_SIZE = sizeof(boost::uint32_t) + sizeof(unsigned char);
+
+unsigned int lowestBit(GenotypeStore::word_type w){
+#ifdef __GNUC__
+	return __builtin_ctzl(w);
+#else
+	unsigned int b = 0;
+	for( ; !(w & 1); w >>= 1){
+		++b;
+	}
+	return b;
+#endif
+}
+
+}
+
+const unsigned int GenotypeStore::BITS_PER_WORD;
+const unsigned char GenotypeStore::REF;
+const unsigned char GenotypeStore::HET;
+const unsigned char GenotypeStore::HOM;
+const unsigned char GenotypeStore::MISSING;
+const boost::uint32_t GenotypeStore::DENSE;
+
+GenotypeStore::GenotypeStore() : _data(0), _capacity(0), _n_dense(0),
+		_n_samples(0), _n_words(0), _stride(0) {}
+
+GenotypeStore::~GenotypeStore(){
+	free(_data);
+}
+
+void GenotypeStore::reset(unsigned int n_samples){
+	free(_data);
+	_data = 0;
+	_capacity = 0;
+	_n_dense = 0;
+	_loci.clear();
+	_samples.clear();
+	_codes.clear();
+
+	_n_samples = n_samples;
+	_n_words = (n_samples + BITS_PER_WORD - 1) / BITS_PER_WORD;
+	_stride = ((2 * _n_words + WORDS_PER_LINE - 1) / WORDS_PER_LINE) * WORDS_PER_LINE;
+
+	_all.assign(_n_words, ~static_cast<word_type>(0));
+	if(n_samples % BITS_PER_WORD){
+		_all.back() = (static_cast<word_type>(1) << (n_samples % BITS_PER_WORD)) - 1;
+	}
+}
+
+void GenotypeStore::grow(){
+	std::size_t new_cap = _capacity ? 2 * _capacity : 1024;
+	void* new_data = 0;
+	if(posix_memalign(&new_data, CACHE_LINE, new_cap * _stride * sizeof(word_type)) != 0){
+		throw std::bad_alloc();
+	}
+	if(_data){
+		memcpy(new_data, _data, _n_dense * _stride * sizeof(word_type));
+		free(_data);
+	}
+	_data = static_cast<word_type*>(new_data);
+	_capacity = new_cap;
+}
+
+GenotypeStore::word_type* GenotypeStore::allocate(){
+	if(_n_dense == _capacity){
+		grow();
+	}
+	word_type* locus_data = _data + _n_dense * _stride;
+	memset(locus_data, 0, _stride * sizeof(word_type));
+	return locus_data;
+}
+
+unsigned int GenotypeStore::add(const word_type* first, const word_type* second){
+	unsigned int n_nonmiss, n_first, n_second;
+	BitCount::countGenotypes(first, second, _n_words ? &_all[0] : 0, _n_words,
+			n_nonmiss, n_first, n_second);
+
+	Entry e;
+	e.n_carriers = n_first + n_second;
+	e.n_missing = _n_samples - n_nonmiss;
+
+	if((e.n_carriers + e.n_missing) * SPARSE_ENTRY_SIZE < _stride * sizeof(word_type)){
+		e.offset = _samples.size();
+		// carriers first, then the missing samples, both in sample order
+		for(unsigned int i=0; i<_n_words; i++){
+			word_type missing = first[i] & second[i];
+			word_type w = (first[i] | second[i]) & ~missing;
+			for( ; w; w &= w - 1){
+				unsigned int b = lowestBit(w);
+				_samples.push_back(i * BITS_PER_WORD + b);
+				_codes.push_back(((first[i] >> b) & 1) ? HOM : HET);
+			}
+		}
+		for(unsigned int i=0; i<_n_words; i++){
+			for(word_type w = first[i] & second[i]; w; w &= w - 1){
+				_samples.push_back(i * BITS_PER_WORD + lowestBit(w));
+				_codes.push_back(MISSING);
+			}
+		}
+	} else {
+		word_type* locus_data = allocate();
+		if(_n_words){
+			memcpy(locus_data, first, _n_words * sizeof(word_type));
+			memcpy(locus_data + _n_words, second, _n_words * sizeof(word_type));
+		}
+		e.offset = _n_dense++;
+		e.n_carriers = DENSE;
+	}
+
+	_loci.push_back(e);
+	return _loci.size() - 1;
+}
+
+unsigned int GenotypeStore::add(const boost::dynamic_bitset<>& first, const boost::dynamic_bitset<>& second){
+	std::vector<word_type> second_words;
+	getWords(first, _scratch);
+	getWords(second, second_words);
+	return add(_n_words ? &_scratch[0] : 0, _n_words ? &second_words[0] : 0);
+}
+
+unsigned char GenotypeStore::get(unsigned int ord, unsigned int pos) const{
+	const Entry& e = _loci[ord];
+	if(e.n_carriers == DENSE){
+		const word_type* locus_data = _data + e.offset * _stride;
+		return 2 * testBit(locus_data, pos) + testBit(locus_data + _n_words, pos);
+	}
+
+	std::vector<boost::uint32_t>::const_iterator begin = _samples.begin() + e.offset;
+	std::vector<boost::uint32_t>::const_iterator mid = begin + e.n_carriers;
+	std::vector<boost::uint32_t>::const_iterator end = mid + e.n_missing;
+
+	std::vector<boost::uint32_t>::const_iterator itr = std::lower_bound(begin, mid, pos);
+	if(itr != mid && *itr == pos){
+		return _codes[itr - _samples.begin()];
+	}
+	itr = std::lower_bound(mid, end, pos);
+	return (itr != end && *itr == pos) ? MISSING : REF;
+}
+
+void GenotypeStore::count(unsigned int ord, const word_type* mask, unsigned int n_mask,
+		unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out) const{
+
+	n_nonmiss_out = n_first_out = n_second_out = 0;
+
+	const Entry& e = _loci[ord];
+	if(e.n_carriers == DENSE){
+		const word_type* first = _data + e.offset * _stride;
+		const word_type* second = first + _n_words;
+		if(mask == 0){
+			mask = _n_words ? &_all[0] : 0;
+		}
+		BitCount::countGenotypes(first, second, mask, _n_words,
+				n_nonmiss_out, n_first_out, n_second_out);
+		return;
+	}
+
+	unsigned int end = e.offset + e.n_carriers;
+	for(unsigned int i=e.offset; i<end; i++){
+		if(mask == 0 || testBit(mask, _samples[i])){
+			n_first_out += (_codes[i] == HOM);
+			n_second_out += (_codes[i] == HET);
+		}
+	}
+
+	unsigned int n_missing = e.n_missing;
+	if(mask != 0){
+		n_missing = 0;
+		for(unsigned int i=end; i<end + e.n_missing; i++){
+			n_missing += testBit(mask, _samples[i]);
+		}
+	}
+	n_nonmiss_out = (mask ? n_mask : _n_samples) - n_missing;
+}
+
+void GenotypeStore::getCarriers(unsigned int ord,
+		std::vector<std::pair<unsigned int, unsigned char> >& carriers_out) const{
+
+	const Entry& e = _loci[ord];
+	if(e.n_carriers == DENSE){
+		const word_type* first = _data + e.offset * _stride;
+		const word_type* second = first + _n_words;
+		for(unsigned int i=0; i<_n_words; i++){
+			word_type w = (first[i] | second[i]) & ~(first[i] & second[i]);
+			for( ; w; w &= w - 1){
+				unsigned int b = lowestBit(w);
+				carriers_out.push_back(std::make_pair(i * BITS_PER_WORD + b,
+						((first[i] >> b) & 1) ? HOM : HET));
+			}
+		}
+		return;
+	}
+
+	for(unsigned int i=e.offset; i<e.offset + e.n_carriers; i++){
+		carriers_out.push_back(std::make_pair(_samples[i], _codes[i]));
+	}
+}
+
+void GenotypeStore::getWords(unsigned int ord, std::vector<word_type>& words_out) const{
+	const Entry& e = _loci[ord];
+	if(e.n_carriers == DENSE){
+		const word_type* locus_data = _data + e.offset * _stride;
+		words_out.assign(locus_data, locus_data + 2 * _n_words);
+		return;
+	}
+
+	words_out.assign(2 * _n_words, 0);
+	for(unsigned int i=e.offset; i<e.offset + e.n_carriers + e.n_missing; i++){
+		word_type bit = static_cast<word_type>(1) << (_samples[i] % BITS_PER_WORD);
+		unsigned int w = _samples[i] / BITS_PER_WORD;
+		if(_codes[i] != HET){
+			words_out[w] |= bit;
+		}
+		if(_codes[i] != HOM){
+			words_out[_n_words + w] |= bit;
+		}
+	}
+}
+
+unsigned int GenotypeStore::getWords(const boost::dynamic_bitset<>& bits, std::vector<word_type>& words_out) const{
+	words_out.clear();
+	boost::to_block_range(bits, std::back_inserter(words_out));
+	words_out.resize(_n_words, 0);
+	if(_n_words){
+		words_out.back() &= _all.back();
+	}
+
+	return _n_words ? BitCount::count(&words_out[0], _n_words) : 0;
+}
+
+}
+}
@@ -0,0 +1,157 @@
+/*
+ * GenotypeStore.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_GENOTYPESTORE_H
+#define BIOBIN_UTILITY_GENOTYPESTORE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/dynamic_bitset.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief Compact storage for the genotypes of every locus.
+ * Each locus is identified by the dense ordinal returned from add().  The
+ * genotypes of a sample are encoded as in PopulationManager, with the two
+ * bits combined into a single code: 0 = reference, 1 = heterozygous,
+ * 2 = homozygous alternate and 3 = missing.
+ *
+ * Loci are stored in one of two forms, chosen when the locus is added:
+ *  - Sparse: loci with few non-reference or missing samples (i.e. nearly all
+ *    rare variants) keep a sorted list of carriers with their codes,
+ *    followed by a sorted list of the missing samples.
+ *  - Dense: all other loci keep both bit-planes one after the other in a
+ *    single cache-line aligned array of words, with the per-locus stride
+ *    rounded up to a whole number of cache lines.
+ * A locus is stored sparsely whenever its lists take less space than its
+ * bit-planes would, so the memory used scales with the number of carriers.
+ *
+ * The words are dynamic_bitset blocks, so bitsets can be copied in and out
+ * with to_block_range and append.  Bits past the number of samples are
+ * always 0.
+ */
+class GenotypeStore {
+public:
+	typedef boost::dynamic_bitset<>::block_type word_type;
+
+	static const unsigned int BITS_PER_WORD = boost::dynamic_bitset<>::bits_per_block;
+
+	//! Genotype codes
+	static const unsigned char REF = 0;
+	static const unsigned char HET = 1;
+	static const unsigned char HOM = 2;
+	static const unsigned char MISSING = 3;
+
+	GenotypeStore();
+	~GenotypeStore();
+
+	/*!
+	 * \brief Clears the store and sets the number of samples per locus.
+	 */
+	void reset(unsigned int n_samples);
+
+	/*!
+	 * \brief Adds the genotypes of a locus.
+	 * \return The ordinal of the locus.
+	 */
+	unsigned int add(const boost::dynamic_bitset<>& first, const boost::dynamic_bitset<>& second);
+	/*!
+	 * \brief Adds the genotypes of a locus, given getNumWords() words of
+	 * each bit-plane.
+	 */
+	unsigned int add(const word_type* first, const word_type* second);
+
+	unsigned int size() const {return _loci.size();}
+	unsigned int getNumSamples() const {return _n_samples;}
+	//! The number of words in each bit-plane
+	unsigned int getNumWords() const {return _n_words;}
+	//! The number of loci stored in the sparse form
+	unsigned int getNumSparse() const {return _loci.size() - _n_dense;}
+
+	/*!
+	 * \brief Returns the genotype code of the sample at the given position.
+	 */
+	unsigned char get(unsigned int ord, unsigned int pos) const;
+
+	/*!
+	 * \brief Counts the samples in the mask that are non-missing,
+	 * homozygous (first bit-plane) or heterozygous (second bit-plane).
+	 * \param mask getNumWords() words, as given by getWords, or NULL to
+	 * count every sample
+	 * \param n_mask the number of samples in the mask
+	 */
+	void count(unsigned int ord, const word_type* mask, unsigned int n_mask,
+			unsigned int& n_nonmiss_out, unsigned int& n_first_out, unsigned int& n_second_out) const;
+
+	/*!
+	 * \brief Appends the position and genotype code of every non-missing,
+	 * non-reference sample to carriers_out, in sample order.
+	 */
+	void getCarriers(unsigned int ord, std::vector<std::pair<unsigned int, unsigned char> >& carriers_out) const;
+
+	/*!
+	 * \brief Copies both bit-planes of a locus, one after the other, into
+	 * words_out.
+	 */
+	void getWords(unsigned int ord, std::vector<word_type>& words_out) const;
+
+	/*!
+	 * \brief Copies the blocks of a bitset into words_out, padding or
+	 * truncating to exactly getNumSamples() bits.
+	 * \return The number of bits set
+	 */
+	unsigned int getWords(const boost::dynamic_bitset<>& bits, std::vector<word_type>& words_out) const;
+
+private:
+	// No copying or assignment!
+	GenotypeStore(const GenotypeStore&);
+	GenotypeStore& operator=(const GenotypeStore&);
+
+	/*
+	 * Location of a locus' genotypes.  For a dense locus, offset is the
+	 * row in _data; for a sparse locus, it is the index of the first carrier
+	 * in _samples and _codes, with the missing samples following the carriers.
+	 */
+	struct Entry{
+		boost::uint32_t offset;
+		boost::uint32_t n_carriers;
+		boost::uint32_t n_missing;
+	};
+
+	static const boost::uint32_t DENSE = static_cast<boost::uint32_t>(-1);
+
+	static bool testBit(const word_type* w, unsigned int pos){
+		return (w[pos / BITS_PER_WORD] >> (pos % BITS_PER_WORD)) & 1;
+	}
+
+	word_type* allocate();
+	void grow();
+
+	word_type* _data;
+	std::size_t _capacity;
+	unsigned int _n_dense;
+
+	std::vector<Entry> _loci;
+	std::vector<boost::uint32_t> _samples;
+	std::vector<unsigned char> _codes;
+
+	unsigned int _n_samples;
+	unsigned int _n_words;
+	unsigned int _stride;
+
+	std::vector<word_type> _all;
+	std::vector<word_type> _scratch;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_GENOTYPESTORE_H */
@@ -6,6 +6,7 @@
  */
 
 #include "ICompressedFile.h"
+#include "ParallelBGZFBuf.h"
 
 #include <string>
 
@@ -18,18 +19,30 @@ namespace Utility {
 
 ICompressedFile::ICompressedFile() : std::ios(), std::istream(&_infile){}
 
-ICompressedFile::ICompressedFile(const char* fn, std::ios_base::openmode mode)
+ICompressedFile::ICompressedFile(const char* fn, std::ios_base::openmode mode, unsigned int n_threads)
 	: std::ios(), std::istream(&_infile) {
-	this->open(fn, mode);
+	this->open(fn, mode, n_threads);
 }
 
-void ICompressedFile::open(const char* fn, std::ios_base::openmode mode){
+ICompressedFile::~ICompressedFile(){
+	// make sure the worker threads are gone before the streambuf goes away
+	rdbuf(&_infile);
+	_parallel_buf.reset();
+}
+
+void ICompressedFile::open(const char* fn, std::ios_base::openmode mode, unsigned int n_threads){
 	int extPos = std::string(fn).find_last_of('.');
 	std::string ext = std::string(fn).substr(extPos+1);
 
 	bool isgz = (boost::iequals(ext, "gz") || boost::iequals(ext, "z"));
 	bool isbz = boost::iequals(ext, "bz");
 
+	if(isgz && n_threads > 0 && ParallelBGZFBuf::isBGZF(fn)){
+		_parallel_buf.reset(new ParallelBGZFBuf(fn, n_threads));
+		rdbuf(_parallel_buf.get());
+		return;
+	}
+
 	_base_f.open(fn, mode | ((isgz || isbz) ? std::ios_base::binary : std::ios_base::in));
 
 	if(_base_f.rdstate() != std::ios_base::failbit && (isgz || isbz)){
@@ -47,6 +60,8 @@ void ICompressedFile::open(const char* fn, std::ios_base::openmode mode){
 
 
 void ICompressedFile::close(){
+	rdbuf(&_infile);
+	_parallel_buf.reset();
 	_infile.reset();
 }
 
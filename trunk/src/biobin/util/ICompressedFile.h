@@ -11,6 +11,7 @@
 #include <istream>
 #include <fstream>
 #include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/version.hpp>
@@ -353,14 +354,17 @@ namespace Utility {
  * \brief A class to read in compressed files automatically based on extension
  * This class, which has the same interface as an ifstream (so can be used
  * interchangeably) will automatically decompress
+ *
+ * If n_threads is nonzero and the file is BGZF-compressed, the blocks are
+ * inflated on n_threads worker threads (see ParallelBGZFBuf).
  */
 class ICompressedFile : public std::istream {
 public:
 	ICompressedFile();
-	explicit ICompressedFile(const char* fn, std::ios_base::openmode mode = std::ios_base::in);
-	virtual ~ICompressedFile() {}
+	explicit ICompressedFile(const char* fn, std::ios_base::openmode mode = std::ios_base::in, unsigned int n_threads = 0);
+	virtual ~ICompressedFile();
 
-	void open(const char* fn, std::ios_base::openmode mode = std::ios_base::in);
+	void open(const char* fn, std::ios_base::openmode mode = std::ios_base::in, unsigned int n_threads = 0);
 	void close();
 
 private:
@@ -368,6 +372,7 @@ private:
 
 	boost::iostreams::filtering_istreambuf _infile;
 	std::ifstream _base_f;
+	boost::scoped_ptr<std::streambuf> _parallel_buf;
 
 
 };
@@ -0,0 +1,53 @@
+/*
+ * MappedFile.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MappedFile.h"
+
+#include <ios>
+#include <sys/stat.h>
+
+#include <boost/algorithm/string.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+bool MappedFile::canMap(const std::string& fn){
+	std::string::size_type extPos = fn.find_last_of('.');
+	if(extPos != std::string::npos){
+		std::string ext = fn.substr(extPos+1);
+		if(boost::iequals(ext, "gz") || boost::iequals(ext, "z") ||
+				boost::iequals(ext, "bz")){
+			return false;
+		}
+	}
+
+	// Pipes, devices and empty files can't be mapped
+	struct stat st;
+	return stat(fn.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+}
+
+bool MappedFile::open(const std::string& fn){
+	close();
+	if(!canMap(fn)){
+		return false;
+	}
+
+	try{
+		_map.open(fn);
+	} catch(const std::ios_base::failure&){
+		return false;
+	}
+	return _map.is_open();
+}
+
+void MappedFile::close(){
+	if(_map.is_open()){
+		_map.close();
+	}
+}
+
+}
+}
@@ -0,0 +1,62 @@
+/*
+ * MappedFile.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_MAPPEDFILE_H
+#define BIOBIN_UTILITY_MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief A read-only, memory-mapped view of an uncompressed file.
+ * This class maps an entire file into memory so that it can be scanned in
+ * place without copying it into std::string buffers.  Only uncompressed,
+ * regular files can be mapped; compressed files should be read using the
+ * ICompressedFile class instead.
+ */
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	/*!
+	 * \brief Maps the given file into memory.
+	 * \return true if the file was mapped, false otherwise (in which case the
+	 * caller should fall back to a streaming reader).
+	 */
+	bool open(const std::string& fn);
+	void close();
+
+	bool is_open() const { return _map.is_open(); }
+
+	const char* begin() const { return _map.data(); }
+	const char* end() const { return _map.data() + _map.size(); }
+	std::size_t size() const { return _map.size(); }
+
+	/*!
+	 * \brief Determines if a file is eligible for mapping.
+	 * A file can be mapped if it is a non-empty regular file that is not
+	 * compressed (as determined by the same extensions as ICompressedFile).
+	 */
+	static bool canMap(const std::string& fn);
+
+private:
+	// No copying or assignment!
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	boost::iostreams::mapped_file_source _map;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_MAPPEDFILE_H */
@@ -0,0 +1,181 @@
+/*
+ * ParallelBGZFBuf.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "ParallelBGZFBuf.h"
+
+#include "BGZFReader.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+namespace {
+
+// Size of the fixed portion of a gzip header, up to and including XLEN
+const unsigned int GZ_HDR_LEN = 12;
+
+unsigned int readLE16(const unsigned char* p){
+	return p[0] | (p[1] << 8);
+}
+
+bool isBGZFHeader(const unsigned char* hdr){
+	// gzip magic, deflate, FEXTRA set
+	return hdr[0] == 31 && hdr[1] == 139 && hdr[2] == 8 && (hdr[3] & 4);
+}
+
+}
+
+ParallelBGZFBuf::ParallelBGZFBuf(const char* fn, unsigned int n_threads) :
+		_base_f(fn, std::ios_base::in | std::ios_base::binary), _curr(0),
+		_max_blocks(4*n_threads + 2), _eof(!_base_f.is_open()), _stop(false) {
+
+	setg(0, 0, 0);
+	for(unsigned int i=0; i<n_threads; i++){
+		_workers.create_thread(boost::bind(&ParallelBGZFBuf::inflateBlocks, this));
+	}
+}
+
+ParallelBGZFBuf::~ParallelBGZFBuf(){
+	{
+		boost::unique_lock<boost::mutex> l(_lock);
+		_stop = true;
+	}
+	_space_cond.notify_all();
+	_workers.join_all();
+
+	delete _curr;
+	for(std::deque<Block*>::iterator itr = _blocks.begin(); itr != _blocks.end(); ++itr){
+		delete *itr;
+	}
+	for(std::vector<Block*>::iterator itr = _free.begin(); itr != _free.end(); ++itr){
+		delete *itr;
+	}
+}
+
+bool ParallelBGZFBuf::isBGZF(const char* fn){
+	std::ifstream f(fn, std::ios_base::in | std::ios_base::binary);
+	unsigned char hdr[GZ_HDR_LEN];
+	if(!f.read(reinterpret_cast<char*>(hdr), GZ_HDR_LEN) || !isBGZFHeader(hdr)){
+		return false;
+	}
+
+	// Look for the "BC" subfield in the extra data
+	unsigned int xlen = readLE16(hdr + 10);
+	std::vector<unsigned char> extra(xlen);
+	if(!f.read(reinterpret_cast<char*>(&extra[0]), xlen)){
+		return false;
+	}
+	for(unsigned int i=0; i + 4 <= xlen; i += 4 + readLE16(&extra[i+2])){
+		if(extra[i] == 'B' && extra[i+1] == 'C' && readLE16(&extra[i+2]) == 2){
+			return true;
+		}
+	}
+	return false;
+}
+
+void ParallelBGZFBuf::inflateBlock(Block& b){
+	try{
+		BGZFReader::inflateBlock(b.compressed, b.data);
+	} catch(const std::exception& e){
+		b.error = e.what();
+	}
+}
+
+void ParallelBGZFBuf::inflateBlocks(){
+	boost::unique_lock<boost::mutex> l(_lock);
+	while(true){
+		while(!_stop && !_eof && _blocks.size() >= _max_blocks){
+			_space_cond.wait(l);
+		}
+		if(_stop || _eof){
+			break;
+		}
+
+		Block* b = 0;
+		if(_free.empty()){
+			b = new Block();
+		} else {
+			b = _free.back();
+			_free.pop_back();
+		}
+		b->done = false;
+		b->error.clear();
+
+		// Reading is done under the lock, so blocks are queued in file order
+		bool has_block = false;
+		try{
+			has_block = BGZFReader::readBlock(_base_f, b->compressed);
+		} catch(const std::exception& e){
+			b->error = e.what();
+			b->done = true;
+			has_block = true;
+			_eof = true;
+		}
+
+		if(!has_block){
+			_free.push_back(b);
+			_eof = true;
+			_ready_cond.notify_all();
+			break;
+		}
+
+		_blocks.push_back(b);
+		if(!b->done){
+			l.unlock();
+			inflateBlock(*b);
+			l.lock();
+			b->done = true;
+		}
+		_ready_cond.notify_all();
+	}
+	_space_cond.notify_all();
+}
+
+ParallelBGZFBuf::int_type ParallelBGZFBuf::underflow(){
+	if(gptr() < egptr()){
+		return traits_type::to_int_type(*gptr());
+	}
+
+	boost::unique_lock<boost::mutex> l(_lock);
+	while(true){
+		if(_curr){
+			_free.push_back(_curr);
+			_curr = 0;
+			_space_cond.notify_one();
+		}
+
+		while(!(_blocks.empty() ? _eof : _blocks.front()->done)){
+			_ready_cond.wait(l);
+		}
+
+		if(_blocks.empty()){
+			setg(0, 0, 0);
+			return traits_type::eof();
+		}
+
+		_curr = _blocks.front();
+		_blocks.pop_front();
+
+		if(!_curr->error.empty()){
+			std::cerr << "ERROR: Unable to decompress file: " << _curr->error << std::endl;
+			throw std::runtime_error(_curr->error);
+		}
+
+		// Empty blocks (such as the BGZF EOF marker) are skipped
+		if(!_curr->data.empty()){
+			char* data = &_curr->data[0];
+			setg(data, data, data + _curr->data.size());
+			return traits_type::to_int_type(*gptr());
+		}
+	}
+}
+
+}
+}
@@ -0,0 +1,86 @@
+/*
+ * ParallelBGZFBuf.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_PARALLELBGZFBUF_H
+#define BIOBIN_UTILITY_PARALLELBGZFBUF_H
+
+#include <streambuf>
+#include <fstream>
+#include <string>
+#include <deque>
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief A stream buffer that inflates a BGZF file using a pool of threads.
+ * BGZF files (as written by bgzip) are a series of independent gzip members
+ * of at most 64K each.  This buffer reads the compressed blocks in order,
+ * inflates them concurrently on worker threads and hands the decompressed
+ * bytes back to the reader in the original order, so it can be used anywhere
+ * an istream is expected.
+ *
+ * Files that are not BGZF (i.e. plain gzip) can not be split into blocks;
+ * use isBGZF to check before constructing one of these.
+ */
+class ParallelBGZFBuf : public std::streambuf {
+public:
+	ParallelBGZFBuf(const char* fn, unsigned int n_threads);
+	virtual ~ParallelBGZFBuf();
+
+	/*!
+	 * \brief Determines if the given file starts with a BGZF block header.
+	 */
+	static bool isBGZF(const char* fn);
+
+protected:
+	virtual int_type underflow();
+
+private:
+	// No copying or assignment!
+	ParallelBGZFBuf(const ParallelBGZFBuf&);
+	ParallelBGZFBuf& operator=(const ParallelBGZFBuf&);
+
+	struct Block{
+		Block() : done(false) {}
+		std::vector<char> compressed;
+		std::vector<char> data;
+		std::string error;
+		bool done;
+	};
+
+	void inflateBlocks();
+	static void inflateBlock(Block& b);
+
+	std::ifstream _base_f;
+
+	boost::mutex _lock;
+	boost::condition_variable _ready_cond;
+	boost::condition_variable _space_cond;
+
+	// blocks waiting to be consumed, in file order
+	std::deque<Block*> _blocks;
+	// the block currently exposed to the reader
+	Block* _curr;
+	// blocks to be reused
+	std::vector<Block*> _free;
+
+	unsigned int _max_blocks;
+	bool _eof;
+	bool _stop;
+
+	boost::thread_group _workers;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_PARALLELBGZFBUF_H */
@@ -0,0 +1,272 @@
+/*
+ * TabixIndex.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "TabixIndex.h"
+
+#include "BGZFReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace BioBin {
+namespace Utility {
+
+namespace {
+
+// Tabix indexes always use 16K bins in a 6 level tree
+const int TBI_MIN_SHIFT = 14;
+const int TBI_DEPTH = 5;
+
+/*
+ * Reads little-endian integers from a buffer, flagging any read past the end
+ */
+class IndexCursor{
+public:
+	IndexCursor(const char* begin, const char* end) : _p(begin), _end(end), _ok(true) {}
+
+	bool ok() const {return _ok;}
+	const char* pos() const {return _p;}
+
+	boost::uint64_t readUInt(unsigned int n_bytes){
+		if(!_ok || _end - _p < static_cast<std::ptrdiff_t>(n_bytes)){
+			_ok = false;
+			return 0;
+		}
+		boost::uint64_t val = 0;
+		for(unsigned int i=0; i<n_bytes; i++){
+			val |= static_cast<boost::uint64_t>(static_cast<unsigned char>(_p[i])) << (8*i);
+		}
+		_p += n_bytes;
+		return val;
+	}
+
+	boost::int32_t i32() {return static_cast<boost::int32_t>(readUInt(4));}
+	boost::uint32_t u32() {return static_cast<boost::uint32_t>(readUInt(4));}
+	boost::uint64_t u64() {return readUInt(8);}
+
+	bool skip(std::size_t n){
+		if(!_ok || static_cast<std::size_t>(_end - _p) < n){
+			_ok = false;
+		} else {
+			_p += n;
+		}
+		return _ok;
+	}
+
+private:
+	const char* _p;
+	const char* _end;
+	bool _ok;
+};
+
+}
+
+TabixIndex::TabixIndex() : _min_shift(TBI_MIN_SHIFT), _depth(TBI_DEPTH) {}
+
+bool TabixIndex::load(const std::string& fn){
+	const char* exts[] = {".tbi", ".csi"};
+	for(unsigned int i=0; i<2; i++){
+		std::string idx_fn = fn + exts[i];
+		std::ifstream test_f(idx_fn.c_str());
+		if(!test_f.is_open()){
+			continue;
+		}
+		test_f.close();
+
+		// The index is itself BGZF compressed; read the whole thing in
+		std::vector<char> data;
+		try{
+			BGZFReader idx_f(idx_fn);
+			char buf[65536];
+			std::size_t n_read;
+			while((n_read = idx_f.read(buf, sizeof(buf))) > 0){
+				data.insert(data.end(), buf, buf + n_read);
+			}
+		} catch(const std::exception& e){
+			std::cerr << "WARNING: Unable to read index " << idx_fn << ": " << e.what() << std::endl;
+			continue;
+		}
+
+		if(parse(data, i == 1)){
+			return true;
+		}
+		std::cerr << "WARNING: Malformed index " << idx_fn << ", ignoring." << std::endl;
+	}
+
+	return false;
+}
+
+bool TabixIndex::parse(const std::vector<char>& data, bool is_csi){
+	_names.clear();
+	_refs.clear();
+
+	if(data.size() < 4 || memcmp(&data[0], is_csi ? "CSI\1" : "TBI\1", 4) != 0){
+		return false;
+	}
+
+	IndexCursor c(&data[0] + 4, &data[0] + data.size());
+	if(is_csi){
+		_min_shift = c.i32();
+		_depth = c.i32();
+		boost::int32_t l_aux = c.i32();
+		const char* aux = c.pos();
+		if(!c.skip(l_aux < 0 ? 0 : l_aux)){
+			return false;
+		}
+
+		// The aux data holds the tabix-style header, with the names
+		IndexCursor aux_c(aux, aux + std::max(l_aux, 0));
+		aux_c.skip(6*4);
+		boost::int32_t l_nm = aux_c.i32();
+		const char* nm = aux_c.pos();
+		if(!aux_c.ok() || l_nm < 0 || !aux_c.skip(l_nm)){
+			return false;
+		}
+		parseNames(nm, nm + l_nm);
+	} else {
+		_min_shift = TBI_MIN_SHIFT;
+		_depth = TBI_DEPTH;
+	}
+
+	boost::int32_t n_ref = c.i32();
+	if(!is_csi){
+		c.skip(6*4);
+		boost::int32_t l_nm = c.i32();
+		const char* nm = c.pos();
+		if(!c.ok() || l_nm < 0 || !c.skip(l_nm)){
+			return false;
+		}
+		parseNames(nm, nm + l_nm);
+	}
+
+	if(!c.ok() || n_ref < 0 || static_cast<std::size_t>(n_ref) != _names.size()){
+		return false;
+	}
+
+	_refs.resize(n_ref);
+	for(int r=0; r<n_ref && c.ok(); r++){
+		RefIndex& ref = _refs[r];
+		boost::int32_t n_bin = c.i32();
+		for(int b=0; b<n_bin && c.ok(); b++){
+			Bin& bin = ref.bins[c.u32()];
+			if(is_csi){
+				bin.loffset = c.u64();
+			}
+			boost::int32_t n_chunk = c.i32();
+			for(int k=0; k<n_chunk && c.ok(); k++){
+				boost::uint64_t cnk_beg = c.u64();
+				boost::uint64_t cnk_end = c.u64();
+				bin.chunks.push_back(chunk(cnk_beg, cnk_end));
+			}
+		}
+
+		if(!is_csi){
+			boost::int32_t n_intv = c.i32();
+			for(int i=0; i<n_intv && c.ok(); i++){
+				ref.linear.push_back(c.u64());
+			}
+		}
+	}
+
+	return c.ok();
+}
+
+void TabixIndex::parseNames(const char* begin, const char* end){
+	while(begin < end){
+		const char* nul = static_cast<const char*>(memchr(begin, '\0', end - begin));
+		if(!nul){
+			nul = end;
+		}
+		_names.push_back(std::string(begin, nul));
+		begin = nul + 1;
+	}
+}
+
+boost::uint64_t TabixIndex::getMinOffset(const RefIndex& ref, unsigned int beg) const{
+	if(!ref.linear.empty()){
+		std::size_t idx = std::min(static_cast<std::size_t>(beg >> _min_shift), ref.linear.size() - 1);
+		return ref.linear[idx];
+	}
+
+	// CSI: use the offset of the smallest bin containing beg
+	unsigned int bin = ((1u << (3*_depth)) - 1) / 7 + (beg >> _min_shift);
+	while(true){
+		boost::unordered_map<unsigned int, Bin>::const_iterator b_itr = ref.bins.find(bin);
+		if(b_itr != ref.bins.end()){
+			return (*b_itr).second.loffset;
+		}
+		if(bin == 0){
+			break;
+		}
+		bin = (bin - 1) >> 3;
+	}
+	return 0;
+}
+
+void TabixIndex::getChunks(unsigned int tid,
+		const std::vector<std::pair<unsigned int, unsigned int> >& intervals,
+		std::vector<chunk>& chunks_out) const{
+
+	chunks_out.clear();
+	if(tid >= _refs.size()){
+		return;
+	}
+	const RefIndex& ref = _refs[tid];
+
+	std::vector<std::pair<unsigned int, unsigned int> >::const_iterator i_itr = intervals.begin();
+	for( ; i_itr != intervals.end(); ++i_itr){
+		boost::uint64_t beg = (*i_itr).first;
+		boost::uint64_t end = (*i_itr).second;
+		if(beg >= end){
+			continue;
+		}
+
+		boost::uint64_t min_off = getMinOffset(ref, (*i_itr).first);
+
+		// Visit every bin that could overlap [beg, end), level by level
+		int shift = _min_shift + 3*_depth;
+		if(end > (static_cast<boost::uint64_t>(1) << shift)){
+			end = static_cast<boost::uint64_t>(1) << shift;
+		}
+		--end;
+		unsigned int level_start = 0;
+		for(int l=0; l<=_depth; l++){
+			for(boost::uint64_t b = level_start + (beg >> shift); b <= level_start + (end >> shift); b++){
+				boost::unordered_map<unsigned int, Bin>::const_iterator b_itr = ref.bins.find(static_cast<unsigned int>(b));
+				if(b_itr == ref.bins.end()){
+					continue;
+				}
+				std::vector<chunk>::const_iterator c_itr = (*b_itr).second.chunks.begin();
+				for( ; c_itr != (*b_itr).second.chunks.end(); ++c_itr){
+					if((*c_itr).second > min_off){
+						chunks_out.push_back(*c_itr);
+					}
+				}
+			}
+			level_start += 1u << (3*l);
+			shift -= 3;
+		}
+	}
+
+	// Sort and merge overlapping chunks
+	std::sort(chunks_out.begin(), chunks_out.end());
+	std::vector<chunk>::iterator out_itr = chunks_out.begin();
+	std::vector<chunk>::const_iterator in_itr = chunks_out.begin();
+	for( ; in_itr != chunks_out.end(); ++in_itr){
+		if(out_itr != chunks_out.begin() && (*in_itr).first <= (*(out_itr - 1)).second){
+			(*(out_itr - 1)).second = std::max((*(out_itr - 1)).second, (*in_itr).second);
+		} else {
+			*out_itr++ = *in_itr;
+		}
+	}
+	chunks_out.erase(out_itr, chunks_out.end());
+}
+
+}
+}
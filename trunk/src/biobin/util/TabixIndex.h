@@ -0,0 +1,83 @@
+/*
+ * TabixIndex.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_TABIXINDEX_H
+#define BIOBIN_UTILITY_TABIXINDEX_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief An in-memory copy of a tabix (.tbi) or CSI (.csi) index.
+ * These indexes sit next to a bgzipped file and map genomic intervals to the
+ * BGZF virtual offsets of the records that may overlap them.  See the tabix
+ * and CSI specifications in the hts-specs project for the file layouts.
+ */
+class TabixIndex {
+public:
+	//! A range of BGZF virtual offsets [first, second)
+	typedef std::pair<boost::uint64_t, boost::uint64_t> chunk;
+
+	TabixIndex();
+
+	/*!
+	 * \brief Loads the index for the given data file.
+	 * Looks for <fn>.tbi, then <fn>.csi.
+	 *
+	 * \return true if an index was found and loaded.
+	 */
+	bool load(const std::string& fn);
+
+	/*!
+	 * \brief The sequence names, in the order used by the index.
+	 */
+	const std::vector<std::string>& getNames() const {return _names;}
+
+	/*!
+	 * \brief Finds the chunks of the file that may hold records overlapping
+	 * the given intervals on sequence tid.
+	 * Intervals are 0-based, half open.  The resulting chunks are sorted and
+	 * merged, so reading them in order visits each record at most once.
+	 */
+	void getChunks(unsigned int tid,
+			const std::vector<std::pair<unsigned int, unsigned int> >& intervals,
+			std::vector<chunk>& chunks_out) const;
+
+private:
+	struct Bin{
+		Bin() : loffset(0) {}
+		// only used in CSI indexes
+		boost::uint64_t loffset;
+		std::vector<chunk> chunks;
+	};
+
+	struct RefIndex{
+		boost::unordered_map<unsigned int, Bin> bins;
+		// the linear index (tabix only)
+		std::vector<boost::uint64_t> linear;
+	};
+
+	bool parse(const std::vector<char>& data, bool is_csi);
+	void parseNames(const char* begin, const char* end);
+	boost::uint64_t getMinOffset(const RefIndex& ref, unsigned int beg) const;
+
+	int _min_shift;
+	int _depth;
+	std::vector<std::string> _names;
+	std::vector<RefIndex> _refs;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_TABIXINDEX_H */
@@ -0,0 +1,37 @@
+/*
+ * VCFRecord.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "VCFRecord.h"
+
+namespace BioBin {
+namespace Utility {
+
+unsigned int VCFRecord::tokenize(const char* begin, const char* end){
+	_fields.clear();
+	const char* pos = begin;
+	// NOTE: an empty line (or a line ending in a tab) still has a final,
+	// empty field, just as boost::algorithm::iter_split would report
+	do{
+		_fields.push_back(nextToken(pos, end, '\t'));
+	} while(pos != end || (_fields.back().end() != end));
+
+	return _fields.size();
+}
+
+VCFRecord::string_view VCFRecord::getToken(const char* begin, const char* end,
+		char delim, unsigned int idx){
+	const char* pos = begin;
+	for(unsigned int i=0; i<idx; i++){
+		if(pos == end){
+			return string_view(end, end);
+		}
+		nextToken(pos, end, delim);
+	}
+	return nextToken(pos, end, delim);
+}
+
+}
+}
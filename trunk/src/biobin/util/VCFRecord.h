@@ -0,0 +1,76 @@
+/*
+ * VCFRecord.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BIOBIN_UTILITY_VCFRECORD_H
+#define BIOBIN_UTILITY_VCFRECORD_H
+
+#include <vector>
+#include <cstring>
+
+#include <boost/range/iterator_range.hpp>
+
+namespace BioBin {
+namespace Utility {
+
+/*!
+ * \brief A zero-copy, tab-delimited view of a single line of a VCF file.
+ * The record does not own the underlying characters; it only holds views into
+ * a buffer (typically a memory-mapped file or a line buffer) that must remain
+ * valid for as long as the fields are in use.  The vector of fields is reused
+ * between calls to tokenize, so no allocation is done once it has grown to
+ * the number of columns in the file.
+ */
+class VCFRecord {
+public:
+	typedef boost::iterator_range<const char*> string_view;
+
+	VCFRecord() {}
+
+	/*!
+	 * \brief Splits the line [begin, end) on tabs.
+	 * \return The number of fields found.
+	 */
+	unsigned int tokenize(const char* begin, const char* end);
+
+	unsigned int size() const { return _fields.size(); }
+	const string_view& operator[](unsigned int i) const { return _fields[i]; }
+
+	void reserve(unsigned int n) { _fields.reserve(n); }
+
+	/*!
+	 * \brief Returns the next delim-separated token, advancing pos.
+	 * After the call, pos points past the delimiter, or equals end if the
+	 * last token was consumed.
+	 */
+	static string_view nextToken(const char*& pos, const char* end, char delim){
+		const char* tok_end = static_cast<const char*>(memchr(pos, delim, end - pos));
+		if(!tok_end){
+			tok_end = end;
+		}
+		string_view tok(pos, tok_end);
+		pos = tok_end + (tok_end != end);
+		return tok;
+	}
+
+	/*!
+	 * \brief Returns the idx-th delim-separated token in [begin, end).
+	 * If fewer than idx+1 tokens exist, an empty view is returned.
+	 */
+	static string_view getToken(const char* begin, const char* end, char delim, unsigned int idx);
+
+	static bool equals(const string_view& v, const char* s){
+		std::size_t n = strlen(s);
+		return static_cast<std::size_t>(v.size()) == n && memcmp(v.begin(), s, n) == 0;
+	}
+
+private:
+	std::vector<string_view> _fields;
+};
+
+}
+}
+
+#endif /* BIOBIN_UTILITY_VCFRECORD_H */
@@ -111,6 +111,17 @@ public:
 	 * \return The ending iterator of all the Regions.
 	 */
 	const_region_iterator regionEnd() const {return _regions.end();}
+	/*!
+	 * \brief Determines if a Region is associated with this Group.
+	 *
+	 * \param region The Region to look for
+	 *
+	 * \return true if the Region was added to this Group
+	 */
+	bool containsRegion(Region* region) const {
+		const_region_iterator itr = _regions.find(region);
+		return itr != _regions.end() && *itr == region;
+	}
 	/*!
 	 * Gets the beginning iterator for all parents of the current Group.
 	 *
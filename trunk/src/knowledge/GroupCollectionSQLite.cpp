@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <utility>
 #include <deque>
+#include <algorithm>
 
 #include "GroupCollectionSQLite.h"
 #include "RegionCollection.h"
@@ -25,9 +26,17 @@ using boost::unordered_map;
 
 namespace Knowledge{
 
+namespace {
+
+bool compareFirst(const pair<uint, uint>& a, const pair<uint, uint>& b){
+	return a.first < b.first;
+}
+
+}
+
 GroupCollectionSQLite::GroupCollectionSQLite(RegionCollection& reg,
 		const string& fn, Information* info) :
-			GroupCollection(reg), _self_open(true), _self_info(!info){
+			GroupCollection(reg), _self_open(true), _self_info(!info), _snapshot(0){
 	sqlite3_open(fn.c_str(),&_db);
 	getMaxGroup();
 	if(!info){
@@ -41,7 +50,7 @@ GroupCollectionSQLite::GroupCollectionSQLite(RegionCollection& reg,
 
 GroupCollectionSQLite::GroupCollectionSQLite(RegionCollection& reg,
 		sqlite3 *db_conn, Information* info) :
-			GroupCollection(reg), _self_open(false), _self_info(!info), _db(db_conn) {
+			GroupCollection(reg), _self_open(false), _self_info(!info), _db(db_conn), _snapshot(0) {
 	getMaxGroup();
 	if(!info){
 		_info = new InformationSQLite(_db);
@@ -142,11 +151,24 @@ void GroupCollectionSQLite::Load(const vector<string>& group_names,
 		ambig = " AND (quality >= 100 OR implication >= 100) ";
 	}
 
+	if(_snapshot){
+		loadSnapshot(id_list, ambig + src_str.str());
+	} else {
+		loadGroups(id_list, ambig + src_str.str());
+	}
+
+	// get rid of "too big to fail" groups
+	pruneGroups();
+}
+
+void GroupCollectionSQLite::loadGroups(const unordered_set<uint>& id_list,
+		const string& filter){
+
 	string group_cmd = "SELECT group_id, label, description, source "
 			"FROM group_biopolymer "
 			"INNER JOIN 'group' USING (group_id) "
 			"INNER JOIN source ON 'group'.source_id=source.source_id "
-			"WHERE group_biopolymer.biopolymer_id=:region_id " + ambig + src_str.str();
+			"WHERE group_biopolymer.biopolymer_id=:region_id " + filter;
 
 	sqlite3_stmt* group_stmt;
 	sqlite3_prepare_v2(_db, group_cmd.c_str(), -1, &group_stmt, NULL);
@@ -184,7 +206,7 @@ void GroupCollectionSQLite::Load(const vector<string>& group_names,
 	string parent_cmd = "SELECT group_group.group_id, 'group'.label, "
 			"'group'.description, source "
 			"FROM group_group INNER JOIN 'group' USING (group_id) "
-			"INNER JOIN source ON 'group'.source_id='group'.source_id "
+			"INNER JOIN source ON 'group'.source_id=source.source_id "
 			"WHERE group_group.contains=1 AND group_group.related_group_id=:gid";
 
 	sqlite3_stmt* parent_stmt;
@@ -212,9 +234,127 @@ void GroupCollectionSQLite::Load(const vector<string>& group_names,
 	}
 
 	sqlite3_finalize(parent_stmt);
+}
 
-	// get rid of "too big to fail" groups
-	pruneGroups();
+void GroupCollectionSQLite::loadSnapshot(const unordered_set<uint>& id_list,
+		const string& filter){
+
+	KnowledgeSnapshot::GroupData& data = _snapshot->getGroupData();
+	if(!_snapshot->has(KnowledgeSnapshot::GROUPS)){
+		readGroups(filter, data);
+		_snapshot->setLoaded(KnowledgeSnapshot::GROUPS);
+	}
+
+	typedef vector<pair<uint, uint> >::const_iterator pair_itr;
+	deque<uint> child_groups;
+
+	RegionCollection::const_iterator r_itr = _regions.begin();
+	while(r_itr != _regions.end()){
+		pair<pair_itr, pair_itr> gp_range = std::equal_range(
+				data.region_groups.begin(), data.region_groups.end(),
+				std::make_pair((*r_itr)->getID(), 0u), compareFirst);
+		for(pair_itr gp_itr = gp_range.first; gp_itr != gp_range.second; ++gp_itr){
+			uint group_id = (*gp_itr).second;
+			if(id_list.size() == 0 || id_list.find(group_id) != id_list.end()){
+				Group* gp;
+				if (_group_map.find(group_id) == _group_map.end()){
+					child_groups.push_back(group_id);
+					gp = addGroup(group_id, data);
+				} else {
+					gp = _group_map[group_id];
+				}
+				gp->addRegion(**r_itr);
+				(*r_itr)->addGroup(*gp);
+			}
+		}
+		++r_itr;
+	}
+
+	// OK, now load parents of all of the groups that contain the regions
+	while(child_groups.size() > 0){
+		pair<pair_itr, pair_itr> parent_range = std::equal_range(
+				data.child_parents.begin(), data.child_parents.end(),
+				std::make_pair(child_groups.front(), 0u), compareFirst);
+		for(pair_itr p_itr = parent_range.first; p_itr != parent_range.second; ++p_itr){
+			uint parent_id = (*p_itr).second;
+			if(id_list.size() == 0 || id_list.find(parent_id) != id_list.end()){
+				Group* parent;
+				if (_group_map.find(parent_id) == _group_map.end()){
+					parent = addGroup(parent_id, data);
+					child_groups.push_back(parent_id);
+				}else{
+					parent = _group_map[parent_id];
+				}
+				parent->addChild(*_group_map[child_groups.front()]);
+			}
+		}
+		child_groups.pop_front();
+	}
+}
+
+void GroupCollectionSQLite::readGroups(const string& filter,
+		KnowledgeSnapshot::GroupData& data_out){
+
+	// Every group of every region, as we don't yet know which of the regions
+	// will be used
+	string group_cmd = "SELECT group_biopolymer.biopolymer_id, group_id, label, description, source "
+			"FROM group_biopolymer "
+			"INNER JOIN 'group' USING (group_id) "
+			"INNER JOIN source ON 'group'.source_id=source.source_id "
+			"WHERE 1 " + filter;
+
+	sqlite3_stmt* group_stmt;
+	sqlite3_prepare_v2(_db, group_cmd.c_str(), -1, &group_stmt, NULL);
+	while(sqlite3_step(group_stmt) == SQLITE_ROW){
+		uint region_id = static_cast<uint>(sqlite3_column_int(group_stmt, 0));
+		uint group_id = static_cast<uint>(sqlite3_column_int(group_stmt, 1));
+		data_out.region_groups.push_back(std::make_pair(region_id, group_id));
+		readGroup(group_stmt, 1, data_out);
+	}
+	sqlite3_finalize(group_stmt);
+
+	// and every group contained in another
+	string parent_cmd = "SELECT group_group.related_group_id, group_group.group_id, "
+			"'group'.label, 'group'.description, source "
+			"FROM group_group INNER JOIN 'group' USING (group_id) "
+			"INNER JOIN source ON 'group'.source_id=source.source_id "
+			"WHERE group_group.contains=1";
+
+	sqlite3_stmt* parent_stmt;
+	sqlite3_prepare_v2(_db, parent_cmd.c_str(), -1, &parent_stmt, NULL);
+	while(sqlite3_step(parent_stmt) == SQLITE_ROW){
+		uint child_id = static_cast<uint>(sqlite3_column_int(parent_stmt, 0));
+		uint parent_id = static_cast<uint>(sqlite3_column_int(parent_stmt, 1));
+		data_out.child_parents.push_back(std::make_pair(child_id, parent_id));
+		readGroup(parent_stmt, 1, data_out);
+	}
+	sqlite3_finalize(parent_stmt);
+
+	std::sort(data_out.region_groups.begin(), data_out.region_groups.end());
+	data_out.region_groups.erase(std::unique(data_out.region_groups.begin(),
+			data_out.region_groups.end()), data_out.region_groups.end());
+	std::sort(data_out.child_parents.begin(), data_out.child_parents.end());
+	data_out.child_parents.erase(std::unique(data_out.child_parents.begin(),
+			data_out.child_parents.end()), data_out.child_parents.end());
+}
+
+void GroupCollectionSQLite::readGroup(sqlite3_stmt* group_query, int col,
+		KnowledgeSnapshot::GroupData& data_out){
+
+	uint group_id = static_cast<uint>(sqlite3_column_int(group_query, col));
+	if(data_out.groups.find(group_id) == data_out.groups.end()){
+		KnowledgeSnapshot::GroupRow& gp = data_out.groups[group_id];
+		gp.name = string((const char *) (sqlite3_column_text(group_query, col + 3))) + ":" +
+				(const char *) (sqlite3_column_text(group_query, col + 1));
+		if(sqlite3_column_type(group_query, col + 2) != SQLITE_NULL){
+			gp.desc = (const char *) (sqlite3_column_text(group_query, col + 2));
+		}
+	}
+}
+
+Group* GroupCollectionSQLite::addGroup(uint group_id, const KnowledgeSnapshot::GroupData& data){
+	const KnowledgeSnapshot::GroupRow& gp = (*data.groups.find(group_id)).second;
+	return AddGroup(group_id, gp.name, gp.desc);
 }
 
 uint GroupCollectionSQLite::getMaxGroup() {
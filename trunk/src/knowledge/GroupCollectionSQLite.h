@@ -9,6 +9,7 @@
 #define KNOWLEDGE_GROUPCOLLECTIONSQLITE_H
 
 #include "GroupCollection.h"
+#include "KnowledgeSnapshot.h"
 
 #include <sqlite3.h>
 
@@ -25,6 +26,12 @@ public:
 	virtual void Load(const std::vector<std::string>& group_names,
 			const boost::unordered_set<unsigned int>& ids);
 
+	/*!
+	 * \brief Reads the groups of the regions from the given snapshot, if
+	 * present, and adds them to it otherwise.
+	 */
+	void setSnapshot(KnowledgeSnapshot* snapshot) {_snapshot = snapshot;}
+
 protected:
 	virtual unsigned int getMaxGroup();
 
@@ -36,7 +43,28 @@ private:
 
 	sqlite3_stmt* _group_name_stmt;
 
+	KnowledgeSnapshot* _snapshot;
+
 	Group* addGroup(sqlite3_stmt* group_query);
+	Group* addGroup(unsigned int group_id, const KnowledgeSnapshot::GroupData& data);
+
+	/*!
+	 * \brief Adds the groups of the loaded regions, and their parents.
+	 * \param id_list The groups to load; all if empty
+	 * \param filter Conditions on the groups to load, as an SQL "AND ..."
+	 */
+	void loadGroups(const boost::unordered_set<unsigned int>& id_list,
+			const std::string& filter);
+	//! As loadGroups, using the groups in the snapshot
+	void loadSnapshot(const boost::unordered_set<unsigned int>& id_list,
+			const std::string& filter);
+
+	//! Reads the groups of every region, and every parent group, from the database
+	void readGroups(const std::string& filter, KnowledgeSnapshot::GroupData& data_out);
+	//! Adds the group whose ID is in the given column (and label, description
+	//! and source in the next three) to data_out, if not already there
+	static void readGroup(sqlite3_stmt* group_query, int col,
+			KnowledgeSnapshot::GroupData& data_out);
 
 	void initQueries();
 
@@ -129,7 +129,8 @@ public:
 
 	/*!
 	 * \brief Returns a SNP's role.
-	 * This function returns a SNPs role in a gene.
+	 * This function returns a SNPs role in a gene.  Only the roles loaded by
+	 * loadRoles are returned, so loadRoles must be called first.
 	 *
 	 * \param loc The Locus object in question
 	 * \param reg The associated Region to get the role for.
@@ -144,7 +145,8 @@ public:
 	 * This function returns the weight that a user has set for the variant.
 	 * The user could set this from a file, or we could associate certain roles
 	 * with weights (chained call to getSNPRole, perhaps, but it may be better
-	 * to create a new function that is getRoleWight)?
+	 * to create a new function that is getRoleWight)?  Weights are only
+	 * available after loadWeights is called.
 	 *
 	 * \param loc The Locus object in question
 	 * \param reg The associate Region to get the weight for
@@ -12,11 +12,11 @@
 #include <stdlib.h>
 #include <map>
 
-#include <boost/thread.hpp>
-
 #include <sqlite3.h>
 
 #include "Information.h"
+#include "IntervalIndex.h"
+#include "KnowledgeSnapshot.h"
 
 namespace Knowledge{
 
@@ -64,24 +64,22 @@ public:
 	virtual std::string getLOKIBuild() const;
 	virtual const std::set<unsigned int>& getSourceIds();
 
-private:
-	void prepRoleStmt();
-	void prepRoleTables();
-
-	static std::string _role_region_tbl;
-	static std::string _role_zone_tbl;
-	static std::string _role_snp_tbl;
-	static std::string _weight_region_tbl;
-	static std::string _weight_zone_tbl;
-	static std::string _weight_snp_tbl;
-
-	// blatantly stolen from ldsplineimporter!
-	void getAndDropIndexes(const std::string& tbl_name, std::map<std::string, std::string>& indexes_out);
-	void restoreIndexes(const std::string& tbl_name, const std::map<std::string, std::string>& index_map);
-	void UpdateZones(const std::string& tbl_name, const std::string& tbl_zone_name, int zone_size);
+	/*!
+	 * \brief Reads the roles of the SNPs from the given snapshot, if present,
+	 * and adds them to it otherwise.
+	 */
+	void setSnapshot(KnowledgeSnapshot* snapshot) {_snapshot = snapshot;}
 
-	static int parseRegionIndex(void*, int, char**, char**);
+private:
+	void prepRoleMap();
 
+	//! Adds the roles of the SNPs in the database for the given regions
+	void loadLOKIRoles(const RegionCollection& reg);
+	//! Reads the roles of the SNPs in every region from the database
+	void readLOKIRoles(const std::string& source_list,
+			std::vector<KnowledgeSnapshot::RoleRow>& roles_out);
+	void addRole(short chr, int posMin, int posMax, int region_id, unsigned long role);
+	void addWeight(short chr, int posMin, int posMax, int region_id, double weight);
 
 	/*!
 	 *  SQLite callback to parse a single column, which is returned via the
@@ -106,25 +104,15 @@ private:
 	sqlite3* _db;
 	bool _self_open;
 
+	KnowledgeSnapshot* _snapshot;
+
 	// A mapping of db integer roles to SNP roles
 	std::map<int, Information::snp_role> _role_map;
 
-	// The prepared statement for getting SNP roles
-	sqlite3_stmt* _role_stmt;
-
-	// Prepared statment for getting SNP roles from regions
-	sqlite3_stmt* _region_role_stmt;
-	sqlite3_stmt* _snp_role_stmt;
-
-	sqlite3_stmt* _region_weight_stmt;
-	sqlite3_stmt* _snp_weight_stmt;
-
-	// Zone size used in the temp tables
-	int _tmp_role_zone;
-	int _tmp_weight_zone;
-
-	// mutex for shared libsqlite prepared statements
-	static boost::mutex _sqlite_lock;
+	// The roles and weights of every position, by region.  These are only
+	// read once loaded, so lookups need no locking.
+	IntervalIndex<unsigned long> _role_index;
+	IntervalIndex<double> _weight_index;
 };
 
 }
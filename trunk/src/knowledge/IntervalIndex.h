@@ -0,0 +1,237 @@
+/*
+ * IntervalIndex.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef KNOWLEDGE_INTERVALINDEX_H
+#define KNOWLEDGE_INTERVALINDEX_H
+
+#include <vector>
+#include <map>
+#include <algorithm>
+
+namespace Knowledge {
+
+/*!
+ * \brief An in-memory index of values attached to genomic ranges and single
+ * positions, each optionally restricted to one region (biopolymer).
+ *
+ * Values are added with addRange and addPosition, then build is called once
+ * to sort them; after that, find is a read-only binary search and may be
+ * called from any number of threads at once.
+ *
+ * The ranges of each chromosome are sorted by start and laid out as an
+ * implicit augmented interval tree (H. Li, "cgranges"): the sorted array is
+ * read as a binary search tree in which every node also holds the largest
+ * end in its subtree, so the ranges containing a position are found in
+ * O(log n + matches) without any extra pointers.
+ */
+template <class T>
+class IntervalIndex {
+public:
+	//! Region ID for values that apply to every region
+	static const int ANY_REGION = -1;
+
+	/*!
+	 * \brief Adds a value to every position from pos_min to pos_max, inclusive.
+	 * The value is not found until build is called.
+	 */
+	void addRange(short chr, int pos_min, int pos_max, int region_id, const T& value);
+
+	/*!
+	 * \brief Adds a value to a single position.
+	 * The value is not found until build is called.
+	 */
+	void addPosition(short chr, int pos, int region_id, const T& value);
+
+	/*!
+	 * \brief Sorts the values and builds the trees.  Must be called after the
+	 * last value is added and before any call to find.
+	 */
+	void build();
+
+	/*!
+	 * \brief Calls fn(value) for every value containing the given position
+	 * whose region is ANY_REGION or region_id; ranges first, then positions.
+	 */
+	template <class F>
+	void find(short chr, int pos, int region_id, F& fn) const;
+
+private:
+	struct Range{
+		int start;
+		int end;
+		// largest end in the subtree of this node
+		int max_end;
+		int region_id;
+		T value;
+	};
+
+	struct Position{
+		int pos;
+		int region_id;
+		T value;
+	};
+
+	struct Chrom{
+		Chrom() : root_level(-1) {}
+
+		std::vector<Range> ranges;
+		std::vector<Position> positions;
+		int root_level;
+	};
+
+	static bool compareRange(const Range& a, const Range& b){
+		return a.start < b.start;
+	}
+	static bool comparePosition(const Position& a, const Position& b){
+		return a.pos < b.pos;
+	}
+	static bool comparePos(const Position& a, int pos){
+		return a.pos < pos;
+	}
+
+	/*!
+	 * \brief Sets max_end of every node of the (sorted) ranges.
+	 * \return the level of the root of the tree, -1 if empty
+	 */
+	static int indexRanges(std::vector<Range>& ranges);
+
+	std::map<short, Chrom> _chroms;
+};
+
+template <class T>
+void IntervalIndex<T>::addRange(short chr, int pos_min, int pos_max, int region_id, const T& value){
+	Range r;
+	r.start = pos_min;
+	r.end = pos_max;
+	r.max_end = pos_max;
+	r.region_id = region_id;
+	r.value = value;
+	_chroms[chr].ranges.push_back(r);
+}
+
+template <class T>
+void IntervalIndex<T>::addPosition(short chr, int pos, int region_id, const T& value){
+	Position p;
+	p.pos = pos;
+	p.region_id = region_id;
+	p.value = value;
+	_chroms[chr].positions.push_back(p);
+}
+
+template <class T>
+void IntervalIndex<T>::build(){
+	typename std::map<short, Chrom>::iterator c_itr = _chroms.begin();
+	for( ; c_itr != _chroms.end(); ++c_itr){
+		Chrom& c = (*c_itr).second;
+		// stable, so values are found in the order they were added
+		std::stable_sort(c.ranges.begin(), c.ranges.end(), compareRange);
+		std::stable_sort(c.positions.begin(), c.positions.end(), comparePosition);
+		c.root_level = indexRanges(c.ranges);
+	}
+}
+
+template <class T>
+int IntervalIndex<T>::indexRanges(std::vector<Range>& a){
+	long n = a.size();
+	if(n == 0){
+		return -1;
+	}
+
+	// The leaves are the even nodes.  last_i is the rightmost node of the
+	// current level, and last the largest end below it, which stands in for
+	// the right children that are past the end of the array.
+	long last_i = 0;
+	int last = 0;
+	for(long i=0; i<n; i+=2){
+		last_i = i;
+		last = a[i].max_end = a[i].end;
+	}
+
+	int k = 1;
+	for( ; (1L << k) <= n; ++k){
+		long x = 1L << (k - 1);
+		for(long i = (x << 1) - 1; i < n; i += x << 2){
+			int end_left = a[i - x].max_end;
+			int end_right = i + x < n ? a[i + x].max_end : last;
+			a[i].max_end = std::max(a[i].end, std::max(end_left, end_right));
+		}
+		last_i = ((last_i >> k) & 1) ? last_i - x : last_i + x;
+		if(last_i < n && a[last_i].max_end > last){
+			last = a[last_i].max_end;
+		}
+	}
+	return k - 1;
+}
+
+template <class T>
+template <class F>
+void IntervalIndex<T>::find(short chr, int pos, int region_id, F& fn) const{
+	typename std::map<short, Chrom>::const_iterator c_itr = _chroms.find(chr);
+	if(c_itr == _chroms.end()){
+		return;
+	}
+	const Chrom& c = (*c_itr).second;
+
+	const std::vector<Range>& a = c.ranges;
+	long n = a.size();
+	if(n){
+		// top-down traversal; a node is pushed again once its left subtree
+		// has been visited
+		struct Node{
+			long x;
+			int level;
+			bool left_done;
+		} stack[64];
+		int t = 0;
+		stack[t].x = (1L << c.root_level) - 1;
+		stack[t].level = c.root_level;
+		stack[t++].left_done = false;
+
+		while(t){
+			Node z = stack[--t];
+			if(z.level <= 3){
+				// small subtree: scan it
+				long i = z.x >> z.level << z.level;
+				long i_end = std::min(i + (1L << (z.level + 1)) - 1, n);
+				for( ; i < i_end && a[i].start <= pos; i++){
+					if(a[i].end >= pos && (a[i].region_id == ANY_REGION || a[i].region_id == region_id)){
+						fn(a[i].value);
+					}
+				}
+			} else if(!z.left_done){
+				long y = z.x - (1L << (z.level - 1));
+				stack[t].x = z.x;
+				stack[t].level = z.level;
+				stack[t++].left_done = true;
+				// the left child may be past the end of the array
+				if(y >= n || a[y].max_end >= pos){
+					stack[t].x = y;
+					stack[t].level = z.level - 1;
+					stack[t++].left_done = false;
+				}
+			} else if(z.x < n && a[z.x].start <= pos){
+				if(a[z.x].end >= pos && (a[z.x].region_id == ANY_REGION || a[z.x].region_id == region_id)){
+					fn(a[z.x].value);
+				}
+				stack[t].x = z.x + (1L << (z.level - 1));
+				stack[t].level = z.level - 1;
+				stack[t++].left_done = false;
+			}
+		}
+	}
+
+	typename std::vector<Position>::const_iterator p_itr =
+			std::lower_bound(c.positions.begin(), c.positions.end(), pos, comparePos);
+	for( ; p_itr != c.positions.end() && (*p_itr).pos == pos; ++p_itr){
+		if((*p_itr).region_id == ANY_REGION || (*p_itr).region_id == region_id){
+			fn((*p_itr).value);
+		}
+	}
+}
+
+}
+
+#endif /* KNOWLEDGE_INTERVALINDEX_H */
@@ -0,0 +1,378 @@
+/*
+ * KnowledgeSnapshot.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "KnowledgeSnapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include <boost/functional/hash.hpp>
+
+#include "Information.h"
+#include "RegionCollection.h"
+#include "GroupCollection.h"
+
+#include "biobin/main.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+using boost::unordered_map;
+
+namespace Knowledge{
+
+namespace {
+
+const char BBK_MAGIC[4] = {'B', 'B', 'K', '2'};
+
+template <typename T>
+void writeVal(std::ostream& o, const T& val){
+	o.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+void writeString(std::ostream& o, const string& s){
+	writeVal(o, static_cast<boost::uint32_t>(s.size()));
+	o.write(s.data(), s.size());
+}
+
+void writePairs(std::ostream& o, const vector<pair<unsigned int, unsigned int> >& v){
+	writeVal(o, static_cast<boost::uint32_t>(v.size()));
+	vector<pair<unsigned int, unsigned int> >::const_iterator itr = v.begin();
+	for( ; itr != v.end(); ++itr){
+		writeVal(o, static_cast<boost::uint32_t>((*itr).first));
+		writeVal(o, static_cast<boost::uint32_t>((*itr).second));
+	}
+}
+
+/*
+ * Reads values from the buffer holding the whole file; every read fails once
+ * the buffer is exhausted.
+ */
+class Reader{
+public:
+	Reader(const char* begin, const char* end) : _pos(begin), _end(end) {}
+
+	template <typename T>
+	bool read(T& val_out){
+		if(static_cast<std::size_t>(_end - _pos) < sizeof(T)){
+			return false;
+		}
+		memcpy(&val_out, _pos, sizeof(T));
+		_pos += sizeof(T);
+		return true;
+	}
+
+	bool read(string& s_out){
+		boost::uint32_t len;
+		if(!read(len) || static_cast<std::size_t>(_end - _pos) < len){
+			return false;
+		}
+		s_out.assign(_pos, _pos + len);
+		_pos += len;
+		return true;
+	}
+
+	//! Whether n records of record_size bytes could still be in the file
+	bool fits(boost::uint32_t n, std::size_t record_size) const{
+		return n <= static_cast<std::size_t>(_end - _pos) / record_size;
+	}
+
+	bool readPairs(vector<pair<unsigned int, unsigned int> >& v_out){
+		boost::uint32_t n, first, second;
+		if(!read(n) || !fits(n, 2 * sizeof(boost::uint32_t))){
+			return false;
+		}
+		v_out.reserve(n);
+		for(boost::uint32_t i=0; i<n; i++){
+			if(!read(first) || !read(second)){
+				return false;
+			}
+			v_out.push_back(std::make_pair(first, second));
+		}
+		return true;
+	}
+
+private:
+	const char* _pos;
+	const char* _end;
+};
+
+}
+
+KnowledgeSnapshot::KnowledgeSnapshot() : _key(0), _present(0), _modified(false) {}
+
+bool KnowledgeSnapshot::open(const string& fn, boost::uint64_t key){
+	_fn = fn;
+	_key = key;
+	clear();
+
+	std::ifstream in(fn.c_str(), std::ios_base::in | std::ios_base::binary);
+	if(!in.is_open()){
+		return false;
+	}
+
+	// Read the whole thing at once
+	in.seekg(0, std::ios_base::end);
+	std::streamoff size = in.tellg();
+	in.seekg(0, std::ios_base::beg);
+	if(size <= 0){
+		return false;
+	}
+	vector<char> buf(static_cast<std::size_t>(size));
+	in.read(&buf[0], size);
+	if(in.gcount() != size){
+		return false;
+	}
+
+	if(!parse(buf)){
+		clear();
+		return false;
+	}
+	return true;
+}
+
+bool KnowledgeSnapshot::parse(const vector<char>& buf){
+	Reader r(&buf[0], &buf[0] + buf.size());
+
+	char magic[4];
+	boost::uint64_t key;
+	boost::uint32_t present;
+	if(!r.read(magic) || memcmp(magic, BBK_MAGIC, sizeof(BBK_MAGIC)) != 0
+			|| !r.read(key) || key != _key || !r.read(present)){
+		return false;
+	}
+
+	boost::uint32_t n, id;
+	if(present & REGIONS){
+		boost::uint32_t n_db_rows;
+		// check every count against what is left of the file before sizing
+		// anything by it, so a corrupt count can't allocate gigabytes
+		if(!r.read(_regions.filter) || !r.read(n_db_rows) || !r.read(n) ||
+				!r.fits(n, sizeof(boost::uint32_t) + 3 * sizeof(boost::int32_t) +
+						sizeof(boost::int16_t))){
+			return false;
+		}
+		_regions.n_db_rows = n_db_rows;
+		_regions.rows.resize(n);
+		for(boost::uint32_t i=0; i<n; i++){
+			RegionRow& row = _regions.rows[i];
+			boost::int32_t ldprofile_id, posMin, posMax;
+			boost::int16_t chr;
+			if(!r.read(id) || !r.read(ldprofile_id) || !r.read(chr) ||
+					!r.read(posMin) || !r.read(posMax)){
+				return false;
+			}
+			row.id = id;
+			row.ldprofile_id = ldprofile_id;
+			row.chr = chr;
+			row.posMin = posMin;
+			row.posMax = posMax;
+		}
+
+		if(!r.read(n)){
+			return false;
+		}
+		for(boost::uint32_t i=0; i<n; i++){
+			if(!r.read(id) || !r.read(_regions.labels[id])){
+				return false;
+			}
+		}
+
+		if(!r.read(n)){
+			return false;
+		}
+		for(boost::uint32_t i=0; i<n; i++){
+			boost::uint32_t n_alias;
+			if(!r.read(id) || !r.read(n_alias) || !r.fits(n_alias, sizeof(boost::uint32_t))){
+				return false;
+			}
+			vector<string>& aliases = _regions.aliases[id];
+			aliases.resize(n_alias);
+			for(boost::uint32_t j=0; j<n_alias; j++){
+				if(!r.read(aliases[j])){
+					return false;
+				}
+			}
+		}
+	}
+
+	if(present & GROUPS){
+		if(!r.read(n)){
+			return false;
+		}
+		for(boost::uint32_t i=0; i<n; i++){
+			if(!r.read(id)){
+				return false;
+			}
+			GroupRow& gp = _groups.groups[id];
+			if(!r.read(gp.name) || !r.read(gp.desc)){
+				return false;
+			}
+		}
+		if(!r.readPairs(_groups.region_groups) || !r.readPairs(_groups.child_parents)){
+			return false;
+		}
+	}
+
+	if(present & ROLES){
+		if(!r.read(n) || !r.fits(n, sizeof(boost::int16_t) + 2 * sizeof(boost::int32_t) +
+				sizeof(boost::uint64_t))){
+			return false;
+		}
+		_roles.resize(n);
+		for(boost::uint32_t i=0; i<n; i++){
+			boost::int16_t chr;
+			boost::int32_t pos, region_id;
+			boost::uint64_t role;
+			if(!r.read(chr) || !r.read(pos) || !r.read(region_id) || !r.read(role)){
+				return false;
+			}
+			_roles[i].chr = chr;
+			_roles[i].pos = pos;
+			_roles[i].region_id = region_id;
+			_roles[i].role = role;
+		}
+	}
+
+	_present = present;
+	return true;
+}
+
+void KnowledgeSnapshot::clear(){
+	_present = 0;
+	_modified = false;
+	_regions = RegionData();
+	_groups = GroupData();
+	_roles.clear();
+}
+
+bool KnowledgeSnapshot::write(){
+	string tmp_fn = _fn + ".tmp";
+	std::ofstream out(tmp_fn.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!out.is_open()){
+		std::cerr << "WARNING: Unable to write knowledge cache " << _fn << std::endl;
+		return false;
+	}
+
+	out.write(BBK_MAGIC, sizeof(BBK_MAGIC));
+	writeVal(out, _key);
+	writeVal(out, static_cast<boost::uint32_t>(_present));
+
+	if(_present & REGIONS){
+		writeVal(out, _regions.filter);
+		writeVal(out, static_cast<boost::uint32_t>(_regions.n_db_rows));
+		writeVal(out, static_cast<boost::uint32_t>(_regions.rows.size()));
+		vector<RegionRow>::const_iterator r_itr = _regions.rows.begin();
+		for( ; r_itr != _regions.rows.end(); ++r_itr){
+			writeVal(out, static_cast<boost::uint32_t>((*r_itr).id));
+			writeVal(out, static_cast<boost::int32_t>((*r_itr).ldprofile_id));
+			writeVal(out, static_cast<boost::int16_t>((*r_itr).chr));
+			writeVal(out, static_cast<boost::int32_t>((*r_itr).posMin));
+			writeVal(out, static_cast<boost::int32_t>((*r_itr).posMax));
+		}
+
+		writeVal(out, static_cast<boost::uint32_t>(_regions.labels.size()));
+		unordered_map<unsigned int, string>::const_iterator l_itr = _regions.labels.begin();
+		for( ; l_itr != _regions.labels.end(); ++l_itr){
+			writeVal(out, static_cast<boost::uint32_t>((*l_itr).first));
+			writeString(out, (*l_itr).second);
+		}
+
+		writeVal(out, static_cast<boost::uint32_t>(_regions.aliases.size()));
+		unordered_map<unsigned int, vector<string> >::const_iterator a_itr = _regions.aliases.begin();
+		for( ; a_itr != _regions.aliases.end(); ++a_itr){
+			writeVal(out, static_cast<boost::uint32_t>((*a_itr).first));
+			writeVal(out, static_cast<boost::uint32_t>((*a_itr).second.size()));
+			for(unsigned int i=0; i<(*a_itr).second.size(); i++){
+				writeString(out, (*a_itr).second[i]);
+			}
+		}
+	}
+
+	if(_present & GROUPS){
+		writeVal(out, static_cast<boost::uint32_t>(_groups.groups.size()));
+		unordered_map<unsigned int, GroupRow>::const_iterator g_itr = _groups.groups.begin();
+		for( ; g_itr != _groups.groups.end(); ++g_itr){
+			writeVal(out, static_cast<boost::uint32_t>((*g_itr).first));
+			writeString(out, (*g_itr).second.name);
+			writeString(out, (*g_itr).second.desc);
+		}
+		writePairs(out, _groups.region_groups);
+		writePairs(out, _groups.child_parents);
+	}
+
+	if(_present & ROLES){
+		writeVal(out, static_cast<boost::uint32_t>(_roles.size()));
+		vector<RoleRow>::const_iterator r_itr = _roles.begin();
+		for( ; r_itr != _roles.end(); ++r_itr){
+			writeVal(out, static_cast<boost::int16_t>((*r_itr).chr));
+			writeVal(out, static_cast<boost::int32_t>((*r_itr).pos));
+			writeVal(out, static_cast<boost::int32_t>((*r_itr).region_id));
+			writeVal(out, static_cast<boost::uint64_t>((*r_itr).role));
+		}
+	}
+
+	out.close();
+	if(out.fail() || std::rename(tmp_fn.c_str(), _fn.c_str()) != 0){
+		std::cerr << "WARNING: Unable to write knowledge cache " << _fn << std::endl;
+		std::remove(tmp_fn.c_str());
+		return false;
+	}
+
+	_modified = false;
+	return true;
+}
+
+boost::uint64_t KnowledgeSnapshot::getKey(sqlite3* db, const string& db_fn){
+	// Anything that changes what is read from the database or the region
+	// files must go into the key
+	std::size_t key = 0;
+	boost::hash_combine(key, db_fn);
+	struct stat db_stat;
+	if(stat(db_fn.c_str(), &db_stat) == 0){
+		boost::hash_combine(key, db_stat.st_size);
+		boost::hash_combine(key, db_stat.st_mtime);
+	}
+
+	// LOKI records its version, build and so on in the setting table
+	sqlite3_stmt* setting_stmt;
+	sqlite3_prepare_v2(db, "SELECT setting, value FROM setting ORDER BY setting, value",
+			-1, &setting_stmt, NULL);
+	while(sqlite3_step(setting_stmt) == SQLITE_ROW){
+		for(int i=0; i<2; i++){
+			const unsigned char* val = sqlite3_column_text(setting_stmt, i);
+			boost::hash_combine(key, string(val ? (const char*) val : ""));
+		}
+	}
+	sqlite3_finalize(setting_stmt);
+
+	boost::hash_combine(key, BioBin::Main::c_genome_build);
+	boost::hash_combine(key, Information::c_source_names);
+	boost::hash_combine(key, Information::c_source_exclude);
+	boost::hash_combine(key, RegionCollection::pop_str);
+	boost::hash_combine(key, RegionCollection::c_region_filter);
+	boost::hash_combine(key, static_cast<int>(GroupCollection::c_ambiguity));
+
+	// The region files are small, so hash their contents
+	vector<string>::const_iterator fn_itr = RegionCollection::c_region_files.begin();
+	for( ; fn_itr != RegionCollection::c_region_files.end(); ++fn_itr){
+		boost::hash_combine(key, *fn_itr);
+		std::ifstream data_file((*fn_itr).c_str());
+		std::stringstream contents;
+		contents << data_file.rdbuf();
+		boost::hash_combine(key, contents.str());
+	}
+
+	return key;
+}
+
+}
@@ -0,0 +1,156 @@
+/*
+ * KnowledgeSnapshot.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef KNOWLEDGE_KNOWLEDGESNAPSHOT_H
+#define KNOWLEDGE_KNOWLEDGESNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <sqlite3.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace Knowledge{
+
+/*!
+ * \brief A binary snapshot of the knowledge read from a LOKI database.
+ * Reading the regions, groups and roles out of a LOKI database (and lifting
+ * over the custom region files) takes far longer than using them, and none
+ * of it depends on the VCF.  Everything read is kept here, before it is
+ * matched to any loci, and saved to a file that later runs read back in a
+ * single read.  The file is tagged with a key computed from the database and
+ * every setting that affects what is read (see getKey); a file with a
+ * different key is ignored and rewritten.
+ *
+ * Each section is filled only when it is first needed (the roles, for
+ * example, only when expanding by role), so a snapshot saved without a
+ * section gains it the first time a later run needs it.
+ *
+ * Layout (native byte order):
+ *   header: "BBK2", uint64 key, uint32 sections present
+ *   regions: uint64 filter, uint32 n_db_rows, uint32 n_rows,
+ *            n_rows * (uint32 id, int32 ldprofile, int16 chr, int32 posMin, int32 posMax),
+ *            uint32 n_labels, n_labels * (uint32 id, string label),
+ *            uint32 n_aliased, n_aliased * (uint32 id, uint32 n, n * string alias)
+ *   groups: uint32 n_groups, n_groups * (uint32 id, string name, string desc),
+ *           uint32 n, n * (uint32 region id, uint32 group id),
+ *           uint32 n, n * (uint32 child id, uint32 parent id)
+ *   roles: uint32 n, n * (int16 chr, int32 pos, int32 region id, uint64 role)
+ * where a string is a uint32 length followed by the characters.
+ */
+class KnowledgeSnapshot {
+public:
+	enum Section { REGIONS = 1, GROUPS = 2, ROLES = 4 };
+
+	//! A single boundary of a region, as read from the database or a file
+	struct RegionRow{
+		unsigned int id;
+		int ldprofile_id;
+		short chr;
+		int posMin;
+		int posMax;
+	};
+
+	struct RegionData{
+		RegionData() : filter(0), n_db_rows(0) {}
+
+		//! Hash of the IDs and aliases the regions were filtered by
+		boost::uint64_t filter;
+		//! The boundaries from the database, sorted by position, followed by
+		//! those from the region files
+		std::vector<RegionRow> rows;
+		unsigned int n_db_rows;
+		boost::unordered_map<unsigned int, std::string> labels;
+		//! The aliases of the regions from the database, in database order
+		boost::unordered_map<unsigned int, std::vector<std::string> > aliases;
+	};
+
+	struct GroupRow{
+		std::string name;
+		std::string desc;
+	};
+
+	struct GroupData{
+		boost::unordered_map<unsigned int, GroupRow> groups;
+		//! (region ID, group ID) for every region in a group, sorted
+		std::vector<std::pair<unsigned int, unsigned int> > region_groups;
+		//! (child ID, parent ID) for every group contained in another, sorted
+		std::vector<std::pair<unsigned int, unsigned int> > child_parents;
+	};
+
+	//! The role of a SNP in a region
+	struct RoleRow{
+		short chr;
+		int pos;
+		int region_id;
+		unsigned long role;
+	};
+
+	KnowledgeSnapshot();
+
+	/*!
+	 * \brief Reads an existing snapshot file.
+	 * The file name and key are kept for write(), even if the file cannot be
+	 * used.
+	 *
+	 * \return false if the file does not exist, is damaged or was written with
+	 * a different key, in which case the snapshot is left empty.
+	 */
+	bool open(const std::string& fn, boost::uint64_t key);
+
+	//! Determines if the given section was read from the file or filled since
+	bool has(Section s) const {return _present & s;}
+
+	//! Marks a section as filled from the database, to be saved by write()
+	void setLoaded(Section s) {_present |= s; _modified = true;}
+
+	//! Determines if any section was filled since the snapshot was opened
+	bool isModified() const {return _modified;}
+
+	/*!
+	 * \brief Saves every section present to the file given to open().
+	 * The data is written to a temporary file that replaces the snapshot when
+	 * done, so an interrupted run never leaves a partial snapshot behind.
+	 */
+	bool write();
+
+	RegionData& getRegionData() {return _regions;}
+	GroupData& getGroupData() {return _groups;}
+	std::vector<RoleRow>& getRoles() {return _roles;}
+
+	/*!
+	 * \brief Computes the key of the knowledge read from the given database
+	 * with the current settings.
+	 *
+	 * \param db The open LOKI database
+	 * \param db_fn The file name of the LOKI database
+	 */
+	static boost::uint64_t getKey(sqlite3* db, const std::string& db_fn);
+
+private:
+	// No copying or assignment!
+	KnowledgeSnapshot(const KnowledgeSnapshot&);
+	KnowledgeSnapshot& operator=(const KnowledgeSnapshot&);
+
+	bool parse(const std::vector<char>& buf);
+	void clear();
+
+	std::string _fn;
+	boost::uint64_t _key;
+	unsigned int _present;
+	bool _modified;
+
+	RegionData _regions;
+	GroupData _groups;
+	std::vector<RoleRow> _roles;
+};
+
+}
+
+#endif /* KNOWLEDGE_KNOWLEDGESNAPSHOT_H */
@@ -34,6 +34,7 @@ const vector<string> Locus::_chrom_list(__vinit, __vinit + (sizeof(__vinit) / si
 const string Locus::invalid_chrom("");
 
 pool<> Locus::s_locus_pool(sizeof(Locus));
+boost::mutex Locus::s_locus_pool_lock;
 
 void* Locus::operator new(size_t size) {
 	if (size != sizeof(Locus)) {
@@ -41,7 +42,10 @@ void* Locus::operator new(size_t size) {
 	}
 	void * ret_val = 0;
 	while (!ret_val) {
-		ret_val = s_locus_pool.malloc();
+		{
+			boost::mutex::scoped_lock l(s_locus_pool_lock);
+			ret_val = s_locus_pool.malloc();
+		}
 
 		// Do rituals for out-of-memory conditions here!
 		if (!ret_val) {
@@ -68,11 +72,12 @@ void Locus::operator delete(void* deadObj, size_t size) {
 		return;
 	}
 
+	boost::mutex::scoped_lock l(s_locus_pool_lock);
 	s_locus_pool.free(deadObj);
 }
 
 Locus::Locus(short chrom, uint pos, const string& id, const string& ref):
-		_chrom(chrom), _pos(pos), _id(id){
+		_chrom(chrom), _pos(pos), _id(id), _ordinal(NO_ORDINAL){
 	if (id.size() == 0 || _id == "."){
 		createID(ref);
 	}
@@ -80,7 +85,7 @@ Locus::Locus(short chrom, uint pos, const string& id, const string& ref):
 }
 
 Locus::Locus(const string& chrom_str, uint pos, const string& id, const string& ref):
-		_chrom(getChrom(chrom_str)), _pos(pos), _id(id){
+		_chrom(getChrom(chrom_str)), _pos(pos), _id(id), _ordinal(NO_ORDINAL){
 	if (_id.size() == 0 || _id == "."){
 		createID(ref);
 	}
@@ -15,6 +15,7 @@
 #include <ostream>
 #include <stdlib.h>
 #include <boost/pool/pool.hpp>
+#include <boost/thread/mutex.hpp>
 #include <new>
 
 //#include "Allele.h"
@@ -108,6 +109,14 @@ public:
 	 */
 	unsigned int getPos() const { return _pos;  }
 
+	/*!
+	 * \brief Returns the dense index of this Locus' genotype data.
+	 * The ordinal is assigned by whoever loads the data for this Locus (see
+	 * PopulationManager), and is NO_ORDINAL if no data has been loaded.
+	 */
+	unsigned int getOrdinal() const { return _ordinal; }
+	void setOrdinal(unsigned int ordinal) { _ordinal = ordinal; }
+
 	/*!
 	 * \brief Returns the distance to another Locus.
 	 * Gives the distance (absolute value of the difference of the positions)
@@ -162,6 +171,8 @@ public:
 
 	static const unsigned short UNKNOWN_CHROM = static_cast<unsigned short>(-1);
 
+	static const unsigned int NO_ORDINAL = static_cast<unsigned int>(-1);
+
 private:
 	// No copying or assigning - use pointers, please!
 	Locus(const Locus&);
@@ -182,12 +193,16 @@ private:
 	unsigned int _pos;
 	// Identifier of this Locus (could be a RSID or anything)
 	std::string _id;
+	// Index into the genotype data (see getOrdinal)
+	unsigned int _ordinal;
 
 	// Vector of a list of chromosomes
 	static const std::vector<std::string> _chrom_list;
 
 	// memory pool of Locus objects (for speed, Locus objects are fairly lightweight)
 	static boost::pool<> s_locus_pool;
+	// boost::pool is not thread-safe, and loci are created by the VCF parsing threads
+	static boost::mutex s_locus_pool_lock;
 
 };
 
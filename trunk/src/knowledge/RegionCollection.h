@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
+#include <utility>
 
 #include "any_iterator.hpp"
 
@@ -233,6 +235,21 @@ public:
 
 	virtual void loadFiles() = 0;
 
+	//! Genomic intervals (1-based, inclusive), keyed by chromosome
+	typedef std::map<short, std::vector<std::pair<unsigned int, unsigned int> > > bound_map;
+
+	/*!
+	 * \brief Finds the genomic intervals that the Regions to be loaded cover.
+	 * Used to restrict the loci read from the data to those that could fall
+	 * in a Region.  This may be called before Load.
+	 *
+	 * \param bounds_out The intervals, padded by gene_expansion
+	 *
+	 * \return true if the Regions to be loaded are restricted (i.e. if
+	 * bounds_out is meaningful), false if every Region will be loaded.
+	 */
+	virtual bool getLoadBounds(bound_map& /*bounds_out*/) const {return false;}
+
 	/*!
 	 * \brief Calls Load(...) with an empty ID list.
 	 * Calls the Load function with an empty ID list.  This should not be
@@ -12,8 +12,11 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <functional>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/functional/hash.hpp>
 
 #include "liftover/ConverterSQLite.h"
 #include "Locus.h"
@@ -33,14 +36,65 @@ using boost::algorithm::is_any_of;
 
 namespace Knowledge{
 
-string RegionCollectionSQLite::_s_tmp_region_tbl = "__tmp_region";
-string RegionCollectionSQLite::_s_tmp_zone_tbl = "__tmp_zone";
-string RegionCollectionSQLite::_s_tmp_name_tbl = "__tmp_name";
-string RegionCollectionSQLite::_s_tmp_bound_tbl = "__tmp_bound";
+namespace {
+
+// Orders indexes of loci by position, then index
+struct LocusOrder{
+	LocusOrder(const vector<const Locus*>& loci) : _loci(loci) {}
+	bool operator()(uint a, uint b) const{
+		short chr_a = _loci[a]->getChrom();
+		short chr_b = _loci[b]->getChrom();
+		if(chr_a != chr_b){
+			return chr_a < chr_b;
+		}
+		if(_loci[a]->getPos() != _loci[b]->getPos()){
+			return _loci[a]->getPos() < _loci[b]->getPos();
+		}
+		return a < b;
+	}
+	const vector<const Locus*>& _loci;
+};
+
+// Orders indexes of region boundaries by start, then index
+template <class T_row>
+struct RowOrder{
+	RowOrder(const vector<T_row>& rows) : _rows(rows) {}
+	bool operator()(uint a, uint b) const{
+		if(_rows[a].chr != _rows[b].chr){
+			return _rows[a].chr < _rows[b].chr;
+		}
+		if(_rows[a].posMin != _rows[b].posMin){
+			return _rows[a].posMin < _rows[b].posMin;
+		}
+		return a < b;
+	}
+	const vector<T_row>& _rows;
+};
+
+// Orders region boundaries by position, then ID
+template <class T_row>
+bool rowLess(const T_row& a, const T_row& b){
+	if(a.chr != b.chr){
+		return a.chr < b.chr;
+	}
+	if(a.posMin != b.posMin){
+		return a.posMin < b.posMin;
+	}
+	if(a.posMax != b.posMax){
+		return a.posMax < b.posMax;
+	}
+	return a.id < b.id;
+}
+
+template <class T_row>
+bool rowEqual(const T_row& a, const T_row& b){
+	return a.id == b.id && a.chr == b.chr && a.posMin == b.posMin && a.posMax == b.posMax;
+}
+
+}
 
 RegionCollectionSQLite::~RegionCollectionSQLite(){
 	sqlite3_finalize(_region_name_stmt);
-	sqlite3_finalize(_region_bound_stmt);
 
 	if (self_open){
 		sqlite3_close(db);
@@ -51,101 +105,39 @@ RegionCollectionSQLite::~RegionCollectionSQLite(){
 }
 
 void RegionCollectionSQLite::loadFiles(){
+	_file_rows.clear();
+	_file_labels.clear();
+
 	// Only do this if we have something to load
 	if (c_region_files.size() == 0){
 		return;
 	}
 
-	string tmp_region_sql = "CREATE TEMPORARY TABLE " + _s_tmp_region_tbl + " ("
-			"region_id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,"
-			"label VARCHAR(64) NOT NULL"
-		")";
-
-	sqlite3_exec(db, tmp_region_sql.c_str(), NULL, NULL, NULL);
-
-	string tmp_bound_sql = "CREATE TEMPORARY TABLE " + _s_tmp_bound_tbl + "("
-			"region_id INTEGER NOT NULL,"
-			"chr TINYINT NOT NULL,"
-			"posMin BIGINT NOT NULL,"
-			"posMax BIGINT NOT NULL,"
-			"PRIMARY KEY (region_id, chr, posMin, posMax)"
-		")";
-
-	sqlite3_exec(db, tmp_bound_sql.c_str(), NULL, NULL, NULL);
-
-	string tmp_name_sql = "CREATE TEMPORARY TABLE " + _s_tmp_name_tbl + " ("
-			"region_id INTEGER NOT NULL,"
-			"name VARCHAR(64) NOT NULL PRIMARY KEY"
-		");";
-
-	sqlite3_exec(db, tmp_name_sql.c_str(), NULL, NULL, NULL);
-
-
-	string tmp_zone_sql = "CREATE TEMPORARY TABLE " + _s_tmp_zone_tbl + " ("
-			"region_id INTEGER NOT NULL,"
-			"chr TINYINT NOT NULL,"
-			"zone INTEGER NOT NULL,"
-			"PRIMARY KEY (region_id, chr, zone)"
-		")";
-
-	sqlite3_exec(db, tmp_zone_sql.c_str(), NULL, NULL, NULL);
-
-	// Insert a phony record to set the autoincrement
-	string region_id_sql = "INSERT INTO " + _s_tmp_region_tbl + " "
-			"(region_id, label) "
-			"SELECT MAX(biopolymer_id), 'Fake' FROM biopolymer";
-
-	sqlite3_exec(db, region_id_sql.c_str(), NULL, NULL, NULL);
-
-	string region_id_del = "DELETE FROM " + _s_tmp_region_tbl;
-
-	sqlite3_exec(db, region_id_del.c_str(), NULL, NULL, NULL);
+	// The custom regions are numbered after the regions in the database
+	int max_id = 0;
+	string max_id_sql = "SELECT IFNULL(MAX(biopolymer_id), 0) FROM biopolymer";
+	sqlite3_exec(db, max_id_sql.c_str(), &parseSingleIntQuery, &max_id, NULL);
 
+	unordered_map<string, uint> name_ids;
 	vector<string>::const_iterator fn_itr = c_region_files.begin();
 	while(fn_itr != c_region_files.end()){
-		loadFile(*fn_itr);
+		loadFile(*fn_itr, name_ids, max_id + 1);
 		++fn_itr;
 	}
 
-	updateZones();
-
-	string reg_min_index_sql = "CREATE INDEX " + _s_tmp_region_tbl + "_posMin "
-			"ON " + _s_tmp_region_tbl + " (chr, posMin)";
-	string reg_max_index_sql = "CREATE INDEX " + _s_tmp_region_tbl + "_posMax "
-				"ON " + _s_tmp_region_tbl + " (chr, posMax)";
-
-	sqlite3_exec(db, reg_min_index_sql.c_str(), NULL, NULL, NULL);
-	sqlite3_exec(db, reg_max_index_sql.c_str(), NULL, NULL, NULL);
-
+	// Sort the boundaries once, and drop any given more than once
+	std::sort(_file_rows.begin(), _file_rows.end(), rowLess<RegionRow>);
+	_file_rows.erase(std::unique(_file_rows.begin(), _file_rows.end(), rowEqual<RegionRow>),
+			_file_rows.end());
 }
 
-void RegionCollectionSQLite::loadFile(const string& fn){
+void RegionCollectionSQLite::loadFile(const string& fn,
+		unordered_map<string, uint>& name_ids, uint first_id){
 
 	Knowledge::Liftover::ConverterSQLite cnv(BioBin::Main::c_genome_build, db);
 	int n_chains = cnv.Load();
 
-	string insert_bound_sql = "INSERT OR IGNORE INTO " + _s_tmp_bound_tbl + " "
-			"(region_id, chr, posMin, posMax) VALUES (?,?,?,?)";
-
-	string insert_region_sql = "INSERT INTO " + _s_tmp_region_tbl + " "
-			"(label) VALUES (?)";
-
-	string insert_name_sql = "INSERT OR IGNORE INTO " + _s_tmp_name_tbl + " "
-			"(region_id, name) VALUES (?,?)";
-
-	string find_region_sql = "SELECT region_id FROM " + _s_tmp_name_tbl + " "
-			"WHERE name=?";
-
-	sqlite3_stmt* insert_bound_stmt;
-	sqlite3_prepare_v2(db, insert_bound_sql.c_str(), -1, &insert_bound_stmt, NULL);
-	sqlite3_stmt* insert_region_stmt;
-	sqlite3_prepare_v2(db, insert_region_sql.c_str(), -1, &insert_region_stmt, NULL);
-	sqlite3_stmt* insert_name_stmt;
-	sqlite3_prepare_v2(db, insert_name_sql.c_str(), -1, &insert_name_stmt, NULL);
-	sqlite3_stmt* find_region_stmt;
-	sqlite3_prepare_v2(db, find_region_sql.c_str(), -1, &find_region_stmt, NULL);
-
-	// Find the file and upload it...
+	// Find the file and read it...
 	ifstream data_file(fn.c_str());
 	if (!data_file.is_open()) {
 		std::cerr << "WARNING: cannot find " << fn << ", ignoring.";
@@ -160,7 +152,6 @@ void RegionCollectionSQLite::loadFile(const string& fn){
 				int posMin = atoi(result[2].c_str());
 				int posMax = atoi(result[3].c_str());
 
-				// TODO: convert chr posMin and posMax here
 				if(n_chains > 0){
 					std::pair<short, std::pair<int, int> > newReg = cnv.convertRegion(chr, posMin, posMax + 1);
 					chr = newReg.first;
@@ -169,109 +160,95 @@ void RegionCollectionSQLite::loadFile(const string& fn){
 				}
 
 				if(chr != -1 && posMin && posMax){
-					int region_id = -1;
-					sqlite3_bind_text(find_region_stmt, 1, result[1].c_str(), -1, SQLITE_STATIC);
-					while(sqlite3_step(find_region_stmt) == SQLITE_ROW){
-						region_id = sqlite3_column_int(find_region_stmt, 0);
-					}
-					sqlite3_reset(find_region_stmt);
-
-					if(region_id == -1){
-						sqlite3_bind_text(insert_region_stmt, 1, result[1].c_str(), -1, SQLITE_STATIC);
-						while(sqlite3_step(insert_region_stmt) == SQLITE_ROW){}
-						sqlite3_reset(insert_region_stmt);
-
-						sqlite3_exec(db, "SELECT LAST_INSERT_ROWID()",  &parseSingleIntQuery, &region_id, NULL);
-
-						sqlite3_bind_text(insert_name_stmt, 2, result[1].c_str(), -1, SQLITE_STATIC);
-						sqlite3_bind_int(insert_name_stmt, 1, region_id);
-						while(sqlite3_step(insert_name_stmt) == SQLITE_ROW){}
-						sqlite3_reset(insert_name_stmt);
+					// The first region given a name keeps it
+					unordered_map<string, uint>::const_iterator n_itr = name_ids.find(result[1]);
+					uint region_id;
+					if(n_itr == name_ids.end()){
+						region_id = first_id + name_ids.size();
+						name_ids[result[1]] = region_id;
+						_file_labels[region_id] = result[1];
+					} else {
+						region_id = (*n_itr).second;
 					}
 
-					sqlite3_bind_int(insert_bound_stmt, 1, region_id);
-					sqlite3_bind_int(insert_bound_stmt, 2, chr);
-					sqlite3_bind_int(insert_bound_stmt, 3, posMin);
-					sqlite3_bind_int(insert_bound_stmt, 4, posMax);
-
-					while(sqlite3_step(insert_bound_stmt)==SQLITE_ROW) {}
-
-					sqlite3_reset(insert_bound_stmt);
+					RegionRow row;
+					row.id = region_id;
+					row.ldprofile_id = 0;
+					row.chr = chr;
+					// Reverse any regions that are backwards
+					row.posMin = std::min(posMin, posMax);
+					row.posMax = std::max(posMin, posMax);
+					_file_rows.push_back(row);
 				}
 			}
 		}
 		data_file.close();
 	}
-
-	sqlite3_finalize(insert_bound_stmt);
-	sqlite3_finalize(insert_region_stmt);
-	sqlite3_finalize(insert_name_stmt);
-	sqlite3_finalize(find_region_stmt);
 }
 
-void RegionCollectionSQLite::updateZones(){
-	// See loki_updater.py for the algorithm here
-
-	// Get the zone size
-	int zone_size=_info->getZoneSize();
-
-	// Reverse any regions that are backwards
-	string region_reverse_sql = "UPDATE " + _s_tmp_bound_tbl + " "
-			"SET posMin = posMax, posMax = posMin WHERE posMin > posMax";
-	sqlite3_exec(db, region_reverse_sql.c_str(), NULL, NULL, NULL);
-
-	// Find the minimum and maximum zone sizes
-	int minPos, maxPos = 0;
-	string min_pos_sql = "SELECT MIN(posMin) FROM " + _s_tmp_bound_tbl;
-	string max_pos_sql = "SELECT MAX(posMax) FROM " + _s_tmp_bound_tbl;
-
-	sqlite3_exec(db, min_pos_sql.c_str(), &parseSingleIntQuery, &minPos, NULL);
-	sqlite3_exec(db, max_pos_sql.c_str(), &parseSingleIntQuery, &maxPos, NULL);
-
-	minPos = minPos / zone_size;
-	maxPos = maxPos / zone_size;
+uint RegionCollectionSQLite::Load(const unordered_set<uint>& ids,
+		const vector<string>& alias_list){
 
-	// Insert all zones needed into a temporary table
-	string tmp_zone_tbl = "__t_zone_tmp";
-	string zone_tbl_sql = "CREATE TEMPORARY TABLE " + tmp_zone_tbl + " "
-			"(zone INTEGER PRIMARY KEY NOT NULL)";
-	sqlite3_exec(db, zone_tbl_sql.c_str(), NULL, NULL, NULL);
+	vector<string> aliases = alias_list;
+	aliases.insert(aliases.end(), c_region_filter.begin(), c_region_filter.end());
 
-	string zone_insert_query = "INSERT INTO " + tmp_zone_tbl + " VALUES (?)";
-	sqlite3_stmt* zone_ins_stmt;
-	sqlite3_prepare_v2(db, zone_insert_query.c_str(), -1, &zone_ins_stmt, NULL);
+	// Use the boundaries in the snapshot, if it has the ones we want
+	vector<uint> sorted_ids(ids.begin(), ids.end());
+	std::sort(sorted_ids.begin(), sorted_ids.end());
+	std::size_t filter = 0;
+	boost::hash_combine(filter, aliases);
+	boost::hash_combine(filter, sorted_ids);
+
+	RegionData local_data;
+	RegionData& data = _snapshot ? _snapshot->getRegionData() : local_data;
+	if(!_snapshot || !_snapshot->has(KnowledgeSnapshot::REGIONS) || data.filter != filter){
+		data = RegionData();
+		data.filter = filter;
+		readRegions(ids, aliases, data);
+		if(_snapshot){
+			readAliases(data);
+			_snapshot->setLoaded(KnowledgeSnapshot::REGIONS);
+		}
+	}
 
-	for (int i=minPos; i <= maxPos; i++){
-		sqlite3_bind_int(zone_ins_stmt, 1, i);
-		while(sqlite3_step(zone_ins_stmt) == SQLITE_ROW){}
-		sqlite3_reset(zone_ins_stmt);
+	unordered_map<uint, vector<uint> > region_rows;
+	for(uint i=0; i<data.n_db_rows; i++){
+		region_rows[data.rows[i].id].push_back(i);
 	}
-	sqlite3_finalize(zone_ins_stmt);
 
-	// OK, now we're ready to do some insertin'!
-	stringstream zone_ins_str;
-	zone_ins_str << "INSERT OR IGNORE INTO " << _s_tmp_zone_tbl << " (region_id,chr,zone) "
-			<< "SELECT rb.region_id, rb.chr, z.zone "
-			<< "FROM " << _s_tmp_bound_tbl << " AS rb JOIN " << tmp_zone_tbl << " AS z "
-			<< "ON z.zone >= rb.posMin / " << zone_size << " "
-			<< "AND z.zone <= rb.posMax / " << zone_size << " ";
+	vector<const Locus*> loci;
+	Container::const_iterator itr = _dataset->begin();
+	while(itr != _dataset->end()){
+		loci.push_back(*itr);
+		++itr;
+	}
 
-	string zone_ins_sql = zone_ins_str.str();
-	sqlite3_exec(db, zone_ins_sql.c_str(), NULL, NULL, NULL);
+	vector<pair<uint, uint> > hits;
+	findRegions(loci, data.rows, hits);
+
+	// Add the loci in the order of the dataset, so the regions are created
+	// in the same order as when each locus was queried in turn
+	vector<pair<uint, uint> >::const_iterator h_itr = hits.begin();
+	for( ; h_itr != hits.end(); ++h_itr){
+		const Locus* loc = loci[(*h_itr).first];
+		const RegionRow& row = data.rows[(*h_itr).second];
+
+		Knowledge::Region* reg;
+		if((*h_itr).second < data.n_db_rows){
+			reg = addRegion(row.id, data, region_rows[row.id]);
+		} else {
+			reg = AddRegion(data.labels[row.id], row.id, row.chr, row.posMin, row.posMax);
+		}
+		reg->addLocus(*loc);
+		_locus_map[loc].insert(reg);
+	}
 
-	string tmp_tbl_drop = "DROP TABLE " + tmp_zone_tbl;
-	sqlite3_exec(db, tmp_tbl_drop.c_str(), NULL, NULL, NULL);
+	return _region_map.size();
 
-	string index_sql = "CREATE INDEX " + _s_tmp_zone_tbl + "__zone ON " +
-			_s_tmp_zone_tbl + " (chr, zone, region_id)";
-	sqlite3_exec(db, index_sql.c_str(), NULL, NULL, NULL);
 }
 
-uint RegionCollectionSQLite::Load(const unordered_set<uint>& ids,
-		const vector<string>& alias_list){
-
-	vector<string> aliases = alias_list;
-	aliases.insert(aliases.end(), c_region_filter.begin(), c_region_filter.end());
+void RegionCollectionSQLite::readRegions(const unordered_set<uint>& ids,
+		const vector<string>& aliases, RegionData& data_out){
 
 	loadFiles();
 
@@ -293,34 +270,38 @@ uint RegionCollectionSQLite::Load(const unordered_set<uint>& ids,
 		sqlite3_exec(db, alias_stream.str().c_str(), parseRegionIDQuery, &id_list, NULL);
 	}
 
-	string where_clause = "WHERE ";
+	string where_clause = "WHERE biopolymer_region.ldprofile_id IN (:pop_id, :def_pop_id) ";
 
 	if (id_list.size() > 0) {
 		stringstream id_stream;
 		unordered_set<uint>::const_iterator itr = id_list.begin();
 
-		id_stream << "biopolymer.biopolymer_id IN (" << *itr;
+		id_stream << "AND biopolymer.biopolymer_id IN (" << *itr;
 		while(++itr != id_list.end()){
 			id_stream << "," << *itr;
 		}
-		id_stream << ") AND ";
+		id_stream << ") ";
 		where_clause += id_stream.str();
 	}
 
-	string command = "SELECT biopolymer.biopolymer_id, biopolymer.label "
-			"FROM biopolymer_zone "
-			"INNER JOIN biopolymer_region USING (biopolymer_id, chr) "
-			"INNER JOIN biopolymer USING (biopolymer_id) ";
-
-	where_clause += "biopolymer_zone.chr=:chrom AND biopolymer_region.ldprofile_id IN (:pop_id, :def_pop_id) "
-			"AND zone=:pos_zone AND biopolymer_region.posMin<=:pos AND biopolymer_region.posMax>=:pos ";
-
 	string src_str = _info->getSourceList();
 	if(src_str.size()){
 		where_clause += "AND biopolymer.source_id IN " + src_str;
 	}
 
-	string stmt = command + where_clause;
+	// Read every boundary of the regions we want at once, rather than
+	// querying for each locus.  Ordered by position, so the boundaries of
+	// each region (for each LD profile) are in the order of the primary key.
+	string command = "SELECT biopolymer_region.biopolymer_id, biopolymer.label, "
+			"biopolymer_region.ldprofile_id, biopolymer_region.chr, "
+			"biopolymer_region.posMin, biopolymer_region.posMax "
+			"FROM biopolymer_region "
+			"INNER JOIN biopolymer USING (biopolymer_id) ";
+
+	string order_clause = " ORDER BY biopolymer_region.chr, biopolymer_region.posMin, "
+			"biopolymer_region.posMax";
+
+	string stmt = command + where_clause + order_clause;
 
 	sqlite3_stmt* region_stmt;
 
@@ -328,69 +309,198 @@ uint RegionCollectionSQLite::Load(const unordered_set<uint>& ids,
 
 	int pop_idx = sqlite3_bind_parameter_index(region_stmt, ":pop_id");
 	int def_pop_idx = sqlite3_bind_parameter_index(region_stmt, ":def_pop_id");
-	int chr_idx = sqlite3_bind_parameter_index(region_stmt, ":chrom");
-	int pos_zone_idx = sqlite3_bind_parameter_index(region_stmt, ":pos_zone");
-	int pos_idx = sqlite3_bind_parameter_index(region_stmt, ":pos");
 
 	sqlite3_bind_int(region_stmt, pop_idx, _popID);
 	sqlite3_bind_int(region_stmt, def_pop_idx, _def_id);
 
-	sqlite3_stmt* tmp_region_stmt;
+	while(sqlite3_step(region_stmt) == SQLITE_ROW){
+		RegionRow row;
+		row.id = static_cast<uint>(sqlite3_column_int(region_stmt, 0));
+		row.ldprofile_id = sqlite3_column_int(region_stmt, 2);
+		row.chr = static_cast<short>(sqlite3_column_int(region_stmt, 3));
+		row.posMin = sqlite3_column_int(region_stmt, 4);
+		row.posMax = sqlite3_column_int(region_stmt, 5);
 
-	string tmp_region_sql = "SELECT z.region_id, label, z.chr, posMin, posMax "
-			"FROM " + _s_tmp_zone_tbl + " AS z "
-			"INNER JOIN " + _s_tmp_bound_tbl + " USING (region_id, chr) "
-			"INNER JOIN " + _s_tmp_region_tbl + " USING (region_id) "
-			"WHERE zone=:pos_zone AND z.chr=:chrom AND posMin<=:pos AND posMax>=:pos";
+		if(data_out.labels.find(row.id) == data_out.labels.end()){
+			data_out.labels[row.id] = (const char*) sqlite3_column_text(region_stmt, 1);
+		}
+		data_out.rows.push_back(row);
+	}
+	sqlite3_finalize(region_stmt);
 
-	sqlite3_prepare_v2(db, tmp_region_sql.c_str(), -1, &tmp_region_stmt, NULL);
+	// The custom regions come after the database regions, so each locus is
+	// added to them last, as before
+	data_out.n_db_rows = data_out.rows.size();
 
-	int tmp_pos_zone_idx = sqlite3_bind_parameter_index(tmp_region_stmt, ":pos_zone");
-	int tmp_chr_idx = sqlite3_bind_parameter_index(tmp_region_stmt, ":chrom");
-	int tmp_pos_idx = sqlite3_bind_parameter_index(tmp_region_stmt, ":pos");
+	data_out.rows.insert(data_out.rows.end(), _file_rows.begin(), _file_rows.end());
+	data_out.labels.insert(_file_labels.begin(), _file_labels.end());
+}
 
+void RegionCollectionSQLite::readAliases(RegionData& data){
+	// Read the aliases of every region at once, as we don't yet know which
+	// of the regions will be used.  Ordered as when querying for one region.
+	string alias_sql = "SELECT biopolymer_id, name FROM biopolymer_name "
+			"ORDER BY biopolymer_id, namespace_id, name";
 
-	// OK, now iterate over the dataset we have
-	Container::const_iterator itr = _dataset->begin();
-	int zone_size = _info->getZoneSize();
-	while(itr != _dataset->end()){
-		sqlite3_bind_int(region_stmt, chr_idx, (*itr)->getChrom());
-		sqlite3_bind_int(region_stmt, pos_idx, static_cast<int>((*itr)->getPos()));
-		sqlite3_bind_int(region_stmt, pos_zone_idx, (*itr)->getPos()/zone_size);
-
-		// Now, execute the query!
-		while(sqlite3_step(region_stmt) == SQLITE_ROW){
-			Knowledge::Region* reg = addRegion(region_stmt);
-			reg->addLocus(**itr);
-			_locus_map[*itr].insert(reg);
+	sqlite3_stmt* alias_stmt;
+	sqlite3_prepare_v2(db, alias_sql.c_str(), -1, &alias_stmt, NULL);
+
+	while(sqlite3_step(alias_stmt) == SQLITE_ROW){
+		uint id = static_cast<uint>(sqlite3_column_int(alias_stmt, 0));
+		if(data.labels.find(id) != data.labels.end()){
+			data.aliases[id].push_back((const char*) sqlite3_column_text(alias_stmt, 1));
 		}
-		sqlite3_reset(region_stmt);
-
-		if(c_region_files.size() != 0){
-			sqlite3_bind_int(tmp_region_stmt, tmp_chr_idx, (*itr)->getChrom());
-			sqlite3_bind_int(tmp_region_stmt, tmp_pos_idx, static_cast<int>((*itr)->getPos()));
-			sqlite3_bind_int(tmp_region_stmt, tmp_pos_zone_idx, (*itr)->getPos()/zone_size);
-
-			while(sqlite3_step(tmp_region_stmt) == SQLITE_ROW){
-				uint pop_id_result = sqlite3_column_int(tmp_region_stmt, 0);
-				string label = (const char*) (sqlite3_column_text(tmp_region_stmt, 1));
-				short chr = static_cast<short>(sqlite3_column_int(tmp_region_stmt, 2));
-				uint start = static_cast<uint>(sqlite3_column_int(tmp_region_stmt, 3));
-				uint end = static_cast<uint>(sqlite3_column_int(tmp_region_stmt, 4));
-				Knowledge::Region* reg = AddRegion(label, pop_id_result, chr, start, end);
-				reg->addLocus(**itr);
-				_locus_map[*itr].insert(reg);
+	}
+	sqlite3_finalize(alias_stmt);
+}
+
+void RegionCollectionSQLite::findRegions(const vector<const Locus*>& loci,
+		const vector<RegionRow>& rows, vector<pair<uint, uint> >& hits_out){
+
+	hits_out.clear();
+
+	vector<uint> locus_order(loci.size());
+	for(uint i=0; i<loci.size(); i++){
+		locus_order[i] = i;
+	}
+	std::sort(locus_order.begin(), locus_order.end(), LocusOrder(loci));
+
+	vector<uint> row_order(rows.size());
+	for(uint i=0; i<rows.size(); i++){
+		row_order[i] = i;
+	}
+	std::sort(row_order.begin(), row_order.end(), RowOrder<RegionRow>(rows));
+
+	// The rows whose start the sweep has passed, as a min-heap of
+	// (posMax, row index), so the rows that end before the current locus are
+	// always on top
+	vector<pair<int, uint> > active;
+	std::greater<pair<int, uint> > heap_cmp;
+
+	uint next_row = 0;
+	short curr_chr = 0;
+	for(uint i=0; i<locus_order.size(); i++){
+		short chr = loci[locus_order[i]]->getChrom();
+		int pos = static_cast<int>(loci[locus_order[i]]->getPos());
+
+		if(i == 0 || chr != curr_chr){
+			active.clear();
+			curr_chr = chr;
+			while(next_row < row_order.size() && rows[row_order[next_row]].chr < chr){
+				++next_row;
 			}
-			sqlite3_reset(tmp_region_stmt);
 		}
 
-		++itr;
+		while(next_row < row_order.size() && rows[row_order[next_row]].chr == chr &&
+				rows[row_order[next_row]].posMin <= pos){
+			active.push_back(std::make_pair(rows[row_order[next_row]].posMax, row_order[next_row]));
+			std::push_heap(active.begin(), active.end(), heap_cmp);
+			++next_row;
+		}
+
+		while(!active.empty() && active.front().first < pos){
+			std::pop_heap(active.begin(), active.end(), heap_cmp);
+			active.pop_back();
+		}
+
+		// Everything left started at or before pos and ends at or after it
+		vector<pair<int, uint> >::const_iterator a_itr = active.begin();
+		for( ; a_itr != active.end(); ++a_itr){
+			hits_out.push_back(std::make_pair(locus_order[i], (*a_itr).second));
+		}
 	}
 
-	sqlite3_finalize(region_stmt);
+	std::sort(hits_out.begin(), hits_out.end());
+}
 
-	return _region_map.size();
+bool RegionCollectionSQLite::getLoadBounds(bound_map& bounds_out) const{
+	bounds_out.clear();
+
+	// Without a filter, every region in the database will be loaded
+	if (c_region_filter.size() == 0){
+		return false;
+	}
+
+	unordered_set<uint> id_list;
+	stringstream alias_stream;
+	vector<string>::const_iterator a_itr = c_region_filter.begin();
+
+	alias_stream << "SELECT biopolymer_id FROM biopolymer_name WHERE name IN ('"
+			<< *a_itr << "'";
+
+	while(++a_itr != c_region_filter.end()){
+		alias_stream << ",'" << *a_itr << "'";
+	}
+
+	alias_stream << ")";
 
+	sqlite3_exec(db, alias_stream.str().c_str(), parseRegionIDQuery, &id_list, NULL);
+
+	// Load() also falls back to loading everything if no names matched
+	if (id_list.size() == 0){
+		return false;
+	}
+
+	stringstream bound_stream;
+	unordered_set<uint>::const_iterator itr = id_list.begin();
+	bound_stream << "SELECT biopolymer_region.chr, biopolymer_region.posMin, biopolymer_region.posMax "
+			<< "FROM biopolymer_region INNER JOIN biopolymer USING (biopolymer_id) "
+			<< "WHERE biopolymer_region.ldprofile_id IN (?, ?) "
+			<< "AND biopolymer.biopolymer_id IN (" << *itr;
+	while(++itr != id_list.end()){
+		bound_stream << "," << *itr;
+	}
+	bound_stream << ") ";
+
+	string src_str = _info->getSourceList();
+	if(src_str.size()){
+		bound_stream << "AND biopolymer.source_id IN " << src_str;
+	}
+
+	sqlite3_stmt* bound_stmt;
+	sqlite3_prepare_v2(db, bound_stream.str().c_str(), -1, &bound_stmt, NULL);
+	sqlite3_bind_int(bound_stmt, 1, _popID);
+	sqlite3_bind_int(bound_stmt, 2, _def_id);
+
+	while(sqlite3_step(bound_stmt) == SQLITE_ROW){
+		short chr = static_cast<short>(sqlite3_column_int(bound_stmt, 0));
+		int posMin = sqlite3_column_int(bound_stmt, 1) - gene_expansion;
+		int posMax = sqlite3_column_int(bound_stmt, 2) + gene_expansion;
+		bounds_out[chr].push_back(std::make_pair(
+				static_cast<uint>(std::max(posMin, 1)), static_cast<uint>(std::max(posMax, 1))));
+	}
+	sqlite3_finalize(bound_stmt);
+
+	// Custom regions are always loaded in full
+	vector<string>::const_iterator fn_itr = c_region_files.begin();
+	while(fn_itr != c_region_files.end()){
+		readFileBounds(*fn_itr, bounds_out);
+		++fn_itr;
+	}
+
+	return true;
+}
+
+void RegionCollectionSQLite::readFileBounds(const string& fn, bound_map& bounds_out){
+	ifstream data_file(fn.c_str());
+	string line;
+	vector<string> result;
+	while (data_file.good()) {
+		getline(data_file, line);
+		split(result, line, is_any_of(" \n\t"), boost::token_compress_on);
+		if(result.size() == 4 && result[0][0] != '#'){
+			short chr = Locus::getChrom(result[0]);
+			int posMin = atoi(result[2].c_str());
+			int posMax = atoi(result[3].c_str());
+			if(posMin > posMax){
+				std::swap(posMin, posMax);
+			}
+			if(chr != -1 && posMin > 0){
+				bounds_out[chr].push_back(std::make_pair(
+						static_cast<uint>(posMin), static_cast<uint>(posMax)));
+			}
+		}
+	}
 }
 
 void RegionCollectionSQLite::prepareStmts(){
@@ -400,18 +510,8 @@ void RegionCollectionSQLite::prepareStmts(){
 
 	sqlite3_prepare_v2(db, region_alias_sql.c_str(), -1, &_region_name_stmt, NULL);
 
-	string region_bound_sql = "SELECT ldprofile_id, chr, posMin, posMax "
-			"FROM biopolymer_region "
-			"WHERE biopolymer_id=? AND ldprofile_id IN (?, ?)";
-
-	sqlite3_prepare_v2(db, region_bound_sql.c_str(), -1, &_region_bound_stmt, NULL);
-
 	_popID = _info->getPopulationID(pop_str);
 	_def_id = _info->getPopulationID("");
-
-	sqlite3_bind_int(_region_bound_stmt, 2, _popID);
-	sqlite3_bind_int(_region_bound_stmt, 3, _def_id);
-
 }
 
 int RegionCollectionSQLite::parseRegionIDQuery(void* obj, int ncols, char** colVals, char** colNames){
@@ -430,35 +530,42 @@ int RegionCollectionSQLite::parseRegionIDQuery(void* obj, int ncols, char** colV
 
 }
 
-Knowledge::Region* RegionCollectionSQLite::addRegion(sqlite3_stmt* row){
-	uint id = static_cast<uint>(sqlite3_column_int(row, 0));
+Knowledge::Region* RegionCollectionSQLite::addRegion(uint id, const RegionData& data,
+		const vector<uint>& row_idx){
 	if(_region_map.find(id) != _region_map.end()){
 		return (* _region_map.find(id)).second;
 	} else {
-		string name = (const char*) sqlite3_column_text(row, 1);
-		Region* new_reg = new Region(name, id);
-
-		sqlite3_bind_int(_region_name_stmt, 1, id);
+		Region* new_reg = new Region((*data.labels.find(id)).second, id);
+
+		if(_snapshot){
+			unordered_map<uint, vector<string> >::const_iterator a_itr = data.aliases.find(id);
+			if(a_itr != data.aliases.end()){
+				vector<string>::const_iterator n_itr = (*a_itr).second.begin();
+				for( ; n_itr != (*a_itr).second.end(); ++n_itr){
+					new_reg->addAlias(*n_itr);
+				}
+			}
+		} else {
+			sqlite3_bind_int(_region_name_stmt, 1, id);
 
-		while(sqlite3_step(_region_name_stmt) == SQLITE_ROW){
-			new_reg->addAlias((const char *) sqlite3_column_text(_region_name_stmt, 0));
+			while(sqlite3_step(_region_name_stmt) == SQLITE_ROW){
+				new_reg->addAlias((const char *) sqlite3_column_text(_region_name_stmt, 0));
+			}
+			sqlite3_reset(_region_name_stmt);
 		}
-		sqlite3_reset(_region_name_stmt);
-
-		sqlite3_bind_int(_region_bound_stmt, 1, id);
-		while(sqlite3_step(_region_bound_stmt) == SQLITE_ROW){
-			int pop_id_result = sqlite3_column_int(_region_bound_stmt, 0);
-			short chr = static_cast<short>(sqlite3_column_int(_region_bound_stmt, 1));
-			uint start = static_cast<uint>(sqlite3_column_int(_region_bound_stmt, 2));
-			uint end = static_cast<uint>(sqlite3_column_int(_region_bound_stmt, 3));
-
-			if(pop_id_result == _def_id){
-				new_reg->addDefaultBoundary(chr, start, end);
-			}else if(pop_id_result == _popID){
-				new_reg->addPopulationBoundary(chr, start, end);
+
+		vector<uint>::const_iterator r_itr = row_idx.begin();
+		for( ; r_itr != row_idx.end(); ++r_itr){
+			const RegionRow& row = data.rows[*r_itr];
+			uint start = static_cast<uint>(row.posMin);
+			uint end = static_cast<uint>(row.posMax);
+
+			if(row.ldprofile_id == _def_id){
+				new_reg->addDefaultBoundary(row.chr, start, end);
+			}else if(row.ldprofile_id == _popID){
+				new_reg->addPopulationBoundary(row.chr, start, end);
 			}
 		}
-		sqlite3_reset(_region_bound_stmt);
 
 		insertRegion(*new_reg);
 
@@ -10,6 +10,7 @@
 
 #include "RegionCollection.h"
 #include "InformationSQLite.h"
+#include "KnowledgeSnapshot.h"
 
 #include <sqlite3.h>
 
@@ -69,6 +70,14 @@ public:
 
 	virtual void loadFiles();
 
+	virtual bool getLoadBounds(bound_map& bounds_out) const;
+
+	/*!
+	 * \brief Reads the region boundaries and aliases from the given snapshot,
+	 * if present, and adds them to it otherwise.
+	 */
+	void setSnapshot(KnowledgeSnapshot* snapshot) {_snapshot = snapshot;}
+
 private:
 	//! true if we opened the connection, false otherwise
 	bool self_open;
@@ -77,24 +86,60 @@ private:
 	sqlite3 *db;
 
 	sqlite3_stmt* _region_name_stmt;
-	sqlite3_stmt* _region_bound_stmt;
 
 	int _popID;
 	int _def_id;
 
-	static std::string _s_tmp_region_tbl;
-	static std::string _s_tmp_zone_tbl;
-	static std::string _s_tmp_name_tbl;
-	static std::string _s_tmp_bound_tbl;
+	typedef KnowledgeSnapshot::RegionRow RegionRow;
+	typedef KnowledgeSnapshot::RegionData RegionData;
+
+	KnowledgeSnapshot* _snapshot;
+
+	//! The boundaries of the regions in the region files, sorted by position
+	std::vector<RegionRow> _file_rows;
+	//! The labels of the regions in the region files, by ID
+	boost::unordered_map<uint, std::string> _file_labels;
+
+	/*!
+	 * \brief Reads the boundaries and labels of the regions to load from the
+	 * database and the region files.
+	 */
+	void readRegions(const boost::unordered_set<uint>& ids,
+			const std::vector<std::string>& aliases, RegionData& data_out);
+
+	//! Reads the aliases of all of the regions in data from the database
+	void readAliases(RegionData& data);
 
-	//! Adds a region based on the row (or returns the already added region)
-	Knowledge::Region* addRegion(sqlite3_stmt* row);
+	/*!
+	 * \brief Adds a region with the given boundaries (or returns the already
+	 * added region).
+	 * \param data All of the boundaries and labels read
+	 * \param row_idx The indexes in data.rows of the boundaries of this region
+	 */
+	Knowledge::Region* addRegion(uint id, const RegionData& data,
+			const std::vector<uint>& row_idx);
 
-	//! Adds the stuff from a single region file
-	void loadFile(const std::string& fn);
+	/*!
+	 * \brief Finds the boundaries that contain each locus.
+	 * Sweeps the loci and the boundaries of each chromosome together, both
+	 * sorted by position, so every locus is matched in a single pass.
+	 *
+	 * \param[out] hits_out Pairs of (locus index, row index), sorted
+	 */
+	static void findRegions(const std::vector<const Locus*>& loci,
+			const std::vector<RegionRow>& rows,
+			std::vector<std::pair<uint, uint> >& hits_out);
+
+	/*!
+	 * \brief Adds the stuff from a single region file.
+	 * \param name_ids The IDs of the regions named so far, by name
+	 * \param first_id The ID of the first region named in any file
+	 */
+	void loadFile(const std::string& fn,
+			boost::unordered_map<std::string, uint>& name_ids, uint first_id);
 
-	//! Creates zones for the temp region table
-	void updateZones();
+	//! Adds the bounds from a single region file, as given in the file
+	static void readFileBounds(const std::string& fn, bound_map& bounds_out);
 
 	//! Prepares some statments to be used in finding the row information
 	void prepareStmts();
@@ -109,7 +154,7 @@ private:
 
 template<class T_cont>
 RegionCollectionSQLite::RegionCollectionSQLite(const std::string& fn,
-		const T_cont& loci, Information* info) : RegionCollection(loci), self_open(true), self_info(!info) {
+		const T_cont& loci, Information* info) : RegionCollection(loci), self_open(true), self_info(!info), _snapshot(0) {
 	sqlite3_open(fn.c_str(), &db);
 	if(!info){
 		_info = new InformationSQLite(db);
@@ -123,7 +168,7 @@ RegionCollectionSQLite::RegionCollectionSQLite(const std::string& fn,
 template<class T_cont>
 RegionCollectionSQLite::RegionCollectionSQLite(sqlite3* db_conn,
 		const T_cont& loci, Information* info) : RegionCollection(loci),
-		self_open(false), self_info(!info), db(db_conn) {
+		self_open(false), self_info(!info), db(db_conn), _snapshot(0) {
 	if(!info){
 		_info = new InformationSQLite(db);
 	}else{